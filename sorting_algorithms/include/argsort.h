@@ -0,0 +1,98 @@
+#ifndef __TD_ARGSORT_H__
+#define __TD_ARGSORT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* The maximum number of columns of a table */
+#define MAX_COLUMNS 16
+
+/*
+ * Description: The function packs a key and an index into a pair whose unsigned order is the order
+ *              of the keys, the equal keys are ordered by their indexes.
+ * Parameters:
+ * 	@key is the key
+ *	@index is the index
+ * Return: The pair, the key in the upper and the index in the lower 32 bits
+ * Time complexity: O(1)
+ * Space complexity: O(1)
+ */
+uint64_t PackPair(int key, uint32_t index);
+
+/*
+ * Description: The function sorts (key, index) pairs as unsigned integers.
+ * Parameters:
+ * 	@pairs is an array of pairs, the upper 32 bits are the key
+ *	@size is the size of the array
+ *	@engine is 'Q' or 'q' for the quicksort of the pairs, otherwise the parallel radix sort of the keys
+ *	@maxthreads is the number of threads of the radix sort
+ * Return: Nothing
+ * Time complexity: O(n * log(n)) by the quicksort, O(n) by the radix sort
+ * Space complexity: O(log(n)) by the quicksort, O(n) by the radix sort
+ */
+void SortPairs(uint64_t *pairs, size_t size, char engine, int maxthreads);
+
+/*
+ * Description: The function finds the stable sorting permutation of the keys, the keys themselves
+ *              are not moved.
+ * Parameters:
+ * 	@keys is an array of integers
+ *	@size is the size of the array, at most UINT32_MAX
+ *	@perm is the buffer of size indexes, perm[i] is the index of the key of rank i
+ *	@engine is the engine of SortPairs
+ *	@maxthreads is the number of threads
+ * Return: 0 on success, otherwise 1
+ * Time complexity: O(n) by the radix sort
+ * Space complexity: O(n)
+ */
+int Argsort(const int *keys, size_t size, uint32_t *perm, char engine, int maxthreads);
+
+/*
+ * Description: The function copies records in the order of a permutation, out[i] = records[perm[i]].
+ * Parameters:
+ * 	@records is an array of records
+ *	@out is the buffer of size records
+ *	@record is the size of a record in bytes
+ *	@perm is the permutation of size indexes
+ *	@size is the number of the records
+ *	@maxthreads is the number of threads
+ * Return: Nothing
+ * Time complexity: O(n * record)
+ * Space complexity: O(maxthreads)
+ */
+void GatherRecords(const void *records, void *out, size_t record, const uint32_t *perm, size_t size, int maxthreads);
+
+/*
+ * Description: The function finds the stable permutation sorting the rows of a table of int columns
+ *              lexicographically, the columns are packed into as few 32-bit keys as their ranges allow
+ *              and every next key only reorders the rows equal on the keys before it.
+ * Parameters:
+ * 	@columns are the columns of the table, the first one is the most significant
+ *	@ncolumns is the number of the columns, 1 to MAX_COLUMNS
+ *	@size is the number of the rows, 1 to UINT32_MAX
+ *	@perm is the buffer of size indexes, perm[i] is the index of the row of rank i
+ *	@engine is the engine of SortPairs
+ *	@maxthreads is the number of threads
+ * Return: The number of the packed keys, 0 on failure
+ * Time complexity: O(n * keys) by the radix sort
+ * Space complexity: O(n)
+ */
+size_t ArgsortColumns(const int *const *columns, size_t ncolumns, size_t size, uint32_t *perm, char engine, int maxthreads);
+
+/*
+ * Description: The function copies every column of a table in the order of a permutation,
+ *              out[c][i] = columns[c][perm[i]].
+ * Parameters:
+ * 	@columns are the columns of the table
+ *	@out are the buffers of size rows of every column
+ *	@ncolumns is the number of the columns
+ *	@perm is the permutation of size indexes
+ *	@size is the number of the rows
+ *	@maxthreads is the number of threads
+ * Return: Nothing
+ * Time complexity: O(n * ncolumns)
+ * Space complexity: O(maxthreads)
+ */
+void GatherColumns(const int *const *columns, int **out, size_t ncolumns, const uint32_t *perm, size_t size, int maxthreads);
+
+#endif // __TD_ARGSORT_H__
@@ -0,0 +1,79 @@
+#ifndef __TD_BLOCK_INDEX_H__
+#define __TD_BLOCK_INDEX_H__
+
+#include <stddef.h>
+
+/* An indexed file mapped for the lookups */
+typedef struct indexed_file
+{
+	const int *data;
+	const int *fences;      /* The first key of every block */
+	size_t count;
+	size_t nblocks;
+	size_t block;
+	void *map;
+	size_t bytes;
+} indexed_file_t;
+
+/*
+ * Description: The function stores a sorted array into a file followed by the first key of
+ *              every block of 4 KB and a trailer, so a lookup reads the index and one block.
+ * Parameters:
+ * 	@path is the path to the file
+ *	@array is a sorted array
+ *	@size is the size of the array
+ * Return: 0 on success, otherwise 1
+ * Time complexity: O(size)
+ * Space complexity: O(1)
+ */
+int WriteIndexed(const char *path, const int *array, size_t size);
+
+/*
+ * Description: The function maps a file stored by WriteIndexed and checks its trailer against the
+ *              size of the file and the block size of this build.
+ * Parameters:
+ * 	@path is the path to the file
+ *	@indexed is the mapped file, it is cleared on failure
+ * Return: 0 on success, otherwise 1
+ * Time complexity: O(1)
+ * Space complexity: O(1)
+ */
+int OpenIndexed(const char *path, indexed_file_t *indexed);
+
+/*
+ * Description: The function unmaps a file opened by OpenIndexed.
+ * Parameters:
+ * 	@indexed is the mapped file
+ * Return: Nothing
+ * Time complexity: O(1)
+ * Space complexity: O(1)
+ */
+void CloseIndexed(indexed_file_t *indexed);
+
+/*
+ * Description: The function finds the first position of the data whose value is not less
+ *              than the key, or greater than the key if is_upper is set.
+ * Parameters:
+ * 	@indexed is the mapped file
+ *	@key is the key to look up
+ *	@is_upper chooses the upper bound instead of the lower one
+ * Return: The position of the bound, the count of the data if all values are smaller
+ * Time complexity: O(log(nblocks) + log(block))
+ * Space complexity: O(1)
+ */
+size_t IndexedBound(const indexed_file_t *indexed, int key, int is_upper);
+
+/*
+ * Description: The function finds the values of the data within [low, high].
+ * Parameters:
+ * 	@indexed is the mapped file
+ *	@low is the smallest value of the range
+ *	@high is the largest value of the range
+ *	@first is set to the position of the first value of the range
+ * Return: The number of the values of the range
+ * Time complexity: O(log(nblocks) + log(block))
+ * Space complexity: O(1)
+ */
+size_t IndexedRange(const indexed_file_t *indexed, int low, int high, size_t *first);
+
+#endif // __TD_BLOCK_INDEX_H__
@@ -0,0 +1,67 @@
+#ifndef __TD_DAEMON_H__
+#define __TD_DAEMON_H__
+
+#include <stddef.h>
+
+/* The statuses of the replies of the daemon */
+#define DAEMON_OK 0
+#define DAEMON_BUSY 1
+#define DAEMON_INVALID 2
+#define DAEMON_TOO_LARGE 3      /* The buffer alone exceeds the cap, a retry cannot succeed */
+
+/* Sent to the daemon together with the descriptor of the buffer */
+typedef struct sort_request
+{
+	size_t size;            /* The number of integers at the start of the buffer */
+} sort_request_t;
+
+typedef struct sort_reply
+{
+	int status;
+} sort_reply_t;
+
+/*
+ * Description: The function serves sort requests on a Unix socket until SIGINT or SIGTERM. The
+ *              requests waiting together are sorted as one batch, the small buffers by one
+ *              thread each and the large ones by all threads. A buffer is copied into the
+ *              memory of the daemon and written back sorted, so the sort is not zero-copy but
+ *              a client writing its buffer meanwhile cannot drive the kernels out of range. A
+ *              buffer must be sealed against shrinking, the clients of a batch have a second
+ *              together to send their requests.
+ * Parameters:
+ * 	@path is the path of the socket
+ *	@maxthreads is the number of threads
+ *	@cap is the number of bytes sorted at once, the requests that do not fit next to the others
+ *	     are rejected as busy, the ones larger than the cap alone as too large
+ * Return: 0 after a signal, 1 if the socket cannot be created
+ * Time complexity: O(n * log(n)) per request
+ * Space complexity: O(cap)
+ */
+int ServeSorts(const char *path, int maxthreads, size_t cap);
+
+/*
+ * Description: The function creates a buffer of integers that the daemon accepts: a memfd sealed
+ *              against shrinking, mapped shared.
+ * Parameters:
+ * 	@size is the number of integers
+ *	@fd is set to the descriptor of the buffer
+ * Return: The mapped buffer, NULL on failure
+ * Time complexity: O(1)
+ * Space complexity: O(size)
+ */
+int *CreateSortBuffer(size_t size, int *fd);
+
+/*
+ * Description: The function has the daemon on a socket sort a buffer made by CreateSortBuffer
+ *              and waits for the reply, the buffer holds the sorted values after a DAEMON_OK.
+ * Parameters:
+ * 	@path is the path of the socket of the daemon
+ *	@fd is the descriptor of the buffer
+ *	@size is the number of integers to sort at the start of the buffer
+ * Return: The status of the reply, DAEMON_INVALID if the request could not be made
+ * Time complexity: O(n * log(n))
+ * Space complexity: O(1)
+ */
+int RequestSort(const char *path, int fd, size_t size);
+
+#endif // __TD_DAEMON_H__
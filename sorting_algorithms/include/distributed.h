@@ -0,0 +1,87 @@
+#ifndef __TD_DISTRIBUTED_H__
+#define __TD_DISTRIBUTED_H__
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/* The maximum number of worker processes of the distributed sort */
+#define MAX_PROCESSES 64
+/* The largest summary of a slice a worker sends to the coordinator */
+#define DISTRIBUTED_SUMMARY 64
+
+/* What the distributed sort asks of its caller, every function runs in the worker processes */
+typedef struct distributed_ops
+{
+	/* Loads the elements [first, first + size) of the array into slice and writes their summary, 0 on success */
+	int (*load)(int *slice, size_t first, size_t size, void *summary, const void *context);
+	/* Adds the summary of the next slice to the summary of the slices before it, runs in the coordinator */
+	void (*combine)(void *total, const void *summary);
+	/* Sorts the bucket of a worker in place */
+	void (*sort)(int *bucket, size_t size, const void *context);
+	size_t summary_size;    /* At most DISTRIBUTED_SUMMARY bytes */
+	const void *context;
+} distributed_ops_t;
+
+/* A sample sort of worker processes, the buckets are exchanged through shared memory */
+typedef struct distributed
+{
+	int nprocesses;         /* The number of the running workers */
+	size_t size;
+	int fds[MAX_PROCESSES]; /* The socket of every worker */
+	pid_t pids[MAX_PROCESSES];
+	int *samples;           /* The samples of all the workers */
+	size_t nsamples;
+	size_t (*counts)[MAX_PROCESSES]; /* The number of elements sent from a worker to a worker */
+	int *array;             /* The sorted array, it follows the counts in the shared memory */
+	size_t bytes;           /* The size of the shared memory */
+	int status;
+} distributed_t;
+
+/*
+ * Description: The function starts the workers of a distributed sort and waits until every
+ *              worker has loaded its slice of the array and sent its samples and its summary.
+ * Parameters:
+ * 	@distributed is the sort
+ *	@size is the size of the array
+ *	@nprocesses is the number of the workers, at most MAX_PROCESSES
+ *	@ops are the functions loading, summing up and sorting the data
+ *	@total is the summary of the whole array, combined from the summaries of the slices
+ * Return: 0 on success, otherwise 1, FinishDistributed stops the workers in either case
+ * Time complexity: O(n / p), p is the number of the workers
+ * Space complexity: O(n)
+ */
+int StartDistributed(distributed_t *distributed, size_t size, int nprocesses, const distributed_ops_t *ops, void *total);
+
+/*
+ * Description: The function chooses the splitters from the samples, lets the workers exchange
+ *              and sort their buckets and waits for all of them to exit.
+ * Parameters:
+ * 	@distributed is the sort
+ * Return: 0 if the array is sorted, otherwise 1
+ * Time complexity: O(n * log(n) / p)
+ * Space complexity: O(p)
+ */
+int FinishDistributed(distributed_t *distributed);
+
+/*
+ * Description: The function returns the number of the elements sorted by a worker.
+ * Parameters:
+ * 	@distributed is the sort
+ *	@rank is the worker
+ * Return: The size of the bucket of the worker
+ * Time complexity: O(p)
+ * Space complexity: O(1)
+ */
+size_t DistributedBucket(const distributed_t *distributed, int rank);
+
+/*
+ * Description: The function frees the shared memory of a finished sort with its array.
+ * Parameters:
+ * 	@distributed is the sort
+ * Return: Nothing
+ * Time complexity: O(1)
+ * Space complexity: O(1)
+ */
+void DestroyDistributed(distributed_t *distributed);
+
+#endif // __TD_DISTRIBUTED_H__
@@ -0,0 +1,78 @@
+#ifndef __TD_LAZY_H__
+#define __TD_LAZY_H__
+
+#include <stddef.h>
+#include <pthread.h>
+
+/* Sorts a piece of the array in place, the context is the one given to CreateLazySort */
+typedef void (*lazy_sort_fn_t)(int *piece, size_t size, const void *context);
+
+/* A range of the lazy sort between two pivots */
+typedef struct lazy_piece
+{
+	size_t left;
+	size_t right;
+	int state;
+} lazy_piece_t;
+
+/* The lazy sort hands out the sorted prefix, the pieces of the rest lie on a stack with the front on the top */
+typedef struct lazy_sort
+{
+	int *array;
+	size_t size;
+	size_t block;           /* The smallest number of elements handed out at once */
+	size_t emitted;         /* The length of the handed out prefix */
+	int median;             /* Whether the pivot of a split is the median of three */
+	lazy_sort_fn_t sort;
+	const void *context;
+	lazy_piece_t *pieces;
+	size_t npieces;
+	size_t capacity;
+	int is_stopping;
+	int nworkers;
+	pthread_t *workers;     /* Sort the pieces from the bottom of the stack */
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+} lazy_sort_t;
+
+/*
+ * Description: The function starts a lazy sort of an array, the workers sort the pieces farthest
+ *              from the front while LazyNext hands the sorted front out.
+ * Parameters:
+ * 	@array is an array of integers, it is sorted in place
+ *	@size is the size of the array, at least 1
+ *	@block is the smallest number of elements handed out at once, at least 1
+ *	@median is 1 to split the pieces around the median of three, otherwise around their first element
+ *	@sort is the function sorting the pieces, it runs in the workers and in LazyNext
+ *	@context is passed to the sort
+ *	@nworkers is the number of the background threads, 0 to sort every piece in LazyNext
+ * Return: The lazy sort, NULL on failure
+ * Time complexity: O(nworkers)
+ * Space complexity: O(nworkers)
+ */
+lazy_sort_t *CreateLazySort(int *array, size_t size, size_t block, int median, lazy_sort_fn_t sort, const void *context, int nworkers);
+
+/*
+ * Description: The function stops the workers of a lazy sort and frees it, the array is left as it is.
+ * Parameters:
+ * 	@lazy is the lazy sort
+ * Return: Nothing
+ * Time complexity: O(1) besides the pieces being sorted
+ * Space complexity: O(1)
+ */
+void DestroyLazySort(lazy_sort_t *lazy);
+
+/*
+ * Description: The function sorts the next block of the array, it splits the front piece until a
+ *              piece smaller than a block is at the front or waits for the worker sorting it.
+ * Parameters:
+ * 	@lazy is the lazy sort
+ *	@block is the first sorted element of the block, it follows the previous block in the array
+ * Return: The number of elements of the block, at least the block size of the sort except for
+ *         the last block, 0 once the whole array is handed out
+ * Time complexity: O(n) for the first block, O(n * log(n)) over all blocks
+ * Space complexity: O(log(n))
+ */
+size_t LazyNext(lazy_sort_t *lazy, const int **block);
+
+#endif // __TD_LAZY_H__
@@ -0,0 +1,107 @@
+#ifndef __TD_LSM_H__
+#define __TD_LSM_H__
+
+#include <stddef.h>
+#include <pthread.h>
+
+/* The number of runs of a level which are merged into one run of the next level */
+#define LSM_FANOUT 8
+/* A level takes at most this many runs, the ingestion waits for the compaction above it */
+#define LSM_MAX_RUNS (2 * LSM_FANOUT)
+/* The maximum number of levels of the container */
+#define LSM_LEVELS 24
+
+typedef struct lsm_run
+{
+	int *data;
+	size_t size;
+} lsm_run_t;
+
+typedef struct lsm_level
+{
+	lsm_run_t runs[LSM_MAX_RUNS];
+	size_t nruns;
+	int is_compacting;      /* Whether a worker is merging the first LSM_FANOUT runs of the level */
+} lsm_level_t;
+
+/* Incremental sorted container: sorted batches are merged level by level in the background */
+typedef struct lsm
+{
+	lsm_level_t levels[LSM_LEVELS];
+	size_t size;            /* The number of stored values */
+	int is_stopping;
+	int nworkers;
+	pthread_t *workers;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+} lsm_t;
+
+/*
+ * Description: The function creates an empty container and starts its compaction workers.
+ * Parameters:
+ * 	@nworkers is the number of the compaction workers
+ * Return: The container, NULL if no worker could be started
+ * Time complexity: O(nworkers)
+ * Space complexity: O(nworkers)
+ */
+lsm_t *CreateLsm(int nworkers);
+
+/*
+ * Description: The function stops the workers of a container and frees it with its runs.
+ * Parameters:
+ * 	@lsm is the container
+ * Return: Nothing
+ * Time complexity: O(r), r is the number of the runs
+ * Space complexity: O(1)
+ */
+void DestroyLsm(lsm_t *lsm);
+
+/*
+ * Description: The function sorts a copy of a batch and adds it to the first level as a run,
+ *              it waits while the first level is full.
+ * Parameters:
+ * 	@lsm is the container
+ *	@batch is an array of integers
+ *	@size is the size of the batch
+ * Return: 0 on success, otherwise 1
+ * Time complexity: O(size * log(size))
+ * Space complexity: O(size)
+ */
+int LsmInsert(lsm_t *lsm, const int *batch, size_t size);
+
+/*
+ * Description: The function counts the stored values within [low, high], none if high < low.
+ * Parameters:
+ * 	@lsm is the container
+ *	@low is the smallest value of the range
+ *	@high is the largest value of the range
+ * Return: The number of the values of the range
+ * Time complexity: O(r * log(n)), r is the number of the runs
+ * Space complexity: O(1)
+ */
+size_t LsmCount(lsm_t *lsm, int low, int high);
+
+/*
+ * Description: The function copies the stored values within [low, high] in sorted order, none if high < low.
+ * Parameters:
+ * 	@lsm is the container
+ *	@low is the smallest value of the range
+ *	@high is the largest value of the range
+ *	@out is an array large enough for LsmCount values
+ * Return: The number of the values copied
+ * Time complexity: O(r * log(n) + m * log(r)), m is the number of the values copied
+ * Space complexity: O(m)
+ */
+size_t LsmRange(lsm_t *lsm, int low, int high, int *out);
+
+/*
+ * Description: The function waits until no level of the container has runs to merge.
+ * Parameters:
+ * 	@lsm is the container
+ * Return: Nothing
+ * Time complexity: O(1) besides the compactions
+ * Space complexity: O(1)
+ */
+void LsmWaitCompaction(lsm_t *lsm);
+
+#endif // __TD_LSM_H__
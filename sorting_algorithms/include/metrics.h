@@ -0,0 +1,119 @@
+#ifndef __TD_METRICS_H__
+#define __TD_METRICS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* The phases of the quicksort reported by the live metrics */
+#define METRICS_LOAD 0
+#define METRICS_VERIFY 1
+#define METRICS_PARTITION 2
+#define METRICS_SORT 3
+#define METRICS_MERGE 4
+#define METRICS_DONE 5
+#define METRICS_PHASES 6
+/* The counters of a thread take a cache line of their own */
+#define METRICS_LINE 64
+
+/* Only the owner writes its slot, so a relaxed store without a locked add is enough */
+#define METRICS_COMPLETE(count) \
+    do \
+    { \
+        if (NULL != metrics_slot) \
+        { \
+            __atomic_store_n(&metrics_slot->completed, metrics_slot->completed + (count), __ATOMIC_RELAXED); \
+        } \
+    } while (0)
+
+/* The counters of one sorting thread, written only by the thread and read by the metrics thread */
+typedef struct metrics_slot
+{
+	uint64_t completed;     /* Elements placed at their final position */
+	uint64_t segments;      /* Segments taken from the queue */
+	uint64_t busy_ns;       /* Sorting the segments */
+	uint64_t idle_ns;       /* Waiting for a segment while the queue is empty */
+	uint64_t wait_ns;       /* Waiting for the lock of the queue */
+	char padding[METRICS_LINE - 5 * sizeof(uint64_t)];
+} metrics_slot_t;
+
+/* The slot of the thread running the quicksort, NULL if it is not counted */
+extern __thread metrics_slot_t *metrics_slot;
+
+/*
+ * Description: The function starts the thread serving the live metrics of a sort in the
+ *              Prometheus text format on a Unix socket, it also reports the progress to stderr.
+ * Parameters:
+ * 	@path is the path of the socket
+ *	@total is the size of the array
+ *	@nthreads is the number of the slots of the sorting threads
+ *	@queue_depth is the number of the segments waiting in the queue, read without a lock
+ * Return: 0 on success, otherwise 1
+ * Time complexity: O(nthreads)
+ * Space complexity: O(nthreads)
+ */
+int StartMetrics(const char *path, size_t total, int nthreads, const size_t *queue_depth);
+
+/*
+ * Description: The function stops the thread of the metrics and removes its socket, it does
+ *              nothing if the metrics are not served.
+ * Parameters: None
+ * Return: Nothing
+ * Time complexity: O(1)
+ * Space complexity: O(1)
+ */
+void StopMetrics(void);
+
+/*
+ * Description: The function sets the phase of the sort reported by the metrics.
+ * Parameters:
+ * 	@phase is one of METRICS_LOAD to METRICS_DONE
+ * Return: Nothing
+ * Time complexity: O(1)
+ * Space complexity: O(1)
+ */
+void SetMetricsPhase(int phase);
+
+/*
+ * Description: The function gives the calling thread the next free slot and makes it the
+ *              slot counted by METRICS_COMPLETE.
+ * Parameters: None
+ * Return: The slot, NULL if the metrics are not served or all slots are taken
+ * Time complexity: O(1)
+ * Space complexity: O(1)
+ */
+metrics_slot_t *RegisterMetrics(void);
+
+/*
+ * Description: The function adds a wait for a segment to the slot of a thread.
+ * Parameters:
+ * 	@slot is the slot, NULL is ignored
+ *	@waiting is the time the thread asked for the lock
+ *	@locked is the time it took the lock
+ *	@taken is the time it took a segment
+ * Return: Nothing
+ * Time complexity: O(1)
+ * Space complexity: O(1)
+ */
+void MetricsWait(metrics_slot_t *slot, uint64_t waiting, uint64_t locked, uint64_t taken);
+
+/*
+ * Description: The function adds a sorted segment to the slot of a thread.
+ * Parameters:
+ * 	@slot is the slot, NULL is ignored
+ *	@sorting is the time the thread started to sort the segment
+ * Return: Nothing
+ * Time complexity: O(1)
+ * Space complexity: O(1)
+ */
+void MetricsSegment(metrics_slot_t *slot, uint64_t sorting);
+
+/*
+ * Description: The function reads the monotonic clock the metrics are measured with.
+ * Parameters: None
+ * Return: The time in ns
+ * Time complexity: O(1)
+ * Space complexity: O(1)
+ */
+uint64_t MetricsNow(void);
+
+#endif // __TD_METRICS_H__
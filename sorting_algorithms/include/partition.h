@@ -0,0 +1,57 @@
+#ifndef __TD_PARTITION_H__
+#define __TD_PARTITION_H__
+
+#include <stddef.h>
+
+/*
+ * Description: The function swaps two integers.
+ * Parameters:
+ * 	@a is the first integer
+ *	@b is the second integer
+ * Return: Nothing
+ * Time complexity: O(1)
+ * Space complexity: O(1)
+ */
+void Swap(int *a, int *b);
+
+/*
+ * Description: The function finds which of three elements of an array holds the median of their values.
+ * Parameters:
+ * 	@array is an array of integers
+ *	@low is the index of the first element
+ *	@mid is the index of the second element
+ *	@high is the index of the third element
+ * Return: The index of the median
+ * Time complexity: O(1)
+ * Space complexity: O(1)
+ */
+int MedianOfThree(int *array, int low, int mid, int high);
+
+/*
+ * Description: The function partitions the range [low, high] around its first element, the smaller
+ *              elements end up to the left of the pivot and the larger ones to the right of it.
+ * Parameters:
+ * 	@array is an array of integers
+ *	@low is the index of the first element, the pivot
+ *	@high is the index of the last element
+ *	@i is the first index to the right of the left part
+ *	@j is the final index of the pivot
+ * Return: Nothing
+ * Time complexity: O(n)
+ * Space complexity: O(1)
+ */
+void Partition(int *array, int low, int high, size_t *i, size_t *j);
+
+/*
+ * Description: The function sorts the range [low, high] by the shell sort.
+ * Parameters:
+ * 	@array is an array of integers
+ *	@low is the index of the first element
+ *	@high is the index of the last element
+ * Return: Nothing
+ * Time complexity: O(n^(3/2))
+ * Space complexity: O(1)
+ */
+void ShellSort(int *array, int low, int high);
+
+#endif // __TD_PARTITION_H__
@@ -0,0 +1,171 @@
+#ifndef __TD_SELECT_H__
+#define __TD_SELECT_H__
+
+#include <stddef.h>
+
+/* The maximum number of quantiles requested at once */
+#define QUANTILES_MAX 32
+/* The capacity of one level of the approximate quantile sketch */
+#define SKETCH_CAPACITY 8192
+/* The maximum number of levels of the sketch, the weight of a value on level l is 2^l */
+#define SKETCH_LEVELS 48
+
+/* Approximate quantiles of a stream: every full level keeps every other value one level up */
+typedef struct sketch
+{
+	int *levels[SKETCH_LEVELS];
+	size_t sizes[SKETCH_LEVELS];
+	int nlevels;            /* The number of allocated levels */
+	int offset;             /* Alternates between 0 and 1 to keep the compaction error unbiased */
+	size_t count;           /* The number of values seen */
+} sketch_t;
+
+/*
+ * Description: The function moves the element of rank k to index k by the introselect, the
+ *              elements of [low, k) are not larger than it and those of (k, high] are not smaller.
+ * Parameters:
+ * 	@array is an array of integers
+ *	@low is the index of the first element of the range
+ *	@high is the index of the last element of the range
+ *	@k is the index of the element to select, low <= k <= high
+ * Return: The selected element
+ * Time complexity: O(n)
+ * Space complexity: O(log(n))
+ */
+int Select(int *array, int low, int high, int k);
+
+/*
+ * Description: The function moves the k smallest elements of an array to its front in order,
+ *              the rest of the array is left in no particular order.
+ * Parameters:
+ * 	@array is an array of integers
+ *	@size is the size of the array
+ *	@k is the number of the smallest elements to sort
+ * Return: Nothing
+ * Time complexity: O(n + k * log(k))
+ * Space complexity: O(log(n))
+ */
+void PartialSort(int *array, size_t size, size_t k);
+
+/*
+ * Description: The function copies the k smallest elements of an array to a buffer in order,
+ *              large arrays are split between threads which select the candidates of their chunks.
+ * Parameters:
+ * 	@array is an array of integers, it is reordered
+ *	@size is the size of the array
+ *	@k is the number of the smallest elements, at most size are taken
+ *	@out is the buffer of k elements
+ *	@maxthreads is the number of threads
+ * Return: Nothing
+ * Time complexity: O(n + k * log(k))
+ * Space complexity: O(k * maxthreads)
+ */
+void TopK(int *array, size_t size, size_t k, int *out, int maxthreads);
+
+/*
+ * Description: The function moves the elements of several ranks to their positions at once, every
+ *              partition only descends into the sides which hold a requested rank.
+ * Parameters:
+ * 	@array is an array of integers
+ *	@low is the index of the first element of the range
+ *	@high is the index of the last element of the range
+ *	@ranks are the distinct indexes to select in ascending order, all within [low, high]
+ *	@nranks is the number of the ranks
+ * Return: Nothing
+ * Time complexity: O(n * log(nranks))
+ * Space complexity: O(log(n))
+ */
+void MultiSelect(int *array, int low, int high, const size_t *ranks, size_t nranks);
+
+/*
+ * Description: The function finds exact quantiles of an array by one multiselect of their ranks.
+ * Parameters:
+ * 	@array is an array of integers, it is reordered
+ *	@size is the size of the array
+ *	@quantiles are the quantiles within [0, 1] in any order
+ *	@count is the number of the quantiles, at most QUANTILES_MAX
+ *	@values is the buffer of count values, in the order of the quantiles
+ * Return: 0 on success, otherwise 1
+ * Time complexity: O(n * log(count))
+ * Space complexity: O(count)
+ */
+int Quantiles(int *array, size_t size, const double *quantiles, size_t count, int *values);
+
+/*
+ * Description: The function creates an empty quantile sketch.
+ * Parameters: None
+ * Return: The sketch, NULL on failure
+ * Time complexity: O(1)
+ * Space complexity: O(1)
+ */
+sketch_t *CreateSketch(void);
+
+/*
+ * Description: The function frees a sketch with its levels.
+ * Parameters:
+ * 	@sketch is the sketch
+ * Return: Nothing
+ * Time complexity: O(1)
+ * Space complexity: O(1)
+ */
+void DestroySketch(sketch_t *sketch);
+
+/*
+ * Description: The function adds values to a sketch, a full level is compacted into the next one.
+ * Parameters:
+ * 	@sketch is the sketch
+ *	@values is an array of integers
+ *	@size is the size of the array
+ * Return: 0 on success, otherwise 1
+ * Time complexity: O(n * log(SKETCH_CAPACITY))
+ * Space complexity: O(SKETCH_CAPACITY * log(n))
+ */
+int SketchUpdate(sketch_t *sketch, const int *values, size_t size);
+
+/*
+ * Description: The function adds the values kept by another sketch with their weights to a sketch.
+ * Parameters:
+ * 	@sketch is the sketch
+ *	@other is the sketch to merge, it is not changed
+ * Return: 0 on success, otherwise 1
+ * Time complexity: O(SKETCH_CAPACITY * SKETCH_LEVELS)
+ * Space complexity: O(SKETCH_CAPACITY * SKETCH_LEVELS)
+ */
+int SketchMerge(sketch_t *sketch, const sketch_t *other);
+
+/*
+ * Description: The function estimates a quantile of the values seen by a sketch, the levels are
+ *              sorted in place.
+ * Parameters:
+ * 	@sketch is the sketch
+ *	@quantile is the quantile within [0, 1]
+ * Return: The value whose rank is within SketchErrorBound of the requested one
+ * Time complexity: O(SKETCH_CAPACITY * SKETCH_LEVELS^2)
+ * Space complexity: O(SKETCH_LEVELS)
+ */
+int SketchQuery(const sketch_t *sketch, double quantile);
+
+/*
+ * Description: The function bounds the rank error of the quantiles of a sketch.
+ * Parameters:
+ * 	@sketch is the sketch
+ * Return: The bound as a share of the number of the values seen
+ * Time complexity: O(1)
+ * Space complexity: O(1)
+ */
+double SketchErrorBound(const sketch_t *sketch);
+
+/*
+ * Description: The function summarizes an array by a sketch, every thread sketches its chunk and
+ *              the sketches are merged.
+ * Parameters:
+ * 	@array is an array of integers
+ *	@size is the size of the array
+ *	@maxthreads is the number of threads
+ * Return: The sketch, NULL on failure
+ * Time complexity: O(n * log(SKETCH_CAPACITY))
+ * Space complexity: O(maxthreads * SKETCH_CAPACITY * log(n))
+ */
+sketch_t *SketchArray(const int *array, size_t size, int maxthreads);
+
+#endif // __TD_SELECT_H__
@@ -0,0 +1,80 @@
+#ifndef __TD_SOCKETS_H__
+#define __TD_SOCKETS_H__
+
+#include <stddef.h>
+#include <sys/un.h>
+
+/*
+ * Description: The function writes a whole buffer to a descriptor, however the writes are split.
+ * Parameters:
+ * 	@fd is the descriptor
+ *	@buffer is the data
+ *	@bytes is the size of the data
+ * Return: 0 on success, otherwise 1
+ * Time complexity: O(bytes)
+ * Space complexity: O(1)
+ */
+int SendAll(int fd, const void *buffer, size_t bytes);
+
+/*
+ * Description: The function reads a whole buffer from a descriptor, however the reads are split.
+ * Parameters:
+ * 	@fd is the descriptor
+ *	@buffer is the data
+ *	@bytes is the size of the data
+ * Return: 0 on success, 1 on an error or the end of the file
+ * Time complexity: O(bytes)
+ * Space complexity: O(1)
+ */
+int ReceiveAll(int fd, void *buffer, size_t bytes);
+
+/*
+ * Description: The function sends a message with a descriptor to the other end of a Unix socket,
+ *              the kernel duplicates the descriptor into the receiver.
+ * Parameters:
+ * 	@socket_fd is the socket
+ *	@fd is the descriptor to send
+ *	@buffer is the message
+ *	@bytes is the size of the message
+ * Return: 0 on success, otherwise 1
+ * Time complexity: O(bytes)
+ * Space complexity: O(1)
+ */
+int SendDescriptor(int socket_fd, int fd, const void *buffer, size_t bytes);
+
+/*
+ * Description: The function receives a message with a descriptor sent by SendDescriptor.
+ * Parameters:
+ * 	@socket_fd is the socket
+ *	@fd is set to the received descriptor, -1 if there is none
+ *	@buffer is the message
+ *	@bytes is the size of the message
+ * Return: 0 on success, otherwise 1
+ * Time complexity: O(bytes)
+ * Space complexity: O(1)
+ */
+int ReceiveDescriptor(int socket_fd, int *fd, void *buffer, size_t bytes);
+
+/*
+ * Description: The function creates a stream Unix socket and fills the address of a path.
+ * Parameters:
+ * 	@path is the path of the socket
+ *	@address is the address to fill
+ * Return: The socket, -1 on failure or if the path is too long
+ * Time complexity: O(1)
+ * Space complexity: O(1)
+ */
+int OpenSocket(const char *path, struct sockaddr_un *address);
+
+/*
+ * Description: The function creates a Unix socket listening on a path, a file left at the path
+ *              is replaced.
+ * Parameters:
+ * 	@path is the path of the socket
+ * Return: The socket, -1 on failure
+ * Time complexity: O(1)
+ * Space complexity: O(1)
+ */
+int ListenSocket(const char *path);
+
+#endif // __TD_SOCKETS_H__
@@ -2,6 +2,38 @@
 #define __TD_SORTS_H__
 
 #include <stddef.h>
+#include <stdint.h>
+
+/* The kernels the Sort front door chooses from */
+typedef enum sort_kernel
+{
+	SORT_INSERTION,
+	SORT_COUNTING,
+	SORT_RADIX,
+	SORT_QUICK3,
+	SORT_MERGE_RUNS,
+	SORT_PARALLEL
+} sort_kernel_t;
+
+/* What the sample of the input showed and which kernel was chosen for it */
+typedef struct sort_profile
+{
+	size_t sample;          /* The number of sampled elements */
+	int min;                /* The smallest sampled value */
+	int max;                /* The largest sampled value */
+	double duplicates;      /* The share of the sample equal to another sampled element */
+	double runs;            /* The estimated number of monotonic runs of the whole array */
+	double inversions;      /* The share of inverted pairs of the sample, 0 is sorted, 1 is reversed */
+	sort_kernel_t kernel;   /* The kernel that actually sorted the array */
+} sort_profile_t;
+
+/* A key of the string sort: the bytes, their number and the next of them cached by the sort */
+typedef struct sort_string
+{
+	const char *str;        /* The bytes of the string, they need not end with a zero */
+	size_t length;          /* The number of the bytes */
+	uint64_t prefix;        /* Set by the sort: 8 bytes of the string as a big-endian word */
+} sort_string_t;
 
 /*
  * Description: The function sorts a given array of integers.
@@ -66,14 +98,306 @@ void CountingSort(int *arr, size_t size);
  * 	@arr is an array of integers
  *	@size is a size of the array
  * Return: Nothing
- * Complexity:
+ * Time complexity:
  * 	@Best:    O(d * n)
  *  @Average: O(d * (n + k))
- * 	@Worst:   O(n^2)
- *      @d is the number of digits in the maximum value
- *      @k is the number of buckets
- * Space complexity: O()
+ * 	@Worst:   O(d * (n + k))
+ *      @d is the number of bytes of an integer
+ *      @k is the number of buckets, 256
+ * Space complexity: O(n)
  */
 void RadixSort(int *arr, size_t size);
 
+/*
+ * Description: The function sorts a given array of integers in parallel: the threads find
+ *              the minimum and the maximum of their pieces, count them into their own 
+ *              histograms and write out their shares of the sorted values. If the histogram
+ *              would not fit into the L2 cache, the array is sorted by the Sort function.
+ * Parameters:
+ * 	@arr is an array of integers
+ *	@size is a size of the array
+ *	@maxthreads is the largest number of threads
+ * Return: Nothing
+ * Time complexity:
+ * 	@Best:    O(n / p + k * p)
+ *  @Average: O(n / p + k * p)
+ * 	@Worst:   O(n / p + k * p)
+ *  	@k = (maximum element - minimum element + 1)
+ *	@p is the number of threads
+ * Space complexity: O(k * p)
+ */
+void ParallelCountingSort(int *arr, size_t size, int maxthreads);
+
+/*
+ * Description: The function sorts a given array of integers stably. It finds the ascending and
+ *              the strictly descending natural runs, extends short runs by binary insertion 
+ *              and merges them by galloping while keeping the pending runs balanced on a stack.
+ * Parameters:
+ * 	@arr is an array of integers
+ *	@size is a size of the array
+ * Return: Nothing
+ * Time complexity: 
+ * 	@Best:    O(n)
+ * 	@Average: O(n * log(r)), r is the number of natural runs
+ * 	@Worst:   O(n * log(n))
+ * Space complexity: O(n / 2)
+ */
+void NaturalMergeSort(int *arr, size_t size);
+
+/*
+ * Description: The function sorts a given array of integers stably by the natural merge sort 
+ *              of maxthreads pieces in parallel, and merges the sorted pieces pairwise, the 
+ *              merges of one level in parallel too.
+ * Parameters:
+ * 	@arr is an array of integers
+ *	@size is a size of the array
+ *	@maxthreads is the number of threads
+ * Return: Nothing
+ * Time complexity: 
+ * 	@Best:    O(n / p)
+ * 	@Average: O(n * log(r) / p + n * log(p))
+ * 	@Worst:   O(n * log(n) / p + n * log(p))
+ *	@p is the number of threads
+ * Space complexity: O(n)
+ */
+void ParallelNaturalMergeSort(int *arr, size_t size, int maxthreads);
+
+/*
+ * Description: The function sorts pairs by the key in their upper 32 bits stably, the pairs of
+ *              equal keys keep their order, whatever the payload in the lower 32 bits. Insertion
+ *              sorted leaves are merged bottom-up between the pairs and a buffer, every pass the
+ *              threads split the output evenly by the co-ranks of the merged runs.
+ * Parameters:
+ * 	@pairs is an array of pairs, the key is compared as unsigned
+ *	@size is a size of the array
+ *	@maxthreads is the largest number of threads
+ * Return: 0 on success, 1 if the buffer could not be allocated, the pairs are untouched then
+ * Time complexity: O(n * log(n) / p)
+ * Space complexity: O(n)
+ */
+int StableSortPairs(uint64_t *pairs, size_t size, int maxthreads);
+
+/*
+ * Description: The function sorts every segment of a given array on its own. The tiny segments
+ *              are sorted by a sorting network several at once, the small ones by insertion 
+ *              the medium by the three-way quicksort and the rest by
+ *              the Sort function, the threads get about the same number of elements.
+ * Parameters:
+ * 	@arr is an array of integers
+ *	@offsets is an array of nsegments + 1 offsets, the segment i is [offsets[i], offsets[i + 1])
+ *	@nsegments is the number of segments
+ *	@maxthreads is the largest number of threads
+ * Return: Nothing
+ * Time complexity: 
+ * 	@Best:    O(n / p)
+ * 	@Average: O(n * log(m) / p), m is the average size of a segment
+ * 	@Worst:   O(n * log(m) / p)
+ *	@p is the number of threads
+ * Space complexity: O(m)
+ */
+void SegmentedSort(int *arr, const size_t *offsets, size_t nsegments, int maxthreads);
+
+/*
+ * Description: The function chooses the splitters of nbuckets key ranges holding about the 
+ *              same number of elements from a regular sample of a given array.
+ * Parameters:
+ * 	@arr is an array of integers
+ *	@size is a size of the array
+ *	@splitters is an array of nbuckets - 1 integers the ascending splitters are stored into
+ *	@nbuckets is the number of buckets
+ * Return: 0 on success, 1 if the memory could not be allocated
+ * Time complexity: O(k * log(k)), k is the number of buckets
+ * Space complexity: O(k)
+ */
+int ChooseSplitters(const int *arr, size_t size, int *splitters, size_t nbuckets);
+
+/*
+ * Description: The function splits a given array into nbuckets key ranges without sorting 
+ *              them, the bucket i gets the values v with splitters[i - 1] <= v < splitters[i].
+ *              The threads classify their pieces by a branchless descent of the splitter 
+ *              tree into their own histograms, then scatter them into out in a stable order.
+ * Parameters:
+ * 	@arr is an array of integers
+ *	@size is a size of the array
+ *	@out is an array of size integers the buckets are written into
+ *	@splitters is an array of nbuckets - 1 ascending integers
+ *	@nbuckets is the number of buckets, at most 4096
+ *	@offsets is an array of nbuckets + 1 offsets, the bucket i is [offsets[i], offsets[i + 1]) of out
+ *	@maxthreads is the largest number of threads
+ * Return: 0 on success, 1 if nbuckets is out of range or the memory could not be allocated
+ * Time complexity: 
+ * 	@Best:    O(n * log(k) / p + k * p)
+ * 	@Average: O(n * log(k) / p + k * p)
+ * 	@Worst:   O(n * log(k) / p + k * p)
+ *	@p is the number of threads
+ * Space complexity: O(n + k * p)
+ */
+int RangePartition(const int *arr, size_t size, int *out, const int *splitters, size_t nbuckets, size_t *offsets, int maxthreads);
+
+/*
+ * Description: The function writes the values found in both of two given sets to out. 
+ *              Blocks of four values are compared all against all by SIMD, a set much 
+ *              smaller than the other is looked up in it by galloping. The threads take 
+ *              pieces of the merged order of the sets.
+ * Parameters:
+ * 	@a is an ascending array of integers without duplicates
+ *	@asize is a size of a
+ * 	@b is an ascending array of integers without duplicates
+ *	@bsize is a size of b
+ *	@out is an array of at least min(asize, bsize) integers
+ *	@maxthreads is the largest number of threads
+ * Return: The number of values written to out
+ * Time complexity: O((n + m) / p), or O(n * log(m / n) / p) for n much smaller than m
+ * Space complexity: O(min(n, m)) with more than one thread, O(1) otherwise
+ */
+size_t SetIntersection(const int *a, size_t asize, const int *b, size_t bsize, int *out, int maxthreads);
+
+/*
+ * Description: The function writes the values found in any of two given sets to out in 
+ *              ascending order, the larger set is copied in runs if the other is much smaller.
+ * Parameters:
+ * 	@a is an ascending array of integers without duplicates
+ *	@asize is a size of a
+ * 	@b is an ascending array of integers without duplicates
+ *	@bsize is a size of b
+ *	@out is an array of at least asize + bsize integers
+ *	@maxthreads is the largest number of threads
+ * Return: The number of values written to out
+ * Time complexity: O((n + m) / p)
+ * Space complexity: O(n + m) with more than one thread, O(1) otherwise
+ */
+size_t SetUnion(const int *a, size_t asize, const int *b, size_t bsize, int *out, int maxthreads);
+
+/*
+ * Description: The function writes the values of a given set a that are not in a set b to out.
+ * Parameters:
+ * 	@a is an ascending array of integers without duplicates
+ *	@asize is a size of a
+ * 	@b is an ascending array of integers without duplicates
+ *	@bsize is a size of b
+ *	@out is an array of at least asize integers
+ *	@maxthreads is the largest number of threads
+ * Return: The number of values written to out
+ * Time complexity: O((n + m) / p), or O(n * log(m / n) / p) for n much smaller than m
+ * Space complexity: O(n) with more than one thread, O(1) otherwise
+ */
+size_t SetDifference(const int *a, size_t asize, const int *b, size_t bsize, int *out, int maxthreads);
+
+/*
+ * Description: The function pairs up the equal values of two given sorted arrays, every one 
+ *              of a run of equal values in a with every one of the run in b. The pairs of 
+ *              positions are written in ascending order of a, then of b.
+ * Parameters:
+ * 	@a is an ascending array of integers
+ *	@asize is a size of a
+ * 	@b is an ascending array of integers
+ *	@bsize is a size of b
+ *	@left is an array of capacity positions in a
+ *	@right is an array of capacity positions in b
+ *	@capacity is the largest number of pairs to write
+ *	@maxthreads is the largest number of threads
+ * Return: The number of all matching pairs, only the first capacity of them are written
+ * Time complexity: O((n + m) / p + r), r is the number of the pairs
+ * Space complexity: O(p)
+ */
+size_t MergeJoin(const int *a, size_t asize, const int *b, size_t bsize, size_t *left, size_t *right, size_t capacity, int maxthreads);
+
+/*
+ * Description: The function estimates the key range, the duplicate ratio and the 
+ *              presortedness of a given array from a small sample of it.
+ * Parameters:
+ * 	@arr is an array of integers
+ *	@size is a size of the array
+ *	@profile is the structure the estimates are stored into
+ * Return: Nothing
+ * Time complexity: O(1), at most 1024 elements are sampled
+ * Space complexity: O(1)
+ */
+void ProfileArray(const int *arr, size_t size, sort_profile_t *profile);
+
+/*
+ * Description: The function sorts a given array of integers by the kernel that suits
+ *              the sampled profile of the array: insertion sort for tiny arrays, run
+ *              merging for presorted ones, counting sort for narrow key ranges, 
+ *              three-way quicksort for many duplicates, radix sort otherwise and 
+ *              sorted pieces merged together if several threads are allowed.
+ * Parameters:
+ * 	@arr is an array of integers
+ *	@size is a size of the array
+ *	@maxthreads is the largest number of threads the sort may use
+ *	@profile receives the estimates and the chosen kernel for auditing, may be NULL
+ * Return: Nothing
+ * Time complexity: 
+ * 	@Best:    O(n)
+ * 	@Average: O(n) or O(n * log(n)) depending on the kernel
+ * 	@Worst:   O(n * log(n)) for all kernels but the three-way quicksort, O(n^2) for it
+ * Space complexity: O(n)
+ */
+void Sort(int *arr, size_t size, int maxthreads, sort_profile_t *profile);
+
+/*
+ * Description: The function names a kernel of the Sort function.
+ * Parameters:
+ * 	@kernel is the kernel
+ * Return: The name of the kernel
+ * Time complexity: O(1)
+ * Space complexity: O(1)
+ */
+const char *SortKernelName(sort_kernel_t kernel);
+
+/*
+ * Description: The function sorts strings in the byte order of memcmp, a string goes 
+ *              before the longer strings it is a prefix of. Large groups are split by
+ *              MSD radix passes over the next byte, small ones by a multikey quicksort
+ *              over the cached words of 8 bytes. The threads share the buckets of the
+ *              first pass, after the prefix common to all the strings.
+ * Parameters:
+ * 	@strings is an array of strings, their prefixes are overwritten
+ *	@size is a size of the array
+ *	@maxthreads is the largest number of threads
+ * Return: Nothing
+ * Time complexity: O(D + n * log(n)), D is the number of the bytes that tell the strings apart
+ * Space complexity: O(n)
+ */
+void StringSort(sort_string_t *strings, size_t size, int maxthreads);
+
+/*
+ * Description: The function runs count tasks of an array in parallel and returns when all of
+ *              them are done. The calling thread takes the first task, a task whose thread
+ *              cannot be created is run inline, so the tasks may not wait for each other.
+ * Parameters:
+ * 	@tasks is an array of count tasks
+ *	@task_size is the size of one task in bytes
+ *	@count is the number of tasks
+ *	@routine is the function run on a pointer to every task
+ * Return: Nothing
+ * Time complexity: O(1) besides the tasks
+ * Space complexity: O(count)
+ */
+void RunTasks(void *tasks, size_t task_size, int count, void *(*routine)(void *));
+
+/*
+ * Description: The function finds the first element of a sorted array which is not less than
+ *              a given value.
+ * Parameters:
+ * 	@arr is a sorted array of integers
+ *	@size is a size of the array
+ *	@value is the value to look for
+ * Return: The index of the element, size if all elements are less than the value
+ * Time complexity: O(log(n))
+ * Space complexity: O(1)
+ */
+size_t LowerBound(const int *arr, size_t size, int value);
+
+/*
+ * Description: The function returns the SplitMix64 hash of a counter. The value depends only
+ *              on the counter, so threads generate any part of a random array independently.
+ * Parameters:
+ * 	@counter is the position in the random sequence
+ * Return: A uniformly distributed 64-bit value
+ * Time complexity: O(1)
+ * Space complexity: O(1)
+ */
+uint64_t SplitMix64(uint64_t counter);
+
 #endif // __TD_SORTS_H__
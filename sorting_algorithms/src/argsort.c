@@ -0,0 +1,525 @@
+#include <stdio.h>      /* perror */
+#include <stdlib.h>     /* malloc */
+#include <string.h>     /* memcpy */
+#include <stdint.h>     /* uint32_t, uint64_t */
+
+#include "sorts.h"      /* RunTasks */
+#include "argsort.h"
+
+/* Bits of the key sorted by one pass of the radix sort of the pairs */
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+/* Ranges of pairs of at most this size are finished by insertion sort */
+#define PAIRS_SMALL 16
+/* The gathers fetch the record or the row needed this many ahead */
+#define GATHER_PREFETCH 16
+/* Groups of equal rows below this size are reordered by the quicksort of the pairs, the radix passes cost more */
+#define COLUMNS_RADIX_MIN 4096
+
+#define TRUE 1
+#define FALSE 0
+
+typedef struct radix_task radix_task_t;
+typedef struct gather_task gather_task_t;
+typedef struct column_task column_task_t;
+
+/* The chunk [left, right) of a pass of the radix sort of the pairs */
+struct radix_task
+{
+    const uint64_t *src;
+    uint64_t *dst;
+    size_t left;
+    size_t right;
+    int shift;
+    size_t histogram[RADIX_BUCKETS]; /* The counts of the digits of the chunk, then the offsets of its buckets */
+};
+
+struct gather_task
+{
+    const char *records;
+    char *out;
+    size_t record;
+    const uint32_t *perm;
+    size_t left;
+    size_t right;
+};
+
+/* The rows [left, right) of the permutation gathered from every column */
+struct column_task
+{
+    const int *const *columns;
+    int **out;
+    size_t ncolumns;
+    const uint32_t *perm;
+    size_t left;
+    size_t right;
+};
+
+void RadixSortPairs(uint64_t *pairs, size_t size, int maxthreads);
+void *RadixCountThread(void *radix_task);
+void *RadixScatterThread(void *radix_task);
+void QuicksortPairs(uint64_t *pairs, size_t low, size_t high);
+void SwapPairs(uint64_t *a, uint64_t *b);
+void *GatherThread(void *gather_task);
+size_t PlanColumns(const int *const *columns, size_t ncolumns, size_t size, int *mins, int *shifts, size_t *chunks);
+uint32_t ChunkKey(const int *const *columns, const int *mins, const int *shifts, size_t first, size_t last, uint32_t row);
+void *GatherColumnsThread(void *column_task);
+
+uint64_t PackPair(int key, uint32_t index)
+{
+    /* Flipping the sign bit orders the keys as unsigned, the index below the key breaks the ties stably */
+    return ((uint64_t)((uint32_t)key ^ 0x80000000U) << 32) | index;
+}
+
+int Argsort(const int *keys, size_t size, uint32_t *perm, char engine, int maxthreads)
+{
+    uint64_t *pairs = (uint64_t *)malloc(sizeof(uint64_t) * size);
+    if (NULL == pairs)
+    {
+        perror("Allocation memory is failure!");
+        return 1;
+    }
+
+    for (size_t idx = 0; idx < size; ++idx)
+    {
+        pairs[idx] = PackPair(keys[idx], (uint32_t)idx);
+    }
+
+    SortPairs(pairs, size, engine, maxthreads);
+
+    for (size_t idx = 0; idx < size; ++idx)
+    {
+        perm[idx] = (uint32_t)pairs[idx];
+    }
+
+    free(pairs);
+    return 0;
+}
+
+void SortPairs(uint64_t *pairs, size_t size, char engine, int maxthreads)
+{
+    if (2 > size)
+    {
+        return;
+    }
+
+    if ('Q' == engine || 'q' == engine)
+    {
+        QuicksortPairs(pairs, 0, size - 1);
+    }
+    else
+    {
+        RadixSortPairs(pairs, size, maxthreads);
+    }
+}
+
+void QuicksortPairs(uint64_t *pairs, size_t low, size_t high)
+{
+    /* The pairs are unique, so a plain median of three quicksort cannot degrade on duplicates */
+    while (high - low + 1 > PAIRS_SMALL)
+    {
+        size_t mid = low + (high - low) / 2;
+
+        if (pairs[mid] < pairs[low])
+        {
+            SwapPairs(&pairs[mid], &pairs[low]);
+        }
+        if (pairs[high] < pairs[low])
+        {
+            SwapPairs(&pairs[high], &pairs[low]);
+        }
+        if (pairs[high] < pairs[mid])
+        {
+            SwapPairs(&pairs[high], &pairs[mid]);
+        }
+
+        uint64_t pivot = pairs[mid];
+        size_t i = low;
+        size_t j = high;
+
+        while (i <= j)
+        {
+            while (pairs[i] < pivot)
+            {
+                ++i;
+            }
+            while (pairs[j] > pivot)
+            {
+                --j;
+            }
+            if (i <= j)
+            {
+                SwapPairs(&pairs[i++], &pairs[j--]);
+            }
+        }
+
+        /* Recursion on the smaller side keeps the stack logarithmic */
+        if (j - low < high - i)
+        {
+            QuicksortPairs(pairs, low, j);
+            low = i;
+        }
+        else
+        {
+            QuicksortPairs(pairs, i, high);
+            high = j;
+        }
+    }
+
+    for (size_t idx = low + 1; idx <= high; ++idx)
+    {
+        uint64_t key = pairs[idx];
+        size_t jdx = idx;
+
+        while (jdx > low && pairs[jdx - 1] > key)
+        {
+            pairs[jdx] = pairs[jdx - 1];
+            --jdx;
+        }
+        pairs[jdx] = key;
+    }
+}
+
+void SwapPairs(uint64_t *a, uint64_t *b)
+{
+    uint64_t temp = *a;
+    *a = *b;
+    *b = temp;
+}
+
+void *RadixCountThread(void *radix_task)
+{
+    radix_task_t *task = (radix_task_t *)radix_task;
+
+    memset(task->histogram, 0, sizeof(task->histogram));
+    for (size_t idx = task->left; idx < task->right; ++idx)
+    {
+        ++task->histogram[(task->src[idx] >> task->shift) & (RADIX_BUCKETS - 1)];
+    }
+
+    return NULL;
+}
+
+void *RadixScatterThread(void *radix_task)
+{
+    radix_task_t *task = (radix_task_t *)radix_task;
+
+    /* The histogram holds the start offsets of the buckets of the chunk by now */
+    for (size_t idx = task->left; idx < task->right; ++idx)
+    {
+        int bucket = (task->src[idx] >> task->shift) & (RADIX_BUCKETS - 1);
+        task->dst[task->histogram[bucket]++] = task->src[idx];
+    }
+
+    return NULL;
+}
+
+void RadixSortPairs(uint64_t *pairs, size_t size, int maxthreads)
+{
+    uint64_t *src = pairs;
+    uint64_t *dst = NULL;
+    radix_task_t *tasks = NULL;
+
+    if ((size_t)maxthreads > size)
+    {
+        maxthreads = (int)size;
+    }
+
+    dst = (uint64_t *)malloc(sizeof(uint64_t) * size);
+    tasks = (radix_task_t *)calloc(maxthreads, sizeof(radix_task_t));
+    if (NULL == dst || NULL == tasks)
+    {
+        /* The quicksort of the pairs needs no buffer */
+        free(dst);
+        free(tasks);
+        QuicksortPairs(pairs, 0, size - 1);
+        return;
+    }
+
+    for (int thread = 0; thread < maxthreads; ++thread)
+    {
+        tasks[thread].left = size * thread / maxthreads;
+        tasks[thread].right = size * (thread + 1) / maxthreads;
+    }
+
+    /* Only the key half of the pairs is sorted, the indexes are already in order */
+    for (int shift = 32; shift < 64; shift += RADIX_BITS)
+    {
+        size_t offset = 0;
+        int is_single = FALSE;
+
+        for (int thread = 0; thread < maxthreads; ++thread)
+        {
+            tasks[thread].src = src;
+            tasks[thread].dst = dst;
+            tasks[thread].shift = shift;
+        }
+        RunTasks(tasks, sizeof(radix_task_t), maxthreads, RadixCountThread);
+
+        /* Turn the counts into offsets, bucket by bucket and thread by thread within a bucket */
+        for (int bucket = 0; bucket < RADIX_BUCKETS; ++bucket)
+        {
+            size_t total = 0;
+
+            for (int thread = 0; thread < maxthreads; ++thread)
+            {
+                size_t count = tasks[thread].histogram[bucket];
+
+                tasks[thread].histogram[bucket] = offset + total;
+                total += count;
+            }
+
+            is_single |= (total == size);
+            offset += total;
+        }
+
+        /* A pass where all the keys share the digit would only copy the pairs */
+        if (FALSE == is_single)
+        {
+            RunTasks(tasks, sizeof(radix_task_t), maxthreads, RadixScatterThread);
+
+            uint64_t *temp = src;
+            src = dst;
+            dst = temp;
+        }
+    }
+
+    /* Skipped passes can leave the result in the buffer */
+    if (src != pairs)
+    {
+        memcpy(pairs, src, sizeof(uint64_t) * size);
+        dst = src;
+    }
+
+    free(dst);
+    free(tasks);
+}
+
+void *GatherThread(void *gather_task)
+{
+    gather_task_t *task = (gather_task_t *)gather_task;
+
+    /* The output is written sequentially, the random reads are requested ahead to overlap their misses */
+    for (size_t idx = task->left; idx < task->right; ++idx)
+    {
+        if (idx + GATHER_PREFETCH < task->right)
+        {
+            __builtin_prefetch(task->records + task->perm[idx + GATHER_PREFETCH] * task->record);
+        }
+
+        memcpy(task->out + idx * task->record, task->records + task->perm[idx] * task->record, task->record);
+    }
+
+    return NULL;
+}
+
+void GatherRecords(const void *records, void *out, size_t record, const uint32_t *perm, size_t size, int maxthreads)
+{
+    gather_task_t *tasks = (gather_task_t *)calloc(maxthreads, sizeof(gather_task_t));
+    gather_task_t task = {(const char *)records, (char *)out, record, perm, 0, size};
+
+    /* Without the tasks the calling thread gathers everything */
+    if (NULL == tasks)
+    {
+        GatherThread(&task);
+        return;
+    }
+
+    for (int thread = 0; thread < maxthreads; ++thread)
+    {
+        tasks[thread].records = (const char *)records;
+        tasks[thread].out = (char *)out;
+        tasks[thread].record = record;
+        tasks[thread].perm = perm;
+        tasks[thread].left = size * thread / maxthreads;
+        tasks[thread].right = size * (thread + 1) / maxthreads;
+    }
+
+    RunTasks(tasks, sizeof(gather_task_t), maxthreads, GatherThread);
+
+    free(tasks);
+}
+
+size_t PlanColumns(const int *const *columns, size_t ncolumns, size_t size, int *mins, int *shifts, size_t *chunks)
+{
+    int widths[MAX_COLUMNS] = {0};
+    size_t nchunks = 0;
+    int bits = 0;
+
+    for (size_t column = 0; column < ncolumns; ++column)
+    {
+        int low = columns[column][0];
+        int high = columns[column][0];
+
+        for (size_t idx = 1; idx < size; ++idx)
+        {
+            low = (columns[column][idx] < low) ? columns[column][idx] : low;
+            high = (columns[column][idx] > high) ? columns[column][idx] : high;
+        }
+
+        /* A column is stored as its offset from the minimum, in as many bits as its range takes */
+        uint32_t range = (uint32_t)high - (uint32_t)low;
+        mins[column] = low;
+        widths[column] = (0 == range) ? 0 : 32 - __builtin_clz(range);
+
+        /* The columns are packed into one key while their widths fit, the first one in the highest bits */
+        if (0 == column || bits + widths[column] > 32)
+        {
+            chunks[nchunks++] = column;
+            bits = 0;
+        }
+        bits += widths[column];
+    }
+    chunks[nchunks] = ncolumns;
+
+    for (size_t chunk = 0; chunk < nchunks; ++chunk)
+    {
+        int shift = 0;
+
+        for (size_t column = chunks[chunk + 1]; column-- > chunks[chunk]; )
+        {
+            shifts[column] = (0 == widths[column]) ? 0 : shift;
+            shift += widths[column];
+        }
+    }
+
+    return nchunks;
+}
+
+uint32_t ChunkKey(const int *const *columns, const int *mins, const int *shifts, size_t first, size_t last, uint32_t row)
+{
+    uint32_t key = 0;
+
+    for (size_t column = first; column < last; ++column)
+    {
+        key |= ((uint32_t)columns[column][row] - (uint32_t)mins[column]) << shifts[column];
+    }
+
+    return key;
+}
+
+size_t ArgsortColumns(const int *const *columns, size_t ncolumns, size_t size, uint32_t *perm, char engine, int maxthreads)
+{
+    int mins[MAX_COLUMNS];
+    int shifts[MAX_COLUMNS];
+    size_t chunks[MAX_COLUMNS + 1];
+    uint64_t *pairs = (uint64_t *)malloc(sizeof(uint64_t) * size);
+    uint8_t *starts = (uint8_t *)malloc(size);
+
+    if (0 == size || 0 == ncolumns || MAX_COLUMNS < ncolumns || NULL == pairs || NULL == starts)
+    {
+        free(pairs);
+        free(starts);
+        return 0;
+    }
+
+    size_t nchunks = PlanColumns(columns, ncolumns, size, mins, shifts, chunks);
+
+    /* The first key orders the whole table, narrow tables are sorted by this single pass */
+    for (size_t idx = 0; idx < size; ++idx)
+    {
+        pairs[idx] = ((uint64_t)ChunkKey(columns, mins, shifts, chunks[0], chunks[1], idx) << 32) | idx;
+    }
+
+    SortPairs(pairs, size, engine, maxthreads);
+
+    for (size_t idx = 0; idx < size; ++idx)
+    {
+        perm[idx] = (uint32_t)pairs[idx];
+        starts[idx] = (0 == idx || (pairs[idx] >> 32) != (pairs[idx - 1] >> 32));
+    }
+
+    /* Every next key only reorders the groups of rows that are equal on all the keys before it */
+    for (size_t chunk = 1; chunk < nchunks; ++chunk)
+    {
+        size_t last = 0;
+
+        for (size_t first = 0; first < size; first = last)
+        {
+            for (last = first + 1; last < size && !starts[last]; ++last)
+            {
+            }
+
+            if (2 > last - first)
+            {
+                continue;
+            }
+
+            for (size_t idx = first; idx < last; ++idx)
+            {
+                pairs[idx] = ((uint64_t)ChunkKey(columns, mins, shifts, chunks[chunk], chunks[chunk + 1], perm[idx]) << 32) | perm[idx];
+            }
+
+            if (last - first < COLUMNS_RADIX_MIN)
+            {
+                QuicksortPairs(pairs, first, last - 1);
+            }
+            else
+            {
+                SortPairs(pairs + first, last - first, engine, maxthreads);
+            }
+
+            for (size_t idx = first; idx < last; ++idx)
+            {
+                perm[idx] = (uint32_t)pairs[idx];
+                starts[idx] |= (idx > first && (pairs[idx] >> 32) != (pairs[idx - 1] >> 32));
+            }
+        }
+    }
+
+    free(pairs);
+    free(starts);
+    return nchunks;
+}
+
+void *GatherColumnsThread(void *column_task)
+{
+    column_task_t *task = (column_task_t *)column_task;
+
+    /* One column at a time: the random reads stay within one array, which keeps the TLB misses down, 
+     * gathering a block of rows from every column before the next block measured slower */
+    for (size_t column = 0; column < task->ncolumns; ++column)
+    {
+        const int *values = task->columns[column];
+        int *out = task->out[column];
+
+        for (size_t idx = task->left; idx < task->right; ++idx)
+        {
+            if (idx + GATHER_PREFETCH < task->right)
+            {
+                __builtin_prefetch(&values[task->perm[idx + GATHER_PREFETCH]]);
+            }
+
+            out[idx] = values[task->perm[idx]];
+        }
+    }
+
+    return NULL;
+}
+
+void GatherColumns(const int *const *columns, int **out, size_t ncolumns, const uint32_t *perm, size_t size, int maxthreads)
+{
+    column_task_t *tasks = (column_task_t *)calloc(maxthreads, sizeof(column_task_t));
+    column_task_t task = {columns, out, ncolumns, perm, 0, size};
+
+    /* Without the tasks the calling thread gathers everything */
+    if (NULL == tasks)
+    {
+        GatherColumnsThread(&task);
+        return;
+    }
+
+    for (int thread = 0; thread < maxthreads; ++thread)
+    {
+        tasks[thread].columns = columns;
+        tasks[thread].out = out;
+        tasks[thread].ncolumns = ncolumns;
+        tasks[thread].perm = perm;
+        tasks[thread].left = size * thread / maxthreads;
+        tasks[thread].right = size * (thread + 1) / maxthreads;
+    }
+
+    RunTasks(tasks, sizeof(column_task_t), maxthreads, GatherColumnsThread);
+
+    free(tasks);
+}
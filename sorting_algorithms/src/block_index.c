@@ -0,0 +1,173 @@
+#include <stdio.h>      /* perror, printf */
+#include <string.h>     /* memcpy */
+#include <stdint.h>     /* uint64_t */
+#include <fcntl.h>      /* open */
+#include <unistd.h>     /* close */
+#include <sys/mman.h>   /* mmap */
+#include <sys/stat.h>   /* fstat */
+
+#include "block_index.h"
+
+/* The integers of a block of an indexed file, a page of 4 KB */
+#define INDEX_BLOCK (4096 / sizeof(int))
+/* "SORTIDX1" read as a little-endian integer */
+#define INDEX_MAGIC 0x3158444954524F53ULL
+
+#define TRUE 1
+#define FALSE 0
+
+typedef struct index_trailer index_trailer_t;
+
+/* The end of an indexed file: the data are followed by the first keys of their blocks and this */
+struct index_trailer
+{
+    uint64_t magic;
+    uint64_t count;     /* The number of integers of the data */
+    uint64_t nblocks;   /* The number of blocks and of their first keys */
+    uint64_t block;     /* The number of integers of a block */
+};
+
+int WriteIndexed(const char *path, const int *array, size_t size)
+{
+    index_trailer_t trailer = {INDEX_MAGIC, size, (size + INDEX_BLOCK - 1) / INDEX_BLOCK, INDEX_BLOCK};
+    FILE *file = fopen(path, "wb");
+    int status = 0;
+
+    if (NULL == file)
+    {
+        perror("Error opening output file");
+        return 1;
+    }
+
+    /* The first key of every block is gathered right after the data, the trailer closes the file */
+    status |= (size != fwrite(array, sizeof(int), size, file));
+    for (size_t block = 0; block < trailer.nblocks; ++block)
+    {
+        status |= (1 != fwrite(&array[block * INDEX_BLOCK], sizeof(int), 1, file));
+    }
+    status |= (1 != fwrite(&trailer, sizeof(trailer), 1, file));
+    status |= (0 != fclose(file));
+
+    if (0 != status)
+    {
+        perror("Error writing output file");
+    }
+
+    return status;
+}
+
+int OpenIndexed(const char *path, indexed_file_t *indexed)
+{
+    struct stat info;
+    index_trailer_t trailer;
+    int fd = open(path, O_RDONLY);
+
+    memset(indexed, 0, sizeof(*indexed));
+    if (-1 == fd || 0 != fstat(fd, &info) || (size_t)info.st_size < sizeof(trailer))
+    {
+        perror("Error opening indexed file");
+        if (-1 != fd)
+        {
+            close(fd);
+        }
+        return 1;
+    }
+
+    indexed->bytes = info.st_size;
+    indexed->map = mmap(NULL, indexed->bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (MAP_FAILED == indexed->map)
+    {
+        perror("Error mapping indexed file");
+        return 1;
+    }
+
+    /* The count is bounded by the file before any product of it is taken, so a crafted trailer cannot wrap the check */
+    memcpy(&trailer, (char *)indexed->map + indexed->bytes - sizeof(trailer), sizeof(trailer));
+    size_t capacity = (indexed->bytes - sizeof(trailer)) / sizeof(int);
+    if (INDEX_MAGIC != trailer.magic || INDEX_BLOCK != trailer.block || trailer.count > capacity ||
+            trailer.nblocks != (trailer.count + INDEX_BLOCK - 1) / INDEX_BLOCK ||
+            capacity - trailer.count != trailer.nblocks || 0 != (indexed->bytes - sizeof(trailer)) % sizeof(int))
+    {
+        printf("ERROR - %s Is Not An Indexed File\n", path);
+        munmap(indexed->map, indexed->bytes);
+        return 1;
+    }
+
+    indexed->data = (const int *)indexed->map;
+    indexed->fences = indexed->data + trailer.count;
+    indexed->count = trailer.count;
+    indexed->nblocks = trailer.nblocks;
+    indexed->block = trailer.block;
+
+    /* The lookups jump around the data, read-ahead would only fetch blocks nobody asked for */
+    madvise(indexed->map, trailer.count * sizeof(int), MADV_RANDOM);
+    return 0;
+}
+
+void CloseIndexed(indexed_file_t *indexed)
+{
+    if (NULL != indexed->map)
+    {
+        munmap(indexed->map, indexed->bytes);
+    }
+
+    memset(indexed, 0, sizeof(*indexed));
+}
+
+size_t IndexedBound(const indexed_file_t *indexed, int key, int is_upper)
+{
+    size_t low = 0;
+    size_t high = indexed->nblocks;
+
+    /* Blocks starting before the bound, in the index only */
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+
+        if (indexed->fences[middle] < key || (is_upper && indexed->fences[middle] == key))
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    if (0 == low)
+    {
+        return 0;
+    }
+
+    /* The bound lies in the last of them or at the start of the next one, so one block of data is read */
+    size_t first = (low - 1) * indexed->block;
+    size_t last = (low * indexed->block < indexed->count) ? low * indexed->block : indexed->count;
+
+    while (first < last)
+    {
+        size_t middle = first + (last - first) / 2;
+
+        if (indexed->data[middle] < key || (is_upper && indexed->data[middle] == key))
+        {
+            first = middle + 1;
+        }
+        else
+        {
+            last = middle;
+        }
+    }
+
+    return first;
+}
+
+size_t IndexedRange(const indexed_file_t *indexed, int low, int high, size_t *first)
+{
+    *first = IndexedBound(indexed, low, FALSE);
+    if (high < low)
+    {
+        return 0;
+    }
+
+    return IndexedBound(indexed, high, TRUE) - *first;
+}
@@ -0,0 +1,360 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>      /* perror, fprintf */
+#include <stdlib.h>     /* malloc */
+#include <string.h>     /* memset */
+#include <signal.h>     /* sigaction */
+#include <fcntl.h>      /* fcntl, F_GET_SEALS */
+#include <unistd.h>     /* pread, pwrite */
+#include <sys/mman.h>   /* mmap, memfd_create */
+#include <sys/socket.h> /* accept */
+#include <sys/stat.h>   /* fstat */
+#include <poll.h>       /* poll */
+#include <time.h>       /* clock_gettime */
+#include <sys/un.h>     /* sockaddr_un */
+
+#include "sorts.h"      /* Sort, RunTasks */
+#include "sockets.h"    /* ReceiveDescriptor */
+#include "daemon.h"
+
+/* The maximum number of requests the daemon sorts as one batch */
+#define DAEMON_BATCH 64
+/* Smaller buffers are sorted by one thread each, larger ones by all of them */
+#define DAEMON_SMALL (1 << 16)
+/* The time in ms the clients of a batch have together to send their requests before they are dropped */
+#define DAEMON_TIMEOUT 1000
+
+#define TRUE 1
+#define FALSE 0
+
+typedef struct sort_job sort_job_t;
+typedef struct daemon_task daemon_task_t;
+
+/* A request of a batch of the daemon */
+struct sort_job
+{
+    int client;         /* The connection of the client */
+    int fd;             /* The buffer of the client */
+    int *array;         /* The private copy of the buffer */
+    size_t size;
+    int status;
+};
+
+/* Every step-th job of a batch starting at first */
+struct daemon_task
+{
+    sort_job_t *jobs;
+    size_t njobs;
+    size_t first;
+    size_t step;
+};
+
+/* Set by the signals that stop the daemon */
+static volatile sig_atomic_t is_stopped = FALSE;
+
+void StopDaemon(int signal_number);
+void OpenJob(int client, sort_job_t *job);
+void AcceptRequest(sort_job_t *job, size_t *inflight, size_t cap);
+void ReceiveRequests(sort_job_t *jobs, size_t njobs, size_t cap);
+int TransferBuffer(int fd, int *array, size_t size, int is_writing);
+void *DaemonThread(void *daemon_task);
+void SortBatch(sort_job_t *jobs, size_t njobs, int maxthreads);
+
+void StopDaemon(int signal_number)
+{
+    (void)signal_number;
+    is_stopped = TRUE;
+}
+
+void OpenJob(int client, sort_job_t *job)
+{
+    job->client = client;
+    job->fd = -1;
+    job->array = NULL;
+    job->size = 0;
+    job->status = DAEMON_INVALID;
+
+    /* The request is read only once poll reports it, a client that sent a part of it cannot block the daemon */
+    fcntl(client, F_SETFL, O_NONBLOCK);
+}
+
+void AcceptRequest(sort_job_t *job, size_t *inflight, size_t cap)
+{
+    sort_request_t request;
+    struct stat info;
+
+    if (0 != ReceiveDescriptor(job->client, &job->fd, &request, sizeof(request)) || 
+            0 != fstat(job->fd, &info) || request.size > (size_t)info.st_size / sizeof(int))
+    {
+        return;
+    }
+
+    /* The sorted values are written back over the whole buffer, so it may not shrink in between */
+    int seals = fcntl(job->fd, F_GET_SEALS);
+    if (-1 == seals || 0 == (seals & F_SEAL_SHRINK))
+    {
+        return;
+    }
+
+    /* Admission control: the buffers being sorted together may not exceed the cap */
+    job->size = request.size;
+    if (job->size > cap / sizeof(int))
+    {
+        job->status = DAEMON_TOO_LARGE;
+        return;
+    }
+
+    if (*inflight + job->size * sizeof(int) > cap)
+    {
+        job->status = DAEMON_BUSY;
+        return;
+    }
+
+    /* The client can still write its buffer, so the kernels sort a copy whose values cannot change under them */
+    if (0 != job->size)
+    {
+        job->array = (int *)malloc(job->size * sizeof(int));
+        if (NULL == job->array || 0 != TransferBuffer(job->fd, job->array, job->size, FALSE))
+        {
+            free(job->array);
+            job->array = NULL;
+            return;
+        }
+    }
+
+    *inflight += job->size * sizeof(int);
+    job->status = DAEMON_OK;
+}
+
+void ReceiveRequests(sort_job_t *jobs, size_t njobs, size_t cap)
+{
+    struct pollfd fds[DAEMON_BATCH];
+    struct timespec start;
+    struct timespec now;
+    size_t npending = njobs;
+    size_t inflight = 0;
+
+    for (size_t idx = 0; idx < njobs; ++idx)
+    {
+        fds[idx].fd = jobs[idx].client;
+        fds[idx].events = POLLIN;
+        fds[idx].revents = 0;
+    }
+
+    /* One deadline for the whole batch, so the clients that stay silent delay the others at most once */
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (0 != npending)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long elapsed = (now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000;
+        if (elapsed >= DAEMON_TIMEOUT || 0 >= poll(fds, njobs, DAEMON_TIMEOUT - elapsed))
+        {
+            break;
+        }
+
+        /* A served client is taken out of the poll by a negative descriptor */
+        for (size_t idx = 0; idx < njobs; ++idx)
+        {
+            if (-1 != fds[idx].fd && 0 != fds[idx].revents)
+            {
+                AcceptRequest(&jobs[idx], &inflight, cap);
+                fds[idx].fd = -1;
+                --npending;
+            }
+        }
+    }
+}
+
+int TransferBuffer(int fd, int *array, size_t size, int is_writing)
+{
+    char *data = (char *)array;
+    size_t bytes = size * sizeof(int);
+    off_t offset = 0;
+
+    while (0 != bytes)
+    {
+        ssize_t result = (TRUE == is_writing) ? pwrite(fd, data, bytes, offset) : pread(fd, data, bytes, offset);
+        if (0 >= result)
+        {
+            return 1;
+        }
+        data += result;
+        offset += result;
+        bytes -= result;
+    }
+
+    return 0;
+}
+
+void *DaemonThread(void *daemon_task)
+{
+    daemon_task_t *task = (daemon_task_t *)daemon_task;
+
+    /* The small buffers of a batch are dealt out to the threads, each of them is sorted by one thread */
+    for (size_t idx = task->first; idx < task->njobs; idx += task->step)
+    {
+        sort_job_t *job = &task->jobs[idx];
+
+        if (DAEMON_OK == job->status && job->size < DAEMON_SMALL)
+        {
+            Sort(job->array, job->size, 1, NULL);
+        }
+    }
+
+    return NULL;
+}
+
+void SortBatch(sort_job_t *jobs, size_t njobs, int maxthreads)
+{
+    daemon_task_t tasks[DAEMON_BATCH];
+    size_t nsmall = 0;
+
+    for (size_t idx = 0; idx < njobs; ++idx)
+    {
+        nsmall += (DAEMON_OK == jobs[idx].status && jobs[idx].size < DAEMON_SMALL);
+    }
+
+    int nthreads = (nsmall < (size_t)maxthreads) ? (int)nsmall : maxthreads;
+    for (int thread = 0; thread < nthreads; ++thread)
+    {
+        tasks[thread].jobs = jobs;
+        tasks[thread].njobs = njobs;
+        tasks[thread].first = thread;
+        tasks[thread].step = nthreads;
+    }
+    RunTasks(tasks, sizeof(daemon_task_t), nthreads, DaemonThread);
+
+    /* A large buffer gets the whole pool */
+    for (size_t idx = 0; idx < njobs; ++idx)
+    {
+        if (DAEMON_OK == jobs[idx].status && jobs[idx].size >= DAEMON_SMALL)
+        {
+            Sort(jobs[idx].array, jobs[idx].size, maxthreads, NULL);
+        }
+    }
+}
+
+int ServeSorts(const char *path, int maxthreads, size_t cap)
+{
+    struct sigaction action;
+    sort_job_t jobs[DAEMON_BATCH];
+    size_t served = 0;
+    int listener = ListenSocket(path);
+
+    if (-1 == listener)
+    {
+        return 1;
+    }
+
+    /* Without SA_RESTART the signal interrupts the waiting accept */
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = StopDaemon;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    fprintf(stderr, "Serving on %s with %d threads\n", path, maxthreads);
+
+    while (FALSE == is_stopped)
+    {
+        size_t njobs = 0;
+        int client = accept(listener, NULL, NULL);
+
+        if (-1 == client)
+        {
+            continue;
+        }
+
+        /* The clients that are already waiting join the batch of the first one */
+        OpenJob(client, &jobs[njobs++]);
+        fcntl(listener, F_SETFL, O_NONBLOCK);
+        while (njobs < DAEMON_BATCH && -1 != (client = accept(listener, NULL, NULL)))
+        {
+            OpenJob(client, &jobs[njobs++]);
+        }
+        fcntl(listener, F_SETFL, 0);
+
+        ReceiveRequests(jobs, njobs, cap);
+        SortBatch(jobs, njobs, maxthreads);
+
+        /* The reply tells the client that the sorted copy is written back into its buffer */
+        for (size_t idx = 0; idx < njobs; ++idx)
+        {
+            sort_reply_t reply = {jobs[idx].status};
+
+            if (NULL != jobs[idx].array)
+            {
+                if (0 != TransferBuffer(jobs[idx].fd, jobs[idx].array, jobs[idx].size, TRUE))
+                {
+                    reply.status = DAEMON_INVALID;
+                }
+                free(jobs[idx].array);
+            }
+            if (-1 != jobs[idx].fd)
+            {
+                close(jobs[idx].fd);
+            }
+            SendAll(jobs[idx].client, &reply, sizeof(reply));
+            close(jobs[idx].client);
+        }
+
+        served += njobs;
+        fprintf(stderr, "Batch of %lu requests, %lu served\n", njobs, served);
+    }
+
+    close(listener);
+    unlink(path);
+    return 0;
+}
+
+int *CreateSortBuffer(size_t size, int *fd)
+{
+    size_t bytes = size * sizeof(int);
+    int *array = NULL;
+
+    /* The daemon maps only a buffer that can no longer shrink under it */
+    *fd = memfd_create("sort", MFD_ALLOW_SEALING);
+    if (-1 == *fd || 0 != ftruncate(*fd, bytes) || 0 != fcntl(*fd, F_ADD_SEALS, F_SEAL_SHRINK))
+    {
+        perror("Creation of the shared buffer is failure!");
+        if (-1 != *fd)
+        {
+            close(*fd);
+        }
+        return NULL;
+    }
+
+    array = (int *)mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, *fd, 0);
+    if (MAP_FAILED == array)
+    {
+        perror("Allocation memory is failure!");
+        close(*fd);
+        return NULL;
+    }
+
+    return array;
+}
+
+int RequestSort(const char *path, int fd, size_t size)
+{
+    struct sockaddr_un address;
+    sort_request_t request = {size};
+    sort_reply_t reply = {DAEMON_INVALID};
+    int server = OpenSocket(path, &address);
+
+    if (-1 == server)
+    {
+        return DAEMON_INVALID;
+    }
+
+    if (0 != connect(server, (struct sockaddr *)&address, sizeof(address)) ||
+            0 != SendDescriptor(server, fd, &request, sizeof(request)) || 
+            0 != ReceiveAll(server, &reply, sizeof(reply)))
+    {
+        perror("Request to the daemon is failure!");
+        reply.status = DAEMON_INVALID;
+    }
+
+    close(server);
+    return reply.status;
+}
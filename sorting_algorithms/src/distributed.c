@@ -0,0 +1,321 @@
+#include <stdio.h>      /* perror */
+#include <stdlib.h>     /* malloc, exit */
+#include <string.h>     /* memcpy */
+#include <stdint.h>     /* uint8_t, uint64_t */
+#include <signal.h>     /* kill */
+#include <unistd.h>     /* fork, close */
+#include <sys/mman.h>   /* mmap */
+#include <sys/socket.h> /* socketpair */
+#include <sys/wait.h>   /* waitpid */
+
+#include "sorts.h"      /* LowerBound, SplitMix64 */
+#include "sockets.h"    /* SendAll, ReceiveAll */
+#include "distributed.h"
+
+/* The number of samples every worker sends for the choice of the splitters */
+#define DISTRIBUTED_SAMPLE 256
+/* The phases the workers pass together after the splitters: counting, exchange and sorting */
+#define DISTRIBUTED_PHASES 3
+
+typedef struct worker_report worker_report_t;
+
+/* What a worker of the distributed sort tells the coordinator about its slice */
+struct worker_report
+{
+    int samples[DISTRIBUTED_SAMPLE];
+    size_t nsamples;
+    uint64_t summary[DISTRIBUTED_SUMMARY / sizeof(uint64_t)];
+};
+
+int CoordinatorBarrier(const int *fds, int nprocesses);
+int WorkerBarrier(int fd);
+int DistributedWorker(int rank, int fd, const distributed_t *distributed, const distributed_ops_t *ops);
+int CompareSamples(const void *a, const void *b);
+
+int CoordinatorBarrier(const int *fds, int nprocesses)
+{
+    char token = 0;
+
+    /* Every worker reports the end of its phase, then all of them are released together */
+    for (int rank = 0; rank < nprocesses; ++rank)
+    {
+        if (0 != ReceiveAll(fds[rank], &token, 1))
+        {
+            return 1;
+        }
+    }
+
+    for (int rank = 0; rank < nprocesses; ++rank)
+    {
+        if (0 != SendAll(fds[rank], &token, 1))
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int WorkerBarrier(int fd)
+{
+    char token = 0;
+
+    return SendAll(fd, &token, 1) || ReceiveAll(fd, &token, 1);
+}
+
+int DistributedWorker(int rank, int fd, const distributed_t *distributed, const distributed_ops_t *ops)
+{
+    int nprocesses = distributed->nprocesses;
+    size_t first = distributed->size * rank / nprocesses;
+    size_t size = distributed->size * (rank + 1) / nprocesses - first;
+    int *slice = (int *)calloc(size, sizeof(int));
+    uint8_t *buckets = (uint8_t *)malloc(size);
+    int *output = distributed->array;
+    int splitters[MAX_PROCESSES];
+    size_t offsets[MAX_PROCESSES];
+    worker_report_t report;
+    size_t start = 0;
+    size_t bucket_start = 0;
+    size_t bucket_size = 0;
+
+    if (NULL == slice || NULL == buckets)
+    {
+        perror("Allocation memory is failure!");
+        return 1;
+    }
+
+    /* Every worker loads only its own slice of the array */
+    memset(&report, 0, sizeof(report));
+    if (0 != ops->load(slice, first, size, report.summary, ops->context))
+    {
+        return 1;
+    }
+
+    report.nsamples = (size < DISTRIBUTED_SAMPLE) ? size : DISTRIBUTED_SAMPLE;
+    for (size_t idx = 0; idx < report.nsamples; ++idx)
+    {
+        report.samples[idx] = slice[SplitMix64(first + idx) % size];
+    }
+
+    if (0 != SendAll(fd, &report, sizeof(report)) || 0 != ReceiveAll(fd, splitters, sizeof(int) * (nprocesses - 1)))
+    {
+        return 1;
+    }
+
+    /* The row of the worker in the shared table tells everyone how much it sends to whom */
+    for (size_t idx = 0; idx < size; ++idx)
+    {
+        buckets[idx] = (uint8_t)LowerBound(splitters, nprocesses - 1, slice[idx]);
+        ++distributed->counts[rank][buckets[idx]];
+    }
+
+    if (0 != WorkerBarrier(fd))
+    {
+        return 1;
+    }
+
+    /* The buckets are laid out in order of the destinations, and inside of them in order of the sources */
+    for (int destination = 0; destination < nprocesses; ++destination)
+    {
+        if (destination == rank)
+        {
+            bucket_start = start;
+        }
+
+        offsets[destination] = start;
+        for (int source = 0; source < nprocesses; ++source)
+        {
+            if (source < rank)
+            {
+                offsets[destination] += distributed->counts[source][destination];
+            }
+            start += distributed->counts[source][destination];
+        }
+    }
+
+    for (size_t idx = 0; idx < size; ++idx)
+    {
+        output[offsets[buckets[idx]]++] = slice[idx];
+    }
+
+    free(buckets);
+    free(slice);
+
+    if (0 != WorkerBarrier(fd))
+    {
+        return 1;
+    }
+
+    /* The bucket of the worker is contiguous in the shared array, so it is sorted in place */
+    bucket_size = DistributedBucket(distributed, rank);
+    if (1 < bucket_size)
+    {
+        ops->sort(output + bucket_start, bucket_size, ops->context);
+    }
+
+    return WorkerBarrier(fd);
+}
+
+int StartDistributed(distributed_t *distributed, size_t size, int nprocesses, const distributed_ops_t *ops, void *total)
+{
+    memset(distributed, 0, sizeof(*distributed));
+    distributed->size = size;
+    distributed->bytes = sizeof(size_t) * MAX_PROCESSES * MAX_PROCESSES + sizeof(int) * size;
+
+    if (2 > nprocesses || MAX_PROCESSES < nprocesses || size < (size_t)nprocesses || DISTRIBUTED_SUMMARY < ops->summary_size)
+    {
+        distributed->status = 1;
+        return 1;
+    }
+
+    /* The table of the bucket sizes and the sorted array are shared by all the processes */
+    void *shared = mmap(NULL, distributed->bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    distributed->samples = (int *)malloc(sizeof(int) * DISTRIBUTED_SAMPLE * nprocesses);
+    if (MAP_FAILED == shared || NULL == distributed->samples)
+    {
+        perror("Allocation memory is failure!");
+        if (MAP_FAILED != shared)
+        {
+            munmap(shared, distributed->bytes);
+        }
+        free(distributed->samples);
+        distributed->samples = NULL;
+        distributed->status = 1;
+        return 1;
+    }
+    distributed->counts = (size_t (*)[MAX_PROCESSES])shared;
+    distributed->array = (int *)(distributed->counts + MAX_PROCESSES);
+
+    /* The workers inherit the buffered output, so it is written once before they start */
+    fflush(stdout);
+
+    distributed->nprocesses = nprocesses;
+    for (int rank = 0; rank < nprocesses; ++rank)
+    {
+        int pair[2];
+
+        if (0 != socketpair(AF_UNIX, SOCK_STREAM, 0, pair))
+        {
+            perror("Creation of the socket is failure!");
+            distributed->nprocesses = rank;
+            distributed->status = 1;
+            break;
+        }
+
+        distributed->pids[rank] = fork();
+        if (0 == distributed->pids[rank])
+        {
+            /* The worker keeps only its own end of its own socket */
+            for (int other = 0; other < rank; ++other)
+            {
+                close(distributed->fds[other]);
+            }
+            close(pair[0]);
+            exit(DistributedWorker(rank, pair[1], distributed, ops));
+        }
+
+        close(pair[1]);
+        distributed->fds[rank] = pair[0];
+        if (-1 == distributed->pids[rank])
+        {
+            perror("Creation of the worker process is failure!");
+            close(distributed->fds[rank]);
+            distributed->nprocesses = rank;
+            distributed->status = 1;
+            break;
+        }
+    }
+
+    for (int rank = 0; rank < distributed->nprocesses && 0 == distributed->status; ++rank)
+    {
+        worker_report_t report;
+
+        /* A worker that exited early, e.g. without the input file, closes its socket before the report */
+        if (0 != ReceiveAll(distributed->fds[rank], &report, sizeof(report)) || DISTRIBUTED_SAMPLE < report.nsamples)
+        {
+            distributed->status = 1;
+            break;
+        }
+
+        memcpy(distributed->samples + distributed->nsamples, report.samples, sizeof(int) * report.nsamples);
+        distributed->nsamples += report.nsamples;
+        ops->combine(total, report.summary);
+    }
+
+    return distributed->status;
+}
+
+int CompareSamples(const void *a, const void *b)
+{
+    int first = *(const int *)a;
+    int second = *(const int *)b;
+
+    return (first > second) - (first < second);
+}
+
+int FinishDistributed(distributed_t *distributed)
+{
+    int nprocesses = distributed->nprocesses;
+    int splitters[MAX_PROCESSES];
+    int status = distributed->status;
+
+    /* The splitters are the evenly spaced elements of the sorted samples of all the workers */
+    if (0 == status)
+    {
+        qsort(distributed->samples, distributed->nsamples, sizeof(int), CompareSamples);
+        for (int rank = 1; rank < nprocesses; ++rank)
+        {
+            splitters[rank - 1] = distributed->samples[distributed->nsamples * rank / nprocesses];
+        }
+
+        for (int rank = 0; rank < nprocesses && 0 == status; ++rank)
+        {
+            status = SendAll(distributed->fds[rank], splitters, sizeof(int) * (nprocesses - 1));
+        }
+    }
+
+    /* Counted, exchanged and sorted */
+    for (int phase = 0; phase < DISTRIBUTED_PHASES && 0 == status; ++phase)
+    {
+        status = CoordinatorBarrier(distributed->fds, nprocesses);
+    }
+
+    for (int rank = 0; rank < nprocesses; ++rank)
+    {
+        int worker_status = 0;
+
+        close(distributed->fds[rank]);
+        if (0 != status)
+        {
+            kill(distributed->pids[rank], SIGTERM);
+        }
+        waitpid(distributed->pids[rank], &worker_status, 0);
+        status |= (0 == status && (!WIFEXITED(worker_status) || 0 != WEXITSTATUS(worker_status)));
+    }
+
+    distributed->nprocesses = 0;
+    distributed->status = status;
+    return status;
+}
+
+size_t DistributedBucket(const distributed_t *distributed, int rank)
+{
+    size_t bucket = 0;
+
+    for (int source = 0; source < MAX_PROCESSES; ++source)
+    {
+        bucket += distributed->counts[source][rank];
+    }
+
+    return bucket;
+}
+
+void DestroyDistributed(distributed_t *distributed)
+{
+    if (NULL != distributed->counts)
+    {
+        munmap(distributed->counts, distributed->bytes);
+    }
+    free(distributed->samples);
+    memset(distributed, 0, sizeof(*distributed));
+}
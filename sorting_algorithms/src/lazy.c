@@ -0,0 +1,217 @@
+#include <stdio.h>      /* perror */
+#include <stdlib.h>     /* malloc */
+#include <pthread.h>    /* pthread */
+
+#include "partition.h"  /* Partition */
+#include "lazy.h"
+
+/* A piece of the lazy sort waits for a thread, is being split or sorted, or is at its final position */
+#define LAZY_PENDING 0
+#define LAZY_CLAIMED 1
+#define LAZY_SORTED 2
+/* The first capacity of the stack of the pieces, it grows by doubling */
+#define LAZY_PIECES 64
+
+#define TRUE 1
+#define FALSE 0
+
+int LazyPush(lazy_sort_t *lazy, size_t left, size_t right, int state);
+void *LazyWorker(void *lazy_sort);
+
+lazy_sort_t *CreateLazySort(int *array, size_t size, size_t block, int median, lazy_sort_fn_t sort, const void *context, int nworkers)
+{
+    lazy_sort_t *lazy = NULL;
+
+    if (0 == size || 0 == block)
+    {
+        return NULL;
+    }
+
+    lazy = (lazy_sort_t *)calloc(1, sizeof(lazy_sort_t));
+    if (NULL == lazy)
+    {
+        perror("Allocation memory is failure!");
+        return NULL;
+    }
+
+    lazy->array = array;
+    lazy->size = size;
+    lazy->block = block;
+    lazy->median = median;
+    lazy->sort = sort;
+    lazy->context = context;
+    lazy->workers = (pthread_t *)calloc(nworkers + 1, sizeof(pthread_t));
+    if (NULL == lazy->workers || 0 != LazyPush(lazy, 0, size - 1, LAZY_PENDING))
+    {
+        perror("Allocation memory is failure!");
+        free(lazy->workers);
+        free(lazy);
+        return NULL;
+    }
+
+    pthread_mutex_init(&lazy->mutex, NULL);
+    pthread_cond_init(&lazy->cond, NULL);
+
+    /* Without the workers the consumer sorts every piece itself */
+    for (lazy->nworkers = 0; lazy->nworkers < nworkers; ++lazy->nworkers)
+    {
+        if (0 != pthread_create(&lazy->workers[lazy->nworkers], NULL, LazyWorker, lazy))
+        {
+            perror("Creation of the thread is failure!");
+            break;
+        }
+    }
+
+    return lazy;
+}
+
+void DestroyLazySort(lazy_sort_t *lazy)
+{
+    pthread_mutex_lock(&lazy->mutex);
+    lazy->is_stopping = TRUE;
+    pthread_cond_broadcast(&lazy->cond);
+    pthread_mutex_unlock(&lazy->mutex);
+
+    for (int worker = 0; worker < lazy->nworkers; ++worker)
+    {
+        pthread_join(lazy->workers[worker], NULL);
+    }
+
+    pthread_mutex_destroy(&lazy->mutex);
+    pthread_cond_destroy(&lazy->cond);
+    free(lazy->pieces);
+    free(lazy->workers);
+    free(lazy);
+}
+
+int LazyPush(lazy_sort_t *lazy, size_t left, size_t right, int state)
+{
+    if (lazy->npieces == lazy->capacity)
+    {
+        size_t capacity = (0 == lazy->capacity) ? LAZY_PIECES : 2 * lazy->capacity;
+        lazy_piece_t *pieces = (lazy_piece_t *)realloc(lazy->pieces, sizeof(lazy_piece_t) * capacity);
+        if (NULL == pieces)
+        {
+            return 1;
+        }
+
+        lazy->pieces = pieces;
+        lazy->capacity = capacity;
+    }
+
+    lazy->pieces[lazy->npieces].left = left;
+    lazy->pieces[lazy->npieces].right = right;
+    lazy->pieces[lazy->npieces].state = state;
+    ++lazy->npieces;
+    return 0;
+}
+
+void *LazyWorker(void *lazy_sort)
+{
+    lazy_sort_t *lazy = (lazy_sort_t *)lazy_sort;
+
+    pthread_mutex_lock(&lazy->mutex);
+    while (TRUE)
+    {
+        size_t piece = 0;
+
+        /* The bottom pieces are the farthest from the front, the top one is left to the consumer */
+        while (piece + 1 < lazy->npieces && LAZY_PENDING != lazy->pieces[piece].state)
+        {
+            ++piece;
+        }
+
+        if (piece + 1 >= lazy->npieces)
+        {
+            if (TRUE == lazy->is_stopping)
+            {
+                break;
+            }
+
+            pthread_cond_wait(&lazy->cond, &lazy->mutex);
+            continue;
+        }
+
+        size_t left = lazy->pieces[piece].left;
+        size_t right = lazy->pieces[piece].right;
+
+        lazy->pieces[piece].state = LAZY_CLAIMED;
+        pthread_mutex_unlock(&lazy->mutex);
+
+        lazy->sort(lazy->array + left, right - left + 1, lazy->context);
+
+        /* Only the consumer pops the pieces, so the index of a claimed piece does not change */
+        pthread_mutex_lock(&lazy->mutex);
+        lazy->pieces[piece].state = LAZY_SORTED;
+        pthread_cond_broadcast(&lazy->cond);
+    }
+    pthread_mutex_unlock(&lazy->mutex);
+
+    return NULL;
+}
+
+size_t LazyNext(lazy_sort_t *lazy, const int **block)
+{
+    size_t first = lazy->emitted;
+
+    pthread_mutex_lock(&lazy->mutex);
+    while (0 != lazy->npieces && lazy->emitted - first < lazy->block)
+    {
+        size_t top = lazy->npieces - 1;
+        lazy_piece_t piece = lazy->pieces[top];
+
+        if (LAZY_SORTED == piece.state)
+        {
+            lazy->emitted = piece.right + 1;
+            --lazy->npieces;
+            continue;
+        }
+
+        /* A worker sorts this piece, waiting for it is cheaper than splitting it again */
+        if (LAZY_CLAIMED == piece.state)
+        {
+            pthread_cond_wait(&lazy->cond, &lazy->mutex);
+            continue;
+        }
+
+        lazy->pieces[top].state = LAZY_CLAIMED;
+        pthread_mutex_unlock(&lazy->mutex);
+
+        /* A front piece of a block is sorted at once, a larger one is only split around a pivot */
+        if (piece.right - piece.left < lazy->block)
+        {
+            lazy->sort(lazy->array + piece.left, piece.right - piece.left + 1, lazy->context);
+
+            pthread_mutex_lock(&lazy->mutex);
+            lazy->pieces[top].state = LAZY_SORTED;
+            continue;
+        }
+
+        if (1 == lazy->median)
+        {
+            int mid = piece.left + (piece.right - piece.left) / 2;
+            int median_index = MedianOfThree(lazy->array, piece.left, mid, piece.right);
+            Swap(&lazy->array[piece.left], &lazy->array[median_index]);
+        }
+
+        size_t i = 0;
+        size_t j = 0;
+        Partition(lazy->array, piece.left, piece.right, &i, &j);
+
+        /* The claimed piece is replaced by its parts, the smaller values on the top */
+        pthread_mutex_lock(&lazy->mutex);
+        --lazy->npieces;
+        if ((j < piece.right && 0 != LazyPush(lazy, j + 1, piece.right, LAZY_PENDING)) ||
+                0 != LazyPush(lazy, j, j, LAZY_SORTED) ||
+                (j > piece.left && 0 != LazyPush(lazy, piece.left, j - 1, LAZY_PENDING)))
+        {
+            perror("Allocation memory is failure!");
+            break;
+        }
+        pthread_cond_broadcast(&lazy->cond);
+    }
+    pthread_mutex_unlock(&lazy->mutex);
+
+    *block = lazy->array + first;
+    return lazy->emitted - first;
+}
@@ -0,0 +1,279 @@
+#include <stdio.h>      /* perror */
+#include <stdlib.h>     /* malloc */
+#include <string.h>     /* memcpy */
+#include <limits.h>     /* INT_MAX */
+#include <pthread.h>    /* pthread */
+
+#include "sorts.h"      /* NaturalMergeSort */
+#include "lsm.h"
+
+#define TRUE 1
+#define FALSE 0
+
+int LsmFindCompaction(lsm_t *lsm);
+void *LsmWorker(void *lsm);
+
+lsm_t *CreateLsm(int nworkers)
+{
+    lsm_t *lsm = (lsm_t *)calloc(1, sizeof(lsm_t));
+    if (NULL == lsm)
+    {
+        perror("Allocation memory is failure!");
+        return NULL;
+    }
+
+    lsm->workers = (pthread_t *)calloc(nworkers, sizeof(pthread_t));
+    if (NULL == lsm->workers)
+    {
+        perror("Allocation memory is failure!");
+        free(lsm);
+        return NULL;
+    }
+
+    pthread_mutex_init(&lsm->mutex, NULL);
+    pthread_cond_init(&lsm->cond, NULL);
+
+    for (lsm->nworkers = 0; lsm->nworkers < nworkers; ++lsm->nworkers)
+    {
+        if (0 != pthread_create(&lsm->workers[lsm->nworkers], NULL, LsmWorker, lsm))
+        {
+            perror("Creation of the thread is failure!");
+            break;
+        }
+    }
+
+    if (0 == lsm->nworkers)
+    {
+        DestroyLsm(lsm);
+        return NULL;
+    }
+
+    return lsm;
+}
+
+void DestroyLsm(lsm_t *lsm)
+{
+    pthread_mutex_lock(&lsm->mutex);
+    lsm->is_stopping = TRUE;
+    pthread_cond_broadcast(&lsm->cond);
+    pthread_mutex_unlock(&lsm->mutex);
+
+    for (int worker = 0; worker < lsm->nworkers; ++worker)
+    {
+        pthread_join(lsm->workers[worker], NULL);
+    }
+
+    for (int level = 0; level < LSM_LEVELS; ++level)
+    {
+        for (size_t run = 0; run < lsm->levels[level].nruns; ++run)
+        {
+            free(lsm->levels[level].runs[run].data);
+        }
+    }
+
+    pthread_mutex_destroy(&lsm->mutex);
+    pthread_cond_destroy(&lsm->cond);
+    free(lsm->workers);
+    free(lsm);
+}
+
+int LsmInsert(lsm_t *lsm, const int *batch, size_t size)
+{
+    int *data = (int *)malloc(sizeof(int) * size);
+    if (NULL == data)
+    {
+        perror("Allocation memory is failure!");
+        return 1;
+    }
+
+    /* The batch is sorted outside the lock, the natural merge sort does not degrade on any input */
+    memcpy(data, batch, sizeof(int) * size);
+    NaturalMergeSort(data, size);
+
+    pthread_mutex_lock(&lsm->mutex);
+    while (LSM_MAX_RUNS == lsm->levels[0].nruns)
+    {
+        pthread_cond_wait(&lsm->cond, &lsm->mutex);
+    }
+
+    lsm->levels[0].runs[lsm->levels[0].nruns].data = data;
+    lsm->levels[0].runs[lsm->levels[0].nruns].size = size;
+    ++lsm->levels[0].nruns;
+    lsm->size += size;
+
+    pthread_cond_broadcast(&lsm->cond);
+    pthread_mutex_unlock(&lsm->mutex);
+
+    return 0;
+}
+
+int LsmFindCompaction(lsm_t *lsm)
+{
+    /* The highest full level goes first, so a level always has room for the run merged below it */
+    for (int level = LSM_LEVELS - 2; level >= 0; --level)
+    {
+        if (!lsm->levels[level].is_compacting && lsm->levels[level].nruns >= LSM_FANOUT &&
+                lsm->levels[level + 1].nruns < LSM_MAX_RUNS)
+        {
+            return level;
+        }
+    }
+
+    return -1;
+}
+
+void *LsmWorker(void *lsm_arg)
+{
+    lsm_t *lsm = (lsm_t *)lsm_arg;
+    lsm_run_t runs[LSM_FANOUT];
+
+    pthread_mutex_lock(&lsm->mutex);
+    while (TRUE)
+    {
+        int level = LsmFindCompaction(lsm);
+        size_t total = 0;
+
+        if (-1 == level)
+        {
+            if (TRUE == lsm->is_stopping)
+            {
+                break;
+            }
+
+            pthread_cond_wait(&lsm->cond, &lsm->mutex);
+            continue;
+        }
+
+        /* The runs stay visible to the queries while they are merged outside the lock */
+        lsm_level_t *current = &lsm->levels[level];
+        current->is_compacting = TRUE;
+        memcpy(runs, current->runs, sizeof(runs));
+        for (int run = 0; run < LSM_FANOUT; ++run)
+        {
+            total += runs[run].size;
+        }
+        pthread_mutex_unlock(&lsm->mutex);
+
+        /* The natural merge sort finds the runs laid side by side and merges them */
+        int *data = (int *)malloc(sizeof(int) * total);
+        if (NULL != data)
+        {
+            size_t offset = 0;
+
+            for (int run = 0; run < LSM_FANOUT; ++run)
+            {
+                memcpy(data + offset, runs[run].data, sizeof(int) * runs[run].size);
+                offset += runs[run].size;
+            }
+            NaturalMergeSort(data, total);
+        }
+
+        pthread_mutex_lock(&lsm->mutex);
+        current->is_compacting = FALSE;
+        if (NULL == data)
+        {
+            perror("Allocation memory is failure!");
+            pthread_cond_broadcast(&lsm->cond);
+            continue;
+        }
+
+        /* The merged runs are always the oldest ones, new runs are only appended */
+        for (int run = 0; run < LSM_FANOUT; ++run)
+        {
+            free(current->runs[run].data);
+        }
+        memmove(current->runs, current->runs + LSM_FANOUT, sizeof(lsm_run_t) * (current->nruns - LSM_FANOUT));
+        current->nruns -= LSM_FANOUT;
+
+        lsm_level_t *next = &lsm->levels[level + 1];
+        next->runs[next->nruns].data = data;
+        next->runs[next->nruns].size = total;
+        ++next->nruns;
+
+        pthread_cond_broadcast(&lsm->cond);
+    }
+    pthread_mutex_unlock(&lsm->mutex);
+
+    return NULL;
+}
+
+void LsmWaitCompaction(lsm_t *lsm)
+{
+    pthread_mutex_lock(&lsm->mutex);
+    while (TRUE)
+    {
+        int is_busy = (-1 != LsmFindCompaction(lsm));
+
+        for (int level = 0; level < LSM_LEVELS; ++level)
+        {
+            is_busy |= lsm->levels[level].is_compacting;
+        }
+
+        if (!is_busy)
+        {
+            break;
+        }
+
+        pthread_cond_wait(&lsm->cond, &lsm->mutex);
+    }
+    pthread_mutex_unlock(&lsm->mutex);
+}
+
+size_t LsmCount(lsm_t *lsm, int low, int high)
+{
+    size_t count = 0;
+
+    /* An empty range would put the upper bound before the lower one */
+    if (high < low)
+    {
+        return 0;
+    }
+
+    pthread_mutex_lock(&lsm->mutex);
+    for (int level = 0; level < LSM_LEVELS; ++level)
+    {
+        for (size_t run = 0; run < lsm->levels[level].nruns; ++run)
+        {
+            lsm_run_t *current = &lsm->levels[level].runs[run];
+            size_t first = LowerBound(current->data, current->size, low);
+            size_t last = (INT_MAX == high) ? current->size : LowerBound(current->data, current->size, high + 1);
+
+            count += last - first;
+        }
+    }
+    pthread_mutex_unlock(&lsm->mutex);
+
+    return count;
+}
+
+size_t LsmRange(lsm_t *lsm, int low, int high, int *out)
+{
+    size_t count = 0;
+
+    if (high < low)
+    {
+        return 0;
+    }
+
+    /* The matching slice of every run is found by binary search, the slices are merged by the natural merge sort */
+    pthread_mutex_lock(&lsm->mutex);
+    for (int level = 0; level < LSM_LEVELS; ++level)
+    {
+        for (size_t run = 0; run < lsm->levels[level].nruns; ++run)
+        {
+            lsm_run_t *current = &lsm->levels[level].runs[run];
+            size_t first = LowerBound(current->data, current->size, low);
+            size_t last = (INT_MAX == high) ? current->size : LowerBound(current->data, current->size, high + 1);
+
+            if (first < last)
+            {
+                memcpy(out + count, current->data + first, sizeof(int) * (last - first));
+                count += last - first;
+            }
+        }
+    }
+    pthread_mutex_unlock(&lsm->mutex);
+
+    NaturalMergeSort(out, count);
+    return count;
+}
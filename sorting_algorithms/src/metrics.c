@@ -0,0 +1,339 @@
+#include <stdio.h>      /* perror, fprintf */
+#include <stdlib.h>     /* malloc, posix_memalign */
+#include <string.h>     /* memset */
+#include <stdarg.h>     /* va_list */
+#include <signal.h>     /* signal */
+#include <time.h>       /* clock_gettime */
+#include <unistd.h>     /* pipe, close */
+#include <poll.h>       /* poll */
+#include <pthread.h>    /* pthread_create */
+#include <sys/socket.h> /* accept */
+
+#include "sockets.h"    /* ListenSocket, SendAll */
+#include "metrics.h"
+
+/* The progress is reported this often, the metrics thread also wakes this often */
+#define METRICS_INTERVAL_MS 1000
+/* How long a scraper may take to send its request */
+#define METRICS_REQUEST_MS 100
+/* The text of the metrics takes at most this much plus this much per thread */
+#define METRICS_TEXT 4096
+#define METRICS_SLOT_TEXT 512
+
+#define TRUE 1
+#define FALSE 0
+
+typedef struct sort_metrics sort_metrics_t;
+
+/* The live metrics of the quicksort and the thread serving them */
+struct sort_metrics
+{
+    metrics_slot_t *slots;
+    size_t nslots;
+    size_t registered;      /* The number of slots taken by the threads */
+    size_t total;           /* The size of the array */
+    const size_t *queue_depth; /* The segments waiting in the queue of the sort */
+    int phase;
+    uint64_t start;
+    const char *path;
+    int listener;
+    int wake[2];            /* The pipe that stops the thread */
+    int is_running;
+    pthread_t thread;
+};
+
+/* The live metrics, NULL if they are not served */
+sort_metrics_t *metrics = NULL;
+/* The slot of the thread running the quicksort, NULL if it is not counted */
+__thread metrics_slot_t *metrics_slot = NULL;
+const char *metrics_phases[METRICS_PHASES] = {"load", "verify", "partition", "sort", "merge", "done"};
+
+size_t AppendText(char *buffer, size_t capacity, size_t length, const char *format, ...);
+size_t FormatMetrics(char *buffer, size_t capacity);
+void ServeMetrics(int client, char *buffer, size_t capacity);
+void *MetricsThread(void *sort_metrics);
+
+int StartMetrics(const char *path, size_t total, int nthreads, const size_t *queue_depth)
+{
+    metrics = (sort_metrics_t *)calloc(1, sizeof(sort_metrics_t));
+    if (NULL == metrics)
+    {
+        perror("Allocation memory is failure!");
+        return 1;
+    }
+
+    /* Every slot takes its own cache line, so the threads do not share the lines they update */
+    metrics->nslots = nthreads;
+    if (0 != posix_memalign((void **)&metrics->slots, METRICS_LINE, sizeof(metrics_slot_t) * nthreads))
+    {
+        perror("Allocation memory is failure!");
+        free(metrics);
+        metrics = NULL;
+        return 1;
+    }
+    memset(metrics->slots, 0, sizeof(metrics_slot_t) * nthreads);
+
+    metrics->wake[0] = -1;
+    metrics->wake[1] = -1;
+    metrics->path = path;
+    metrics->total = total;
+    metrics->queue_depth = queue_depth;
+    metrics->phase = METRICS_LOAD;
+    metrics->start = MetricsNow();
+    metrics->listener = ListenSocket(path);
+    if (-1 == metrics->listener)
+    {
+        StopMetrics();
+        return 1;
+    }
+
+    if (0 != pipe(metrics->wake))
+    {
+        perror("Creation of the pipe is failure!");
+        StopMetrics();
+        return 1;
+    }
+
+    /* A scraper that hangs up early must not kill the sort */
+    signal(SIGPIPE, SIG_IGN);
+    if (0 != pthread_create(&metrics->thread, NULL, MetricsThread, metrics))
+    {
+        perror("Creation of the thread is failure!");
+        StopMetrics();
+        return 1;
+    }
+    metrics->is_running = TRUE;
+
+    fprintf(stderr, "Metrics on %s\n", path);
+    return 0;
+}
+
+void StopMetrics(void)
+{
+    if (NULL == metrics)
+    {
+        return;
+    }
+
+    /* The byte on the pipe wakes the thread out of its poll */
+    if (TRUE == metrics->is_running)
+    {
+        char byte = 0;
+
+        SendAll(metrics->wake[1], &byte, sizeof(byte));
+        pthread_join(metrics->thread, NULL);
+    }
+
+    if (-1 != metrics->listener)
+    {
+        close(metrics->listener);
+        unlink(metrics->path);
+    }
+    if (-1 != metrics->wake[0])
+    {
+        close(metrics->wake[0]);
+        close(metrics->wake[1]);
+    }
+
+    free(metrics->slots);
+    free(metrics);
+    metrics = NULL;
+}
+
+void SetMetricsPhase(int phase)
+{
+    if (NULL != metrics)
+    {
+        __atomic_store_n(&metrics->phase, phase, __ATOMIC_RELAXED);
+    }
+}
+
+metrics_slot_t *RegisterMetrics(void)
+{
+    if (NULL == metrics)
+    {
+        return NULL;
+    }
+
+    size_t slot = __atomic_fetch_add(&metrics->registered, 1, __ATOMIC_RELAXED);
+    metrics_slot = (slot < metrics->nslots) ? &metrics->slots[slot] : NULL;
+    return metrics_slot;
+}
+
+void MetricsWait(metrics_slot_t *slot, uint64_t waiting, uint64_t locked, uint64_t taken)
+{
+    if (NULL != slot)
+    {
+        __atomic_store_n(&slot->wait_ns, slot->wait_ns + (locked - waiting), __ATOMIC_RELAXED);
+        __atomic_store_n(&slot->idle_ns, slot->idle_ns + (taken - locked), __ATOMIC_RELAXED);
+    }
+}
+
+void MetricsSegment(metrics_slot_t *slot, uint64_t sorting)
+{
+    if (NULL != slot)
+    {
+        __atomic_store_n(&slot->busy_ns, slot->busy_ns + (MetricsNow() - sorting), __ATOMIC_RELAXED);
+        __atomic_store_n(&slot->segments, slot->segments + 1, __ATOMIC_RELAXED);
+    }
+}
+
+uint64_t MetricsNow(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+size_t AppendText(char *buffer, size_t capacity, size_t length, const char *format, ...)
+{
+    va_list args;
+
+    if (length >= capacity)
+    {
+        return length;
+    }
+
+    va_start(args, format);
+    int written = vsnprintf(buffer + length, capacity - length, format, args);
+    va_end(args);
+
+    return (0 > written) ? length : length + written;
+}
+
+size_t FormatMetrics(char *buffer, size_t capacity)
+{
+    /* Only the threads that started have their slots filled */
+    size_t nslots = __atomic_load_n(&metrics->registered, __ATOMIC_RELAXED);
+    int phase = __atomic_load_n(&metrics->phase, __ATOMIC_RELAXED);
+    size_t length = 0;
+    uint64_t completed = 0;
+
+    nslots = (nslots < metrics->nslots) ? nslots : metrics->nslots;
+
+    length = AppendText(buffer, capacity, length, "# HELP sort_elements The number of elements to sort\n# TYPE sort_elements gauge\n");
+    length = AppendText(buffer, capacity, length, "sort_elements %lu\n", metrics->total);
+
+    length = AppendText(buffer, capacity, length, "# HELP sort_completed_elements Elements placed at their final position by the thread\n"
+            "# TYPE sort_completed_elements counter\n");
+    for (size_t slot = 0; slot < nslots; ++slot)
+    {
+        uint64_t count = __atomic_load_n(&metrics->slots[slot].completed, __ATOMIC_RELAXED);
+
+        completed += count;
+        length = AppendText(buffer, capacity, length, "sort_completed_elements{thread=\"%lu\"} %lu\n", slot, count);
+    }
+
+    length = AppendText(buffer, capacity, length, "# HELP sort_segments Segments taken from the queue by the thread\n"
+            "# TYPE sort_segments counter\n");
+    for (size_t slot = 0; slot < nslots; ++slot)
+    {
+        length = AppendText(buffer, capacity, length, "sort_segments{thread=\"%lu\"} %lu\n", slot, 
+                __atomic_load_n(&metrics->slots[slot].segments, __ATOMIC_RELAXED));
+    }
+
+    length = AppendText(buffer, capacity, length, "# HELP sort_thread_seconds Time of the thread by its state\n"
+            "# TYPE sort_thread_seconds counter\n");
+    for (size_t slot = 0; slot < nslots; ++slot)
+    {
+        const metrics_slot_t *times = &metrics->slots[slot];
+
+        length = AppendText(buffer, capacity, length, "sort_thread_seconds{thread=\"%lu\",state=\"busy\"} %.6f\n", slot,
+                __atomic_load_n(&times->busy_ns, __ATOMIC_RELAXED) / 1e9);
+        length = AppendText(buffer, capacity, length, "sort_thread_seconds{thread=\"%lu\",state=\"idle\"} %.6f\n", slot,
+                __atomic_load_n(&times->idle_ns, __ATOMIC_RELAXED) / 1e9);
+        length = AppendText(buffer, capacity, length, "sort_thread_seconds{thread=\"%lu\",state=\"wait\"} %.6f\n", slot,
+                __atomic_load_n(&times->wait_ns, __ATOMIC_RELAXED) / 1e9);
+    }
+
+    length = AppendText(buffer, capacity, length, "# HELP sort_progress_ratio Share of the elements at their final position\n"
+            "# TYPE sort_progress_ratio gauge\nsort_progress_ratio %.6f\n", (double)completed / metrics->total);
+    length = AppendText(buffer, capacity, length, "# HELP sort_queue_depth Segments waiting in the queue\n"
+            "# TYPE sort_queue_depth gauge\nsort_queue_depth %lu\n", __atomic_load_n(metrics->queue_depth, __ATOMIC_RELAXED));
+    length = AppendText(buffer, capacity, length, "# HELP sort_elapsed_seconds Time since the array started loading\n"
+            "# TYPE sort_elapsed_seconds gauge\nsort_elapsed_seconds %.6f\n", (MetricsNow() - metrics->start) / 1e9);
+
+    length = AppendText(buffer, capacity, length, "# HELP sort_phase The current phase of the sort\n# TYPE sort_phase gauge\n");
+    for (int state = 0; state < METRICS_PHASES; ++state)
+    {
+        length = AppendText(buffer, capacity, length, "sort_phase{phase=\"%s\"} %d\n", metrics_phases[state], state == phase);
+    }
+
+    return (length < capacity) ? length : capacity - 1;
+}
+
+void ServeMetrics(int client, char *buffer, size_t capacity)
+{
+    static const char header[] = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nConnection: close\r\n\r\n";
+    struct pollfd request = {client, POLLIN, 0};
+
+    /* The request is read and ignored, a client that sends nothing gets the text as well */
+    if (0 < poll(&request, 1, METRICS_REQUEST_MS))
+    {
+        read(client, buffer, capacity);
+    }
+
+    size_t length = FormatMetrics(buffer, capacity);
+    if (0 == SendAll(client, header, sizeof(header) - 1))
+    {
+        SendAll(client, buffer, length);
+    }
+    close(client);
+}
+
+void *MetricsThread(void *sort_metrics)
+{
+    sort_metrics_t *state = (sort_metrics_t *)sort_metrics;
+    size_t capacity = METRICS_TEXT + state->nslots * METRICS_SLOT_TEXT;
+    char *buffer = (char *)malloc(capacity);
+    struct pollfd fds[2] = {{state->listener, POLLIN, 0}, {state->wake[0], POLLIN, 0}};
+    uint64_t reported = MetricsNow();
+
+    if (NULL == buffer)
+    {
+        perror("Allocation memory is failure!");
+        return NULL;
+    }
+
+    while (TRUE)
+    {
+        int ready = poll(fds, 2, METRICS_INTERVAL_MS);
+
+        if (0 < ready && 0 != fds[1].revents)
+        {
+            break;
+        }
+
+        if (0 < ready && 0 != (fds[0].revents & POLLIN))
+        {
+            int client = accept(state->listener, NULL, NULL);
+
+            if (-1 != client)
+            {
+                ServeMetrics(client, buffer, capacity);
+            }
+        }
+
+        /* The progress goes to stderr as well, so a long run is not silent */
+        if (MetricsNow() - reported >= METRICS_INTERVAL_MS * 1000000ULL)
+        {
+            size_t nslots = __atomic_load_n(&state->registered, __ATOMIC_RELAXED);
+            uint64_t completed = 0;
+
+            nslots = (nslots < state->nslots) ? nslots : state->nslots;
+            for (size_t slot = 0; slot < nslots; ++slot)
+            {
+                completed += __atomic_load_n(&state->slots[slot].completed, __ATOMIC_RELAXED);
+            }
+
+            reported = MetricsNow();
+            fprintf(stderr, "Progress: %-9s %6.2f%% (%lu / %lu), queue %lu, %.1f s\n", 
+                    metrics_phases[__atomic_load_n(&state->phase, __ATOMIC_RELAXED)], 100.0 * completed / state->total, 
+                    completed, state->total, __atomic_load_n(state->queue_depth, __ATOMIC_RELAXED), (reported - state->start) / 1e9);
+        }
+    }
+
+    free(buffer);
+    return NULL;
+}
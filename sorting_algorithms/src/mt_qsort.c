@@ -1,14 +1,49 @@
 /*
- * project2 -n SIZE [-a ALTERNATE] [-s THRESHOLD] [-r SEED] [-m MULTITHREAD] [-p PIECES] [-t MAXTHREADS] [-m3 MEDIAN] [-e EARLY]
+ * project2 -n SIZE [-a ALTERNATE] [-s THRESHOLD] [-r SEED] [-m MULTITHREAD] [-p PIECES] [-t MAXTHREADS] [-m3 MEDIAN] [-e EARLY] [-g DISTRIBUTION] [-w WRITE] [-k TOPK] [-q QUANTILES] [-qa QUANTILES] [-R RECORD] [-pe ENGINE] [-b BATCH] [-i STREAM] [-c CAP] [-z COMPRESS] [-zi COMPRESSED] [-P PROCESSES] [-S SOCKET] [-C SOCKET] [-B BUCKETS] [-o OUTPUT] [-L LOOKUP] [-T TUNE] [-M METRICS] [-l LAZY] [-K COLUMNS] [-F STRINGS]
  * SIZE: [1 <= SIZE <= 1000000000]
- * ALTERNATE: [S/s/I/i]
+ * ALTERNATE: [S/s/I/i/M/m/A/a/N/n/C/c] (M is the stable merge sort of the library on (key, arrival index) pairs,
+ *            A samples the array and lets the Sort library function choose the algorithm,
+ *            N is the natural merge sort of the library for presorted arrays,
+ *            C is the parallel counting sort of the library for small key ranges)
  * THRESHOLD: [3 ≤ THRESHOLD < SIZE]
- * SEED: 
+ * SEED: (the start point in the file, or the generator seed if DISTRIBUTION is given)
  * MULTITHREADED: [Y/y/N/n]
  * PIECES: [integer]
  * MAXTHREADS: [integer], (applies only if MULTITHREAD is 'Y'), (default: 4)
  * MEDIAN: [Y/y/N/n]
  * EARLY: [Y/y/N/n]
+ * DISTRIBUTION: [U/S/R/N/F/E/O] (uniform/sorted/reversed/nearly sorted/few unique/equal/organ pipe),
+ *               generates the array in place instead of reading the file
+ * WRITE: [Y/y/N/n] (applies only if DISTRIBUTION is given), stores the generated array into the file
+ * TOPK: [1 <= TOPK <= SIZE], selects and sorts only the TOPK smallest elements instead of the whole array
+ * QUANTILES: [comma separated percents, e.g. 50,90,99,99.9], selects only the quantiles instead of sorting,
+ *            -q is exact, -qa is approximate with a bounded rank error and does not reorder the array
+ * RECORD: [8 <= RECORD, multiple of 4], sorts records of RECORD bytes keyed by the array by argsort and gather
+ * ENGINE: [R/r/Q/q] (radix/quicksort), the engine sorting the (key, index) pairs of RECORD and COLUMNS, (default: R)
+ * BATCH: [1 <= BATCH <= SIZE], ingests the array into the incremental sorted container in batches of BATCH
+ * STREAM: [Y/y/N/n], sorts binary ints from stdin to stdout, SIZE is then the size of one run buffer
+ * CAP: [integer], (applies only if STREAM is 'Y'), MiB of runs held in memory before spilling, (default: 1024)
+ * COMPRESS: [Y/y/N/n], (applies only if STREAM is 'Y'), writes the output in the compressed run format
+ * COMPRESSED: [Y/y/N/n], (applies only if STREAM is 'Y'), reads the input in the compressed run format
+ * PROCESSES: [2 <= PROCESSES <= 64], sorts the array by a sample sort of PROCESSES worker processes,
+ *            every worker loads a slice, the buckets are exchanged through shared memory
+ * SOCKET: [path], -S serves sort requests on the Unix socket until SIGINT or SIGTERM, 
+ *         -C loads the array into a memfd buffer and has the daemon on the socket sort a copy of it and write it back,
+ *         CAP is the memory the daemon sorts at once, more is rejected as busy, a buffer larger than CAP as too large,
+ *         the buffer must be sealed against shrinking and the request sent within a second
+ * BUCKETS: [2 <= BUCKETS <= 4096], splits the array into BUCKETS key ranges of sampled splitters instead of sorting it
+ * OUTPUT: [path], (applies to the quicksort and the library sorts), stores the sorted array with a block index
+ * LOOKUP: [path], looks every value of the array up in the file stored by OUTPUT instead of sorting it
+ * TUNE: [Y/y/N/n], times THRESHOLD, MEDIAN, MAXTHREADS, PIECES and the library on a generated array of SIZE
+ *       and stores the fastest into the profile, which every run loads before parsing the arguments,
+ *       the library is only reported when it is faster, the algorithm stays the one chosen by ALTERNATE
+ * METRICS: [path], (applies to the quicksort), serves the live metrics of the sort in the Prometheus text format
+ *          on the Unix socket and reports the progress to stderr every second
+ * LAZY: [1 <= LAZY <= SIZE], hands the sorted array out smallest first in blocks of at least LAZY elements,
+ *       the first one after about a pass over the array, MAXTHREADS threads sort the rest in the background
+ * COLUMNS: [1 <= COLUMNS <= 16], sorts a table of COLUMNS int columns lexicographically instead of the array,
+ *          the last column is the array, the others take few values
+ * STRINGS: [path], sorts the lines of the file in byte order to stdout instead of the array, SIZE caps the number of lines
  * */
 
 #define _GNU_SOURCE
@@ -20,6 +55,28 @@
 #include <pthread.h>    /* pthread */
 #include <limits.h>     /* INT_MIN */
 #include <errno.h>      /* ETIMEDOUT */
+#include <stdint.h>     /* uint32_t, uint64_t */
+#include <fcntl.h>      /* open */
+#include <unistd.h>     /* pwrite, ftruncate */
+#include <stdarg.h>     /* va_list */
+#include <sys/mman.h>   /* mmap */
+#include <sys/resource.h> /* getrusage */
+#include <sys/stat.h>   /* fstat */
+#include <sys/uio.h>    /* writev */
+#ifdef __SSE2__
+#include <emmintrin.h>  /* _mm_add_epi32 */
+#endif
+
+#include "sorts.h"      /* Sort */
+#include "block_index.h" /* WriteIndexed */
+#include "lsm.h"        /* CreateLsm */
+#include "daemon.h"     /* ServeSorts */
+#include "distributed.h" /* StartDistributed */
+#include "metrics.h"    /* StartMetrics */
+#include "partition.h"  /* Partition */
+#include "select.h"     /* TopK, Quantiles */
+#include "argsort.h"    /* Argsort, ArgsortColumns */
+#include "lazy.h"       /* CreateLazySort */
 
 /*****************************************************
  *                      DEFINES                      *
@@ -32,8 +89,6 @@
 /* Minimum value of the threshold option */
 #define MIN_THRESHOLD 3
 
-#define NUM_LOCATIONS 11
-
 /* Early size in percantage */
 #define EARLY_SIZE 0.25f
 
@@ -42,8 +97,89 @@
 
 #define RATIO_SPLIT 0.7F
 
+/* Generated values lie in [0, GEN_RANGE) as the values of the data file */
+#define GEN_RANGE 1000000000
+/* The number of distinct values of the few unique distribution */
+#define GEN_FEW_UNIQUE 16
+/* One of GEN_NEARLY_SORTED values of the nearly sorted distribution is out of place */
+#define GEN_NEARLY_SORTED 100
+/* The generating threads write to the file with chunks of this size */
+#define GEN_WRITE_CHUNK (1 << 24)
+
+/* The minimum size of a record, the key and the index of the record in the input */
+#define MIN_RECORD 8
+
+/* The generated leading columns of a table take this many values */
+#define COLUMNS_RANGE 64
+
+/* The number of range queries checked after the ingestion */
+#define LSM_QUERIES 16
+
+/* The default memory cap of the stream mode in MiB */
+#define STREAM_CAP 1024
+/* Spilled runs are read and the output is written in chunks of at most this many values */
+#define STREAM_CHUNK (1 << 16)
+/* The minimum chunk of a spilled run, the chunks shrink with many runs to keep the merge within the cap */
+#define STREAM_MIN_CHUNK 1024
+
+/* The number of values of one block of the compressed run format */
+#define RUN_BLOCK 128
+/* Block header: the count, the width of the deltas and the minimum and the maximum of the block */
+#define RUN_HEADER 16
+/* The largest possible block */
+#define RUN_BLOCK_MAX (RUN_HEADER + RUN_BLOCK * sizeof(int))
+/* Unpacking reads 8 bytes at once, so buffers of compressed blocks have this many bytes more */
+#define RUN_PADDING 8
+
+/* The number of objects carved from the system allocator at once by a pool */
+#define POOL_SLAB 256
+/* The number of objects moved between the cache of a thread and the shared depot at once */
+#define POOL_BATCH 64
+#define POOL_ALIGN 16
+/* The number of scratch buffers a thread keeps for reuse */
+#define SCRATCH_SLOTS 4
+
+/* The largest number of key ranges of the partition mode, the limit of the library */
+#define MAX_BUCKETS 4096
+
+/* The lookups checked against a search of the whole data */
+#define LOOKUP_CHECK 1024
+
+/* Seed mixed into the multiset hash of the verification checksum */
+#define VERIFY_HASH_SEED 0x9E3779B9U
+
+/* The profile of the quicksort, compiled only with -DQSORT_PROFILE: the split histogram has 
+ * a row per recursion level, the deeper levels share the last one, the leaves are counted by powers of two */
+#define PROFILE_LEVELS 64
+#define PROFILE_SKEW_BUCKETS 10
+#define PROFILE_LEAF_BUCKETS 8
+
+#ifdef QSORT_PROFILE
+#define PROFILE_START(clock) uint64_t clock = ProfileNow()
+#define PROFILE_ADD(counter, clock) __atomic_add_fetch(&qsort_profile.counter, ProfileNow() - (clock), __ATOMIC_RELAXED)
+#define PROFILE_SPLIT(low, high, pivot) ProfileSplit(qsort_depth, (low), (high), (pivot))
+#define PROFILE_LEAF(size) ProfileLeaf(size)
+#define PROFILE_DESCEND() ++qsort_depth
+#define PROFILE_ASCEND() --qsort_depth
+#else
+#define PROFILE_START(clock)
+#define PROFILE_ADD(counter, clock)
+#define PROFILE_SPLIT(low, high, pivot)
+#define PROFILE_LEAF(size)
+#define PROFILE_DESCEND()
+#define PROFILE_ASCEND()
+#endif
+
 /* Path to the file */
 #define DATA_FILE "random.dat"
+/* Path to the tuned parameters of this host */
+#define TUNE_FILE "tune.profile"
+/* Every candidate is timed this many times, the fastest run counts */
+#define TUNE_REPEATS 3
+/* The largest number of threads tried by the tuning */
+#define TUNE_MAX_THREADS 64
+/* The longest key or value of a line of the profile */
+#define PROFILE_FIELD 32
 
 #define TRUE 1
 #define FALSE 0
@@ -56,6 +192,18 @@ typedef struct thread_info thread_info_t;
 typedef struct segment segment_t;
 typedef struct pq pq_t;
 typedef struct pq_node pq_node_t;
+typedef struct pool_object pool_object_t;
+typedef struct pool_cache pool_cache_t;
+typedef struct pool pool_t;
+typedef struct scratch_header scratch_header_t;
+typedef struct scratch_cache scratch_cache_t;
+typedef struct qsort_profile qsort_profile_t;
+typedef struct verify verify_t;
+typedef struct verify_task verify_task_t;
+typedef struct generate_task generate_task_t;
+typedef struct stream_run stream_run_t;
+typedef struct run_cursor run_cursor_t;
+typedef struct stream stream_t;
 
 struct cmd_options
 {
@@ -68,6 +216,41 @@ struct cmd_options
     int maxthreads;     /* The number of threads */
     int median;         /* To determine whether each segment will be partitioned */
     int early;
+    char distribution;  /* The distribution to generate, '\0' to read the file */
+    int write;          /* Whether to store the generated array into the file */
+    size_t topk;        /* The number of the smallest elements to select, 0 to sort the whole array */
+    double quantiles[QUANTILES_MAX]; /* The requested quantiles in percents */
+    size_t nquantiles;  /* The number of the requested quantiles, 0 to sort the whole array */
+    int approximate;    /* Whether the quantiles are estimated by the streaming sketch */
+    size_t record;      /* The size of the records in bytes, 0 to sort the array itself */
+    size_t columns;     /* The number of the columns of the table, 0 to sort the array itself */
+    char engine;        /* The engine sorting the (key, index) pairs of the records */
+    size_t batch;       /* The size of the batches of the incremental container, 0 to sort the array */
+    size_t lazy;        /* The size of the blocks the sorted array is handed out in, 0 to sort it at once */
+    int stream;         /* Whether to sort stdin to stdout */
+    size_t cap;         /* The memory cap of the stream mode in MiB */
+    int compress;       /* Whether the output of the stream mode is compressed */
+    int compressed;     /* Whether the input of the stream mode is compressed */
+    int processes;      /* The number of worker processes, 0 to sort in this process */
+    size_t buckets;     /* The number of key ranges to partition into, 0 to sort */
+    int tune;           /* Whether to time the parameters and store the fastest into the profile */
+    const char *output; /* The file the sorted array is stored into with its block index, NULL not to store it */
+    const char *lookup; /* The indexed file to look the array up in, NULL to sort */
+    const char *serve;  /* The socket the daemon listens on, NULL if this is not the daemon */
+    const char *client; /* The socket of the daemon to send the array to, NULL to sort it here */
+    const char *metrics; /* The socket serving the live metrics, NULL not to serve them */
+    const char *strings; /* The file whose lines are sorted, NULL to sort the array */
+};
+
+/* What the instrumented quicksort saw over all threads */
+struct qsort_profile
+{
+    uint64_t skew[PROFILE_LEVELS][PROFILE_SKEW_BUCKETS]; /* The splits by the share of the left part */
+    uint64_t leaves[PROFILE_LEAF_BUCKETS];
+    uint64_t partitions;
+    uint64_t max_depth;
+    uint64_t partition_ns;  /* The time of the pivot choice and the partition */
+    uint64_t shell_ns;      /* The time of the shell sort of the leaves */
 };
 
 struct segment
@@ -92,13 +275,133 @@ struct pq_node
     pq_node_t *next;
 };
 
+/* A free object of a pool, the link is stored in the object itself */
+struct pool_object
+{
+    pool_object_t *next;
+};
+
+/* The free objects of one thread, used without synchronization */
+struct pool_cache
+{
+    pool_object_t *head;
+    size_t count;
+    pool_t *pool;
+};
+
+/* Fixed size objects carved from slabs and recycled through the caches of the threads */
+struct pool
+{
+    size_t object;          /* The size of the objects */
+    pool_object_t *depot;   /* The free objects returned by the threads */
+    size_t ndepot;
+    void *slabs;            /* The slabs, linked by their first pointer */
+    pthread_mutex_t mutex;  /* Guards the depot and the slabs, taken once per batch of objects */
+    pthread_key_t key;      /* The cache of the calling thread */
+};
+
+/* The capacity of a scratch buffer is kept in front of it */
+struct scratch_header
+{
+    size_t capacity;
+    size_t padding;
+};
+
+/* The released scratch buffers of one thread */
+struct scratch_cache
+{
+    scratch_header_t *buffers[SCRATCH_SLOTS];
+};
+
 struct pq
 {
+    pool_t nodes;           /* The nodes are recycled instead of being allocated under the lock */
     pq_node_t *head;
+    size_t count;           /* Changed under the lock, read without it by the metrics */
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+};
+
+/* Order flag and order-independent multiset checksum of a range of values */
+struct verify
+{
+    size_t count;       /* The number of covered elements */
+    uint64_t sum;       /* Wrapping sum of the values */
+    uint64_t hash_sum;  /* Wrapping sum of the hashed values */
+    uint32_t hash_xor;  /* Xor of the hashed values */
+    int sorted;         /* Whether the range is in non-descending order */
+    int first;          /* The first value of the range */
+    int last;           /* The last value of the range */
+};
+
+struct generate_task
+{
+    int *array;
+    size_t left;        /* The first index of the region of the thread */
+    size_t right;       /* The index after the last one of the region */
+    size_t size;        /* The size of the whole array */
+    uint64_t seed;
+    char distribution;
+    int fd;             /* The file to write the region to, -1 to keep it in memory */
+    int status;         /* 0 on success, -1 if writing has failed */
+};
+
+/* A run of the stream mode, it is kept in memory or spilled into the temporary file */
+struct stream_run
+{
+    int *data;          /* The values, NULL once the run is spilled */
+    size_t size;
+    int is_spilled;
+    off_t offset;       /* The position of the spilled run in the temporary file */
+    size_t bytes;       /* The size of the spilled run in the compressed run format */
+    int is_sorted;
+    stream_run_t *next;
+};
+
+/* The position of the k-way merge of the stream mode in one run */
+struct run_cursor
+{
+    stream_run_t *run;
+    int fd;             /* The temporary file of the spilled runs */
+    int *chunk;         /* The values of the current block, points into the run if it is in memory */
+    size_t chunk_size;
+    size_t position;    /* The position in the current block */
+    uint8_t *raw;       /* The compressed bytes read from the file */
+    size_t raw_capacity;
+    size_t raw_size;
+    size_t raw_position;
+    off_t offset;       /* The position of the next bytes in the file */
+    size_t remaining;   /* The number of bytes not read from the file yet */
+    int value;          /* The current value */
+};
+
+struct stream
+{
+    stream_run_t *head; /* All runs in the order of arrival */
+    stream_run_t *tail;
+    stream_run_t *todo; /* The first run which is not taken by a worker yet */
+    stream_run_t *unspilled; /* The first run which is not spilled yet */
+    size_t nruns;
+    size_t nspilled;
+    size_t memory;      /* Bytes of the buffers and runs in memory */
+    size_t cap;
+    FILE *spill;        /* One temporary file takes all spilled runs one after another */
+    off_t spill_size;
+    int is_closed;      /* Whether the input has ended */
+    size_t sorting;     /* The number of runs being sorted */
+    int nworkers;
+    pthread_t *workers;
     pthread_mutex_t mutex;
     pthread_cond_t cond;
 };
 
+struct verify_task
+{
+    const int *array;
+    size_t size;
+    verify_t result;
+};
+
 /*****************************************************
  *                  Global variables                 *
  ****************************************************/
@@ -117,6 +420,16 @@ thread_info_t threads_info = {0};
 
 pq_t *queue = NULL;
 
+/* The scratch buffers of the threads, created on the first use */
+pthread_once_t scratch_once = PTHREAD_ONCE_INIT;
+pthread_key_t scratch_key;
+
+#ifdef QSORT_PROFILE
+qsort_profile_t qsort_profile;
+/* The recursion level of the quicksort running in this thread */
+__thread int qsort_depth;
+#endif
+
 struct timeval load_start_time, load_end_time;
 struct timeval sorting_start_time, sorting_end_time;
 clock_t start, end;
@@ -128,15 +441,59 @@ clock_t start, end;
 
 /********************* Sorting ********************/
 void Quicksort(int *array, int low, int high, int threshold, int median);
-void Partition(int *array, int low, int high, size_t *i, size_t *j);
-void ShellSort(int *array, int low, int high);
-void MergeSortedSegments(int *array, segment_t *segments, int num_segments);
+void MergeSortedSegments(int *array, segment_t *segments, int num_segments, verify_t *verify);
+size_t MergeSegmentsInto(int *output, segment_t *segments, int num_segments, verify_t *verify);
+
+/***************** Stable sorting *****************/
+int StableMode(int *array, const cmd_options_t *options, const verify_t *input_verify);
+int LibraryMode(int *array, const cmd_options_t *options, const verify_t *input_verify);
+int PartitionMode(int *array, const cmd_options_t *options, const verify_t *input_verify);
+
+/****************** Key-payload *******************/
+int RecordMode(int *array, const cmd_options_t *options);
+int ColumnMode(int *array, const cmd_options_t *options);
+
+/************** Incremental container *************/
+int LsmMode(int *array, const cmd_options_t *options, const verify_t *input_verify);
+
+/******************** Lazy sort *******************/
+void SortPiece(int *piece, size_t size, const void *sort_options);
+int LazyMode(int *array, const cmd_options_t *options, const verify_t *input_verify);
+
+/********************* Strings ********************/
+int StringMode(const cmd_options_t *options);
+int WriteStrings(const sort_string_t *strings, size_t count, const char *limit);
+
+/******************** Streaming *******************/
+int StreamMode(const cmd_options_t *options);
+void *StreamWorker(void *stream);
+size_t ReadInts(FILE *file, int *buffer, size_t size, int *is_partial);
+int SpillRun(stream_t *stream, stream_run_t *run);
+int OpenCursor(run_cursor_t *cursor, stream_run_t *run, int fd, size_t capacity);
+int CursorNext(run_cursor_t *cursor);
+void SiftDown(run_cursor_t **heap, size_t size, size_t idx);
+int MergeRunsToFile(stream_t *stream, FILE *out, int is_compressed, verify_t *verify);
+size_t ReadBlocks(FILE *file, int *buffer, size_t size, int *is_partial);
+
+/******************* Run format *******************/
+size_t EncodeBlock(const int *values, size_t count, uint8_t *out);
+size_t DecodeBlock(const uint8_t *in, size_t available, int *values, size_t *count);
+size_t EncodeRun(const int *values, size_t count, uint8_t *out);
+void PrefixSum(uint32_t *deltas, size_t count, uint32_t base);
+void Report(const char *format, ...);
+
+/******************** Selection *******************/
+int SelectionMode(int *array, const cmd_options_t *options);
+int QuantileMode(int *array, const cmd_options_t *options);
+int ParseQuantiles(const char *list, cmd_options_t *options);
 
 /********************* Parsing ********************/
 void LoadArray(int *arr, size_t size, int seed);
 int SecondOfTenPartition(int *arr, size_t size);
+void GenerateArray(int *arr, size_t size, int seed, char distribution, int maxthreads, int write);
+void *GenerateThread(void *generate_task);
+int GenerateValue(uint64_t seed, size_t index, size_t size, char distribution);
 void DivideArray(int *array, const cmd_options_t *options, segment_t *segments);
-int MedianOfThree(int *array, int low, int mid, int high);
 size_t FindMaxIndex(int *arr, size_t len);
 int *SplitArray(size_t len, size_t pieces, float ratio);
 
@@ -147,9 +504,18 @@ void *QuicksortThread(void *thread_info);
 /************** Additional functions **************/
 
 /********************* Sorting ********************/
-void Swap(int *a, int *b);
 int IsSorted(int *array, size_t size);
 
+/******************** Verification ****************/
+uint32_t HashValue(int value);
+void VerifyInit(verify_t *verify);
+void VerifyAppend(verify_t *verify, int value);
+void VerifyBlock(const int *array, size_t size, verify_t *verify);
+void VerifyCombine(verify_t *verify, const verify_t *next);
+void VerifyArray(const int *array, size_t size, int maxthreads, verify_t *verify);
+void *VerifyThread(void *verify_task);
+int VerifyEqual(const verify_t *input, const verify_t *output);
+
 /**************** Priority queue ******************/
 int compare(const void *a, const void *b);
 pq_t *CreateQueue();
@@ -160,9 +526,54 @@ segment_t Peek(pq_t *queue);
 size_t Size(pq_t *queue);
 int IsEmpty(pq_t *queue);
 
+/********************* Pools **********************/
+void CreatePool(pool_t *pool, size_t object);
+void DestroyPool(pool_t *pool);
+pool_cache_t *PoolCache(pool_t *pool);
+void *PoolAlloc(pool_t *pool);
+void PoolFree(pool_t *pool, void *pointer);
+int PoolRefill(pool_t *pool, pool_cache_t *cache);
+void PoolFlush(pool_t *pool, pool_cache_t *cache, size_t count);
+void PoolCacheDestroy(void *pool_cache);
+void ScratchInit(void);
+void *ScratchAcquire(size_t bytes);
+void ScratchRelease(void *buffer);
+void ScratchCacheDestroy(void *scratch_cache);
+void ScratchExit(void);
+
+/******************* Distributed ******************/
+int LoadSlice(int *slice, size_t first, size_t size, void *summary, const void *sort_options);
+void CombineVerify(void *total, const void *summary);
+void SortBucket(int *array, size_t size, const void *sort_options);
+int DistributedMode(cmd_options_t *options);
+
+/********************** Daemon ********************/
+int DaemonMode(const cmd_options_t *options);
+int ClientMode(const cmd_options_t *options);
+
+/******************* Block index ******************/
+int LookupMode(const int *array, const cmd_options_t *options);
+
+/********************** Tuning ********************/
+double TimeTrial(const int *source, int *array, const cmd_options_t *options);
+int TuneMode(const cmd_options_t *options);
+int SaveProfile(const char *path, const cmd_options_t *options);
+int LoadProfile(const char *path, cmd_options_t *options);
+
+/********************* Profile ********************/
+uint64_t ProfileNow(void);
+#ifdef QSORT_PROFILE
+void ProfileSplit(int depth, int low, int high, size_t pivot);
+void ProfileLeaf(size_t size);
+void PrintQuicksortProfile(void);
+#endif
+
 /********************* Parsing ********************/
 int ParseArgv(const char **argv, size_t size, cmd_options_t *options);
 
+/********************* Output *********************/
+void PrintTimes(const char *phase, const struct timeval *start_time);
+
 /*****************************************************
  *              Function implementation              *
  ****************************************************/
@@ -203,31 +614,137 @@ void LoadArray(int *arr, size_t size, int seed)
     fclose(fp);
 }
 
-void ShellSort(int *array, int low, int high)
+int GenerateValue(uint64_t seed, size_t index, size_t size, char distribution)
+{
+    uint64_t random = SplitMix64(seed + index + 1);
+    /* The value at index of an evenly growing sequence over the whole range */
+    int ramp = (int)(((uint64_t)index * GEN_RANGE) / size);
+
+    switch (distribution)
+    {
+        case 'S':
+        case 's':
+            return ramp;
+        case 'R':
+        case 'r':
+            return (int)(((uint64_t)(size - 1 - index) * GEN_RANGE) / size);
+        case 'N':
+        case 'n':
+            return (0 == random % GEN_NEARLY_SORTED) ? (int)((random >> 32) % GEN_RANGE) : ramp;
+        case 'F':
+        case 'f':
+            return (int)(random % GEN_FEW_UNIQUE);
+        case 'E':
+        case 'e':
+            return (int)(SplitMix64(seed) % GEN_RANGE);
+        case 'O':
+        case 'o':
+            return (index < size / 2) ? 2 * ramp : 2 * (GEN_RANGE - 1 - ramp);
+        default:
+            return (int)(random % GEN_RANGE);
+    }
+}
+
+void *GenerateThread(void *generate_task)
 {
-    int n = high - low + 1;
-    int h = 1;
+    generate_task_t *task = (generate_task_t *)generate_task;
 
-    while (h < (n / 2)) 
+    for (size_t idx = task->left; idx < task->right; ++idx)
     {
-        h = 2 * h + 1;
+        task->array[idx] = GenerateValue(task->seed, idx, task->size, task->distribution);
     }
 
-    while (h >= 1) 
+    /* Each thread stores its own region while it is still hot in the cache */
+    for (size_t idx = task->left; -1 != task->fd && idx < task->right; )
     {
-        for (size_t idx = low + h; idx <= high; ++idx) 
+        size_t bytes = (task->right - idx) * sizeof(int);
+        if (bytes > GEN_WRITE_CHUNK)
         {
-            int key = array[idx];
-            int j = idx - h;
-            while (j >= low && array[j] > key) 
-            {
-                array[j + h] = array[j];
-                j -= h;
-            }
-            array[j + h] = key;
+            bytes = GEN_WRITE_CHUNK;
+        }
+
+        ssize_t written = pwrite(task->fd, task->array + idx, bytes, idx * sizeof(int));
+        if (0 >= written || 0 != written % sizeof(int))
+        {
+            task->status = -1;
+            break;
+        }
+
+        idx += written / sizeof(int);
+    }
+
+    return NULL;
+}
+
+void GenerateArray(int *arr, size_t size, int seed, char distribution, int maxthreads, int write)
+{
+    int fd = -1;
+    size_t chunk = 0;
+    generate_task_t *tasks = NULL;
+
+    if (seed < 0) 
+    {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        seed = tv.tv_usec;
+    }
+
+    if (TRUE == write)
+    {
+        fd = open(DATA_FILE, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (-1 == fd || 0 != ftruncate(fd, size * sizeof(int)))
+        {
+            perror("Error opening data file");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if ((size_t)maxthreads > size)
+    {
+        maxthreads = (int)size;
+    }
+
+    tasks = (generate_task_t *)calloc(maxthreads, sizeof(generate_task_t));
+    if (NULL == tasks)
+    {
+        perror("Allocation memory is failure!");
+        exit(EXIT_FAILURE);
+    }
+
+    gettimeofday(&load_start_time, NULL);
+
+    chunk = size / maxthreads;
+    for (int thread = 0; thread < maxthreads; ++thread)
+    {
+        tasks[thread].array = arr;
+        tasks[thread].left = thread * chunk;
+        tasks[thread].right = (thread + 1 == maxthreads) ? size : (thread + 1) * chunk;
+        tasks[thread].size = size;
+        tasks[thread].seed = (uint64_t)seed;
+        tasks[thread].distribution = distribution;
+        tasks[thread].fd = fd;
+    }
+
+    /* The calling thread takes the first region itself */
+    RunTasks(tasks, sizeof(generate_task_t), maxthreads, GenerateThread);
+
+    for (int thread = 0; thread < maxthreads; ++thread)
+    {
+        if (0 != tasks[thread].status)
+        {
+            perror("Error writing data file");
+            exit(EXIT_FAILURE);
         }
-        h /= 2;
     }
+
+    gettimeofday(&load_end_time, NULL);
+
+    if (-1 != fd)
+    {
+        close(fd);
+    }
+
+    free(tasks);
 }
 
 void Quicksort(int *array, int low, int high, int threshold, int median)
@@ -236,6 +753,8 @@ void Quicksort(int *array, int low, int high, int threshold, int median)
 
     if (2 > size)
     {
+        PROFILE_LEAF(size);
+        METRICS_COMPLETE(size);
         return;
     }
     else if (2 == size)
@@ -247,9 +766,13 @@ void Quicksort(int *array, int low, int high, int threshold, int median)
     }
     else if (size <= threshold)
     {
+        PROFILE_LEAF(size);
+        PROFILE_START(shell_start);
         ShellSort(array, low, high);
+        PROFILE_ADD(shell_ns, shell_start);
     }
 
+    PROFILE_START(partition_start);
     if (1 == median) 
     {
         int mid = low + (high - low) / 2;
@@ -260,7 +783,11 @@ void Quicksort(int *array, int low, int high, int threshold, int median)
     size_t i = 0;
     size_t j = 0;
     Partition(array, low, high, &i, &j);
+    PROFILE_ADD(partition_ns, partition_start);
+    PROFILE_SPLIT(low, high, j);
+    METRICS_COMPLETE(i - j);
 
+    PROFILE_DESCEND();
     if ((j - low) < (high - i)) 
     {
         Quicksort(array, low, j - 1, threshold, median);
@@ -271,68 +798,7 @@ void Quicksort(int *array, int low, int high, int threshold, int median)
         Quicksort(array, i, high, threshold, median);
         Quicksort(array, low, j - 1, threshold, median);
     }
-}
-
-void Partition(int *array, int low, int high, size_t *i, size_t *j)
-{
-    /* Choose the first element in the subarray as the pivot */
-    int pivot = array[low];
-
-    /* Initialize i to the second element */ 
-    *i = low + 1;
-    /* Initialize j to the last element in the subarray */
-    *j = high;
-
-    /* Continue the loop until i and j pointers cross each other */
-    while (TRUE) 
-    {
-        /* Move i pointer to the right until an element greater than the pivot is found */
-        while (*i <= *j && array[*i] <= pivot) 
-        {
-            ++(*i);
-        }
-
-        /* Move j pointer to the left until an element less than the pivot is found */
-        while (*i <= *j && array[*j] >= pivot) 
-        {
-            --(*j);
-        }
-
-        /* Exit the loop if the i and j pointers have crossed each other */
-        if (*i > *j) 
-        {
-            break;
-        }
-
-        /* Swap the elements at positions i and j as they are on the wrong side of the pivot */
-        Swap(&array[*i], &array[*j]);
-    }
-
-    /* Swap the pivot element with the element at position j, placing the pivot in its correct position */
-    Swap(&array[low], &array[*j]);
-}
-
-int MedianOfThree(int *array, int low, int mid, int high) 
-{
-    /* Check if the value at 'lo' is the median of the three values */
-    /* (array[low] - array[mid]) * (array[high] - array[low]) >= 0 is equivalent to 
-            (array[low] >= array[mid] && array[low] <= array[high]) || (array[low] <= array[mid] && array[low] >= array[high]) */
-    if ((array[low] - array[mid]) * (array[high] - array[low]) >= 0) 
-    {
-        return low;
-    } 
-    /* Check if the value at 'mid' is the median of the three values */
-    /* (array[mid] - array[low]) * (array[high] - array[mid]) >= 0 is equivalent to 
-            (array[mid] >= array[low] && array[mid] <= array[high]) || (array[mid] <= array[low] && array[mid] >= array[high]) */
-    else if ((array[mid] - array[low]) * (array[high] - array[mid]) >= 0) 
-    {
-        return mid;
-    } 
-    /* If neither low nor mid is the median, then the value at high must be the median */
-    else 
-    {
-        return high;
-    }
+    PROFILE_ASCEND();
 }
 
 int SecondOfTenPartition(int *arr, size_t size) 
@@ -386,6 +852,171 @@ int SecondOfTenPartition(int *arr, size_t size)
     return X;
 }
 
+int SelectionMode(int *array, const cmd_options_t *options)
+{
+    int status = 0;
+    int *out = (int *)malloc(sizeof(int) * options->topk);
+    verify_t expected;
+    verify_t result;
+    size_t less = 0;
+
+    if (NULL == out)
+    {
+        perror("Memory allocation is failure!");
+        return 1;
+    }
+
+    start = clock(); /* Get the starting CPU time */
+    gettimeofday(&sorting_start_time, NULL);
+    TopK(array, options->size, options->topk, out, (TRUE == options->multithread) ? options->maxthreads : 1);
+    gettimeofday(&sorting_end_time, NULL);
+    end = clock(); /* Get the ending CPU time */
+
+    printf("Top %lu: %d .. %d\n", options->topk, out[0], out[options->topk - 1]);
+
+    /* The expected multiset is every element below the largest selected one, padded with copies of it */
+    VerifyInit(&expected);
+    for (size_t idx = 0; idx < options->size; ++idx)
+    {
+        if (array[idx] < out[options->topk - 1])
+        {
+            VerifyAppend(&expected, array[idx]);
+            ++less;
+        }
+    }
+    while (less++ < options->topk)
+    {
+        VerifyAppend(&expected, out[options->topk - 1]);
+    }
+
+    VerifyBlock(out, options->topk, &result);
+    if (!result.sorted)
+    {
+        printf("ERROR - Data Not Sorted\n");
+        status = 1;
+    }
+    else if (!VerifyEqual(&expected, &result))
+    {
+        printf("ERROR - Data Checksum Mismatch\n");
+        status = 1;
+    }
+    else
+    {
+        printf("\n");
+    }
+
+    free(out);
+    return status;
+}
+
+int ParseQuantiles(const char *list, cmd_options_t *options)
+{
+    char *end = NULL;
+
+    options->nquantiles = 0;
+    while ('\0' != *list)
+    {
+        double percent = strtod(list, &end);
+
+        if (end == list || percent < 0 || percent > 100 || QUANTILES_MAX == options->nquantiles)
+        {
+            return 1;
+        }
+
+        options->quantiles[options->nquantiles++] = percent;
+        list = (',' == *end) ? end + 1 : end;
+        if (',' != *end && '\0' != *end)
+        {
+            return 1;
+        }
+    }
+
+    return (0 == options->nquantiles);
+}
+
+int QuantileMode(int *array, const cmd_options_t *options)
+{
+    int status = 0;
+    int values[QUANTILES_MAX];
+    double quantiles[QUANTILES_MAX];
+    size_t less[QUANTILES_MAX] = {0};
+    size_t less_equal[QUANTILES_MAX] = {0};
+    double bound = 0;
+    int maxthreads = (TRUE == options->multithread) ? options->maxthreads : 1;
+
+    for (size_t idx = 0; idx < options->nquantiles; ++idx)
+    {
+        quantiles[idx] = options->quantiles[idx] / 100;
+    }
+
+    start = clock(); /* Get the starting CPU time */
+    gettimeofday(&sorting_start_time, NULL);
+    if (TRUE == options->approximate)
+    {
+        sketch_t *sketch = SketchArray(array, options->size, maxthreads);
+        if (NULL == sketch)
+        {
+            return 1;
+        }
+
+        for (size_t idx = 0; idx < options->nquantiles; ++idx)
+        {
+            values[idx] = SketchQuery(sketch, quantiles[idx]);
+        }
+        bound = SketchErrorBound(sketch);
+        DestroySketch(sketch);
+    }
+    else if (0 != Quantiles(array, options->size, quantiles, options->nquantiles, values))
+    {
+        return 1;
+    }
+    gettimeofday(&sorting_end_time, NULL);
+    end = clock(); /* Get the ending CPU time */
+
+    /* One pass finds the range of ranks each reported value really has */
+    for (size_t idx = 0; idx < options->size; ++idx)
+    {
+        for (size_t quantile = 0; quantile < options->nquantiles; ++quantile)
+        {
+            less[quantile] += (array[idx] < values[quantile]);
+            less_equal[quantile] += (array[idx] <= values[quantile]);
+        }
+    }
+
+    for (size_t idx = 0; idx < options->nquantiles; ++idx)
+    {
+        size_t rank = (size_t)(quantiles[idx] * (options->size - 1));
+        size_t distance = 0;
+
+        if (rank < less[idx])
+        {
+            distance = less[idx] - rank;
+        }
+        else if (rank >= less_equal[idx])
+        {
+            distance = rank - less_equal[idx] + 1;
+        }
+
+        printf("p%-8g %11d (rank error %.4f%%)\n", options->quantiles[idx], values[idx], (100.0 * distance) / options->size);
+
+        if (distance > bound * options->size)
+        {
+            status = 1;
+        }
+    }
+
+    if (0 != status)
+    {
+        printf("ERROR - Quantile Out Of Bound (%.4f%%)\n", 100 * bound);
+    }
+    else
+    {
+        printf("\n");
+    }
+
+    return status;
+}
+
 void *QuicksortThread(void *thread_info) 
 {
     thread_info_t t_info = *(thread_info_t *)thread_info;
@@ -394,10 +1025,13 @@ void *QuicksortThread(void *thread_info)
     size_t size = 0;
     struct timespec timeout;
     int ret;
+    metrics_slot_t *slot = RegisterMetrics();
 
     while (TRUE)
     {
+        uint64_t waiting = MetricsNow();
         pthread_mutex_lock(&lock);
+        uint64_t locked = MetricsNow();
 
         while (IsEmpty(queue))
         {
@@ -408,12 +1042,14 @@ void *QuicksortThread(void *thread_info)
             {
                 /* Timeout occurred, unlock the mutex and exit the thread */
                 pthread_mutex_unlock(&lock);
+                MetricsWait(slot, waiting, locked, MetricsNow());
                 return NULL;
             }
         }
         
         s_info = Pop(queue);
         pthread_mutex_unlock(&lock);
+        MetricsWait(slot, waiting, locked, MetricsNow());
 
         if (NULL == s_info.array)
         {
@@ -427,7 +1063,9 @@ void *QuicksortThread(void *thread_info)
         }
         
         /* Call the QuickSort function to sort the partition */
+        uint64_t sorting = MetricsNow();
         Quicksort(s_info.array, s_info.left, s_info.right, t_info.threshold, t_info.median);
+        MetricsSegment(slot, sorting);
 
         pthread_cond_signal(&cv); /* Signal other threads that a new partition may be available. */
     }
@@ -444,12 +1082,19 @@ int main(int argc, const char *argv[])
 
     queue = CreateQueue();
 
+    /* The tuning runs the threaded quicksort many times, so the lock and the condition are initialized once */
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&cv, NULL);
+
     /* The structure contains values of all options */
     cmd_options_t options = {0};
 
-    /* Time structures for start and end points */
+    /* Time structure for the start point */
     struct timeval start_time;
-    struct timeval end_time;
+
+    /* Checksums of the loaded and of the sorted data */
+    verify_t input_verify;
+    verify_t output_verify;
 
     /* The default values of the options */
     options.size = 0;        
@@ -461,48 +1106,252 @@ int main(int argc, const char *argv[])
     options.maxthreads = 4;     
     options.median = FALSE;     
     options.early = FALSE;
+    options.distribution = '\0';
+    options.write = FALSE;
+    options.record = 0;
+    options.engine = 'R';
+    options.stream = FALSE;
+    options.cap = STREAM_CAP;
+    options.compress = FALSE;
+    options.compressed = FALSE;
+    options.processes = 0;
+    options.buckets = 0;
+    options.tune = FALSE;
+    options.output = NULL;
+    options.lookup = NULL;
+    options.serve = NULL;
+    options.client = NULL;
+    options.metrics = NULL;
+    options.strings = NULL;
 
     /****************************************** Preparation ******************************************************/
 
+    /* The parameters tuned on this host replace the defaults, the arguments still override them */
+    LoadProfile(TUNE_FILE, &options);
+
     /* Parsing of the argv array */
     if (0 != ParseArgv(argv, argc, &options))
     {
         return 1;
     }
 
-    /* Creation of the array with specified size */
-    int *array = (int *)malloc(sizeof(int) * options.size);
-    if (NULL == array)
+    /* The parameters are timed on this host instead of sorting */
+    if (TRUE == options.tune)
     {
-        perror("Memory allocation is failure!");
-        return 1;
-    }
+        int status = TuneMode(&options);
 
-    /* Loading values for the array from the file */
-    LoadArray(array, options.size, options.seed);
+        DestroyQueue(queue);
+        return status;
+    }
 
-    /****************************************** Execution ******************************************************/
+    /* The lines of the file are sorted instead of the array */
+    if (NULL != options.strings)
+    {
+        int status = StringMode(&options);
 
-    /* To get a start time point */
-    gettimeofday(&start_time, NULL);
+        DestroyQueue(queue);
+        return status;
+    }
 
-    /* If EARLY is enabled */
-    if (TRUE == options.early) 
+    /* The input comes from stdin and its size is not known in advance */
+    if (TRUE == options.stream)
     {
-        size_t start = 0;
-        size_t end = 0;
-        size_t early_size = 0;
+        int status = StreamMode(&options);
 
-        /* Perform the "second of ten" partitioning */
-        int X = SecondOfTenPartition(array, options.size);
+        DestroyQueue(queue);
+        return status;
+    }
 
-        /* Swap Array[X] and Array[0] */
-        Swap(&array[0], &array[X]);
+    /* The daemon sorts the buffers of other processes, the client sends its array to the daemon */
+    if (NULL != options.serve || NULL != options.client)
+    {
+        gettimeofday(&start_time, NULL);
+        int status = (NULL != options.serve) ? DaemonMode(&options) : ClientMode(&options);
 
+        if (NULL != options.client)
+        {
+            PrintTimes("Sort", &start_time);
+        }
+        DestroyQueue(queue);
+        return status;
+    }
 
-        int total;
-        size_t part;
-        Partition(array, 0, options.size - 1, &start, &end);
+    /* The workers load and sort the array in their own processes */
+    if (0 != options.processes)
+    {
+        gettimeofday(&start_time, NULL);
+        int status = DistributedMode(&options);
+
+        PrintTimes("Sort", &start_time);
+        DestroyQueue(queue);
+        return status;
+    }
+
+    /* Creation of the array with specified size */
+    int *array = (int *)malloc(sizeof(int) * options.size);
+    if (NULL == array)
+    {
+        perror("Memory allocation is failure!");
+        return 1;
+    }
+
+    /* The progress is served while the array is loaded and sorted */
+    if (NULL != options.metrics && 0 != StartMetrics(options.metrics, options.size, options.maxthreads + 2, &queue->count))
+    {
+        free(array);
+        DestroyQueue(queue);
+        return 1;
+    }
+
+    /* Loading values for the array from the file or generating them */
+    if ('\0' != options.distribution)
+    {
+        GenerateArray(array, options.size, options.seed, options.distribution, options.maxthreads, options.write);
+    }
+    else
+    {
+        LoadArray(array, options.size, options.seed);
+    }
+
+    /* To remember the multiset of the input to catch lost or duplicated elements */
+    SetMetricsPhase(METRICS_VERIFY);
+    VerifyArray(array, options.size, options.maxthreads, &input_verify);
+
+    /****************************************** Execution ******************************************************/
+
+    /* To get a start time point */
+    gettimeofday(&start_time, NULL);
+
+    /* Only the smallest elements are requested, so the array is not sorted */
+    if (0 != options.topk)
+    {
+        int status = SelectionMode(array, &options);
+
+        PrintTimes("Select", &start_time);
+        free(array);
+        DestroyQueue(queue);
+        return status;
+    }
+
+    /* The stable merge sort does not use the quicksort engine and its queue */
+    if ('M' == options.alternate || 'm' == options.alternate)
+    {
+        int status = StableMode(array, &options, &input_verify);
+
+        PrintTimes("Sort", &start_time);
+        free(array);
+        DestroyQueue(queue);
+        return status;
+    }
+
+    /* The algorithm is chosen by the library from a sample of the array, or is its natural merge sort */
+    if ('A' == options.alternate || 'a' == options.alternate || 'N' == options.alternate || 'n' == options.alternate ||
+            'C' == options.alternate || 'c' == options.alternate)
+    {
+        int status = LibraryMode(array, &options, &input_verify);
+
+        PrintTimes("Sort", &start_time);
+        free(array);
+        DestroyQueue(queue);
+        return status;
+    }
+
+    /* The array holds the keys to look up in a sorted file */
+    if (NULL != options.lookup)
+    {
+        int status = LookupMode(array, &options);
+
+        PrintTimes("Lookup", &start_time);
+        free(array);
+        DestroyQueue(queue);
+        return status;
+    }
+
+    /* The array is only split into key ranges */
+    if (0 != options.buckets)
+    {
+        int status = PartitionMode(array, &options, &input_verify);
+
+        PrintTimes("Partition", &start_time);
+        free(array);
+        DestroyQueue(queue);
+        return status;
+    }
+
+    /* A table whose last column is the array is sorted instead of the array */
+    if (0 != options.columns)
+    {
+        int status = ColumnMode(array, &options);
+
+        PrintTimes("Sort", &start_time);
+        free(array);
+        DestroyQueue(queue);
+        return status;
+    }
+
+    /* Records keyed by the array are sorted instead of the array */
+    if (0 != options.record)
+    {
+        int status = RecordMode(array, &options);
+
+        PrintTimes("Sort", &start_time);
+        free(array);
+        DestroyQueue(queue);
+        return status;
+    }
+
+    /* The array is fed into the incremental container batch by batch */
+    if (0 != options.batch)
+    {
+        int status = LsmMode(array, &options, &input_verify);
+
+        PrintTimes("Ingest", &start_time);
+        free(array);
+        DestroyQueue(queue);
+        return status;
+    }
+
+    /* Only the quantiles are requested */
+    if (0 != options.nquantiles)
+    {
+        int status = QuantileMode(array, &options);
+
+        PrintTimes("Quantiles", &start_time);
+        free(array);
+        DestroyQueue(queue);
+        return status;
+    }
+
+    /* The smallest elements are handed out while the rest is still sorted */
+    if (0 != options.lazy)
+    {
+        int status = LazyMode(array, &options, &input_verify);
+
+        PrintTimes("Sort", &start_time);
+        free(array);
+        DestroyQueue(queue);
+        return status;
+    }
+
+    /* If EARLY is enabled */
+    if (TRUE == options.early) 
+    {
+        size_t start = 0;
+        size_t end = 0;
+        size_t early_size = 0;
+
+        SetMetricsPhase(METRICS_PARTITION);
+
+        /* Perform the "second of ten" partitioning */
+        int X = SecondOfTenPartition(array, options.size);
+
+        /* Swap Array[X] and Array[0] */
+        Swap(&array[0], &array[X]);
+
+
+        int total;
+        size_t part;
+        Partition(array, 0, options.size - 1, &start, &end);
 
         early_segment.array = array;
         early_segment.left = 0;
@@ -539,6 +1388,8 @@ int main(int argc, const char *argv[])
     /* If multithreaded is FALSE */
     else
     {
+        SetMetricsPhase(METRICS_SORT);
+        RegisterMetrics();
         start = clock(); /* Get the starting CPU time */
         gettimeofday(&sorting_start_time, NULL);
         Quicksort(array, 0, options.size - 1, options.threshold, options.median);
@@ -564,44 +1415,60 @@ int main(int argc, const char *argv[])
         gettimeofday(&sorting_end_time, NULL);
         end = clock(); /* Get the ending CPU time */
 
-        MergeSortedSegments(array, segments, options.pieces);
+        /* The output checksum is accumulated by the merge itself, so it costs no extra pass */
+        SetMetricsPhase(METRICS_MERGE);
+        MergeSortedSegments(array, segments, options.pieces, &output_verify);
+    }
+    else
+    {
+        SetMetricsPhase(METRICS_VERIFY);
+        VerifyArray(array, options.size, options.maxthreads, &output_verify);
     }
+    SetMetricsPhase(METRICS_DONE);
 
     /****************************************** Resulting ******************************************************/
 
     /* To check whether the array is sorted or not */
-    if (!IsSorted(array, options.size)) 
+    int status = 0;
+    if (!output_verify.sorted) 
     {
         printf("ERROR - Data Not Sorted\n");
+        status = 1;
+    }
+    else if (!VerifyEqual(&input_verify, &output_verify))
+    {
+        printf("ERROR - Data Checksum Mismatch\n");
+        status = 1;
     }
     else
     {
         printf("\n");
     }
     
-    /* To get a time point */
-    gettimeofday(&end_time, NULL);
+    PrintTimes("Sort", &start_time);
 
-    double load_time = ((load_end_time.tv_sec - load_start_time.tv_sec) * 1e6 + (load_end_time.tv_usec - load_start_time.tv_usec)) / 1e6;
-    double sorting_time = ((sorting_end_time.tv_sec - sorting_start_time.tv_sec) * 1e6 + (sorting_end_time.tv_usec - sorting_start_time.tv_usec)) / 1e6;
-    double cpu_time_used = ((double) (end - start)) / CLOCKS_PER_SEC;
-    double total_time = (end_time.tv_sec - start_time.tv_sec) + (end_time.tv_usec - start_time.tv_usec) / 1e6;
+#ifdef QSORT_PROFILE
+    PrintQuicksortProfile();
+#endif
 
-    printf("Load data: %.3f ", load_time);
-    printf("Sort (Wall/CPU): %.3f / %.3f ", sorting_time, cpu_time_used);
-    printf("Total: %.3f\n", total_time);
+    /* Only a verified array is kept with its block index for the lookups */
+    if (NULL != options.output && 0 == status)
+    {
+        status = WriteIndexed(options.output, array, options.size);
+    }
 
     if (TRUE == options.multithread)
     {
-        free(threads);
-        free(segments);
+        ScratchRelease(threads);
+        ScratchRelease(segments);
     }
 
+    StopMetrics();
     free(array);
     DestroyQueue(queue);
     pthread_mutex_destroy(&lock);
     pthread_cond_destroy(&cv);
-    return 0;
+    return status;
 }
 
 /*****************************************************
@@ -609,22 +1476,184 @@ int main(int argc, const char *argv[])
  ****************************************************/
 int IsSorted(int *array, size_t size) 
 {
-    for (size_t idx = 0; idx < size - 1; idx++) 
+    verify_t verify;
+
+    VerifyBlock(array, size, &verify);
+
+    return verify.sorted;
+}
+
+uint32_t HashValue(int value)
+{
+    /* The finalizer of MurmurHash3, it only uses 32-bit operations so the loops stay vectorizable */
+    uint32_t hash = (uint32_t)value ^ VERIFY_HASH_SEED;
+
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6BU;
+    hash ^= hash >> 13;
+    hash *= 0xC2B2AE35U;
+    hash ^= hash >> 16;
+
+    return hash;
+}
+
+void VerifyInit(verify_t *verify)
+{
+    verify->count = 0;
+    verify->sum = 0;
+    verify->hash_sum = 0;
+    verify->hash_xor = 0;
+    verify->sorted = TRUE;
+    verify->first = INT_MIN;
+    verify->last = INT_MIN;
+}
+
+void VerifyAppend(verify_t *verify, int value)
+{
+    uint32_t hash = HashValue(value);
+
+    if (0 == verify->count)
     {
-        if (array[idx] > array[idx + 1]) 
-        {
-            return 0;
-        }
+        verify->first = value;
+    }
+    else if (verify->last > value)
+    {
+        verify->sorted = FALSE;
+    }
+
+    verify->last = value;
+    verify->sum += (uint64_t)(int64_t)value;
+    verify->hash_sum += hash;
+    verify->hash_xor ^= hash;
+    ++verify->count;
+}
+
+void VerifyBlock(const int *array, size_t size, verify_t *verify)
+{
+    uint64_t sum = 0;
+    uint64_t hash_sum = 0;
+    uint32_t hash_xor = 0;
+    int unsorted = 0;
+
+    VerifyInit(verify);
+    if (0 == size)
+    {
+        return;
+    }
+
+    /* Branchless on purpose: every iteration does the same work, so the compiler vectorizes the loop */
+    for (size_t idx = 1; idx < size; ++idx)
+    {
+        uint32_t hash = HashValue(array[idx]);
+
+        unsorted |= (array[idx - 1] > array[idx]);
+        sum += (uint64_t)(int64_t)array[idx];
+        hash_sum += hash;
+        hash_xor ^= hash;
+    }
+
+    verify->count = size;
+    verify->sum = sum + (uint64_t)(int64_t)array[0];
+    verify->hash_sum = hash_sum + HashValue(array[0]);
+    verify->hash_xor = hash_xor ^ HashValue(array[0]);
+    verify->sorted = !unsorted;
+    verify->first = array[0];
+    verify->last = array[size - 1];
+}
+
+void VerifyCombine(verify_t *verify, const verify_t *next)
+{
+    if (0 == next->count)
+    {
+        return;
+    }
+
+    if (0 == verify->count)
+    {
+        *verify = *next;
+        return;
+    }
+
+    verify->sorted = verify->sorted && next->sorted && (verify->last <= next->first);
+    verify->count += next->count;
+    verify->sum += next->sum;
+    verify->hash_sum += next->hash_sum;
+    verify->hash_xor ^= next->hash_xor;
+    verify->last = next->last;
+}
+
+void *VerifyThread(void *verify_task)
+{
+    verify_task_t *task = (verify_task_t *)verify_task;
+
+    VerifyBlock(task->array, task->size, &task->result);
+
+    return NULL;
+}
+
+void VerifyArray(const int *array, size_t size, int maxthreads, verify_t *verify)
+{
+    size_t chunk = 0;
+    int nthreads = (1 > maxthreads) ? 1 : maxthreads;
+    verify_task_t *tasks = NULL;
+
+    VerifyInit(verify);
+
+    if ((size_t)nthreads > size)
+    {
+        nthreads = (0 == size) ? 1 : (int)size;
+    }
+
+    tasks = (verify_task_t *)calloc(nthreads, sizeof(verify_task_t));
+    if (NULL == tasks)
+    {
+        /* Fall back to a single scan of the whole array */
+        VerifyBlock(array, size, verify);
+        return;
+    }
+
+    chunk = size / nthreads;
+    for (int thread = 0; thread < nthreads; ++thread)
+    {
+        tasks[thread].array = array + thread * chunk;
+        tasks[thread].size = (thread + 1 == nthreads) ? (size - thread * chunk) : chunk;
+    }
+
+    /* The calling thread takes the first chunk itself */
+    RunTasks(tasks, sizeof(verify_task_t), nthreads, VerifyThread);
+
+    /* Chunks are combined in order so the boundaries between them are checked as well */
+    for (int thread = 0; thread < nthreads; ++thread)
+    {
+        VerifyCombine(verify, &tasks[thread].result);
     }
 
-    return 1;
+    free(tasks);
+}
+
+int VerifyEqual(const verify_t *input, const verify_t *output)
+{
+    return input->count == output->count &&
+           input->sum == output->sum &&
+           input->hash_sum == output->hash_sum &&
+           input->hash_xor == output->hash_xor;
 }
 
-void Swap(int *a, int *b)
+void PrintTimes(const char *phase, const struct timeval *start_time)
 {
-    int temp = *a;
-    *a = *b;
-    *b = temp;
+    struct timeval end_time;
+
+    /* To get a time point */
+    gettimeofday(&end_time, NULL);
+
+    double load_time = ((load_end_time.tv_sec - load_start_time.tv_sec) * 1e6 + (load_end_time.tv_usec - load_start_time.tv_usec)) / 1e6;
+    double sorting_time = ((sorting_end_time.tv_sec - sorting_start_time.tv_sec) * 1e6 + (sorting_end_time.tv_usec - sorting_start_time.tv_usec)) / 1e6;
+    double cpu_time_used = ((double) (end - start)) / CLOCKS_PER_SEC;
+    double total_time = (end_time.tv_sec - start_time->tv_sec) + (end_time.tv_usec - start_time->tv_usec) / 1e6;
+
+    printf("Load data: %.3f ", load_time);
+    printf("%s (Wall/CPU): %.3f / %.3f ", phase, sorting_time, cpu_time_used);
+    printf("Total: %.3f\n", total_time);
 }
 
 int ParseArgv(const char **argv, size_t size, cmd_options_t *options)
@@ -671,6 +1700,104 @@ int ParseArgv(const char **argv, size_t size, cmd_options_t *options)
             option = argv[++idx][0];
             options->early = (option == 'Y' || option == 'y');
         } 
+        else if (strcmp(argv[idx], "-g") == 0 && idx + 1 < size) 
+        {
+            options->distribution = argv[++idx][0];
+        } 
+        else if (strcmp(argv[idx], "-k") == 0 && idx + 1 < size) 
+        {
+            options->topk = atoi(argv[++idx]);
+        } 
+        else if ((strcmp(argv[idx], "-q") == 0 || strcmp(argv[idx], "-qa") == 0) && idx + 1 < size) 
+        {
+            options->approximate = (strcmp(argv[idx], "-qa") == 0);
+            if (0 != ParseQuantiles(argv[++idx], options))
+            {
+                printf("Invalid QUANTILES value: %s\n", argv[idx]);
+                return 1;
+            }
+        } 
+        else if (strcmp(argv[idx], "-K") == 0 && idx + 1 < size) 
+        {
+            options->columns = atoi(argv[++idx]);
+        } 
+        else if (strcmp(argv[idx], "-R") == 0 && idx + 1 < size) 
+        {
+            options->record = atoi(argv[++idx]);
+        } 
+        else if (strcmp(argv[idx], "-pe") == 0 && idx + 1 < size) 
+        {
+            options->engine = argv[++idx][0];
+        } 
+        else if (strcmp(argv[idx], "-l") == 0 && idx + 1 < size) 
+        {
+            options->lazy = atoi(argv[++idx]);
+        } 
+        else if (strcmp(argv[idx], "-b") == 0 && idx + 1 < size) 
+        {
+            options->batch = atoi(argv[++idx]);
+        } 
+        else if (strcmp(argv[idx], "-i") == 0 && idx + 1 < size) 
+        {
+            option = argv[++idx][0];
+            options->stream = (option == 'Y' || option == 'y');
+        } 
+        else if (strcmp(argv[idx], "-z") == 0 && idx + 1 < size) 
+        {
+            option = argv[++idx][0];
+            options->compress = (option == 'Y' || option == 'y');
+        } 
+        else if (strcmp(argv[idx], "-zi") == 0 && idx + 1 < size) 
+        {
+            option = argv[++idx][0];
+            options->compressed = (option == 'Y' || option == 'y');
+        } 
+        else if (strcmp(argv[idx], "-c") == 0 && idx + 1 < size) 
+        {
+            options->cap = atoi(argv[++idx]);
+        } 
+        else if (strcmp(argv[idx], "-S") == 0 && idx + 1 < size) 
+        {
+            options->serve = argv[++idx];
+        } 
+        else if (strcmp(argv[idx], "-C") == 0 && idx + 1 < size) 
+        {
+            options->client = argv[++idx];
+        } 
+        else if (strcmp(argv[idx], "-o") == 0 && idx + 1 < size) 
+        {
+            options->output = argv[++idx];
+        } 
+        else if (strcmp(argv[idx], "-L") == 0 && idx + 1 < size) 
+        {
+            options->lookup = argv[++idx];
+        } 
+        else if (strcmp(argv[idx], "-B") == 0 && idx + 1 < size) 
+        {
+            options->buckets = atoi(argv[++idx]);
+        } 
+        else if (strcmp(argv[idx], "-P") == 0 && idx + 1 < size) 
+        {
+            options->processes = atoi(argv[++idx]);
+        } 
+        else if (strcmp(argv[idx], "-M") == 0 && idx + 1 < size) 
+        {
+            options->metrics = argv[++idx];
+        } 
+        else if (strcmp(argv[idx], "-F") == 0 && idx + 1 < size) 
+        {
+            options->strings = argv[++idx];
+        } 
+        else if (strcmp(argv[idx], "-T") == 0 && idx + 1 < size) 
+        {
+            option = argv[++idx][0];
+            options->tune = (option == 'Y' || option == 'y');
+        } 
+        else if (strcmp(argv[idx], "-w") == 0 && idx + 1 < size) 
+        {
+            option = argv[++idx][0];
+            options->write = (option == 'Y' || option == 'y');
+        } 
         else 
         {
             printf("Invalid argument: %s\n", argv[idx]);
@@ -678,6 +1805,12 @@ int ParseArgv(const char **argv, size_t size, cmd_options_t *options)
         }
     }
 
+    /* The daemon takes the sizes from its requests, the string sort all lines of the file */
+    if ((NULL != options->serve || NULL != options->strings) && 0 == options->size) 
+    {
+        options->size = MAX_SIZE;
+    }
+
     if (options->size < MIN_SIZE || options->size > MAX_SIZE) 
     {
         printf("Invalid SIZE value: %lu\n", options->size);
@@ -685,7 +1818,11 @@ int ParseArgv(const char **argv, size_t size, cmd_options_t *options)
     }
 
     if ('S' != options->alternate && 's' != options->alternate && 
-            'I' != options->alternate && 'i' != options->alternate) 
+            'I' != options->alternate && 'i' != options->alternate &&
+            'M' != options->alternate && 'm' != options->alternate &&
+            'A' != options->alternate && 'a' != options->alternate &&
+            'N' != options->alternate && 'n' != options->alternate &&
+            'C' != options->alternate && 'c' != options->alternate) 
     {
         printf("Invalid ALTERNATE value: %c\n", options->alternate);
         return 1;
@@ -709,30 +1846,115 @@ int ParseArgv(const char **argv, size_t size, cmd_options_t *options)
         return 1;
     }
 
-    return 0;
-}
+    if ('\0' != options->distribution && NULL == strchr("UuSsRrNnFfEeOo", options->distribution)) 
+    {
+        printf("Invalid DISTRIBUTION value: %c\n", options->distribution);
+        return 1;
+    }
 
-void Multithreaded(int *array, cmd_options_t *options)
-{
-    pthread_mutex_init(&lock, NULL);
-    pthread_cond_init(&cv, NULL);
+    if (options->topk > options->size) 
+    {
+        printf("Invalid TOPK value: %lu\n", options->topk);
+        return 1;
+    }
 
-    threads = (pthread_t *)calloc(options->maxthreads, sizeof(pthread_t));
-    if (NULL == threads)
+    if (0 != options->record && (options->record < MIN_RECORD || 0 != options->record % sizeof(int) || options->size > UINT32_MAX)) 
     {
-        perror("Allocation memory is failure!");
-        return;
+        printf("Invalid RECORD value: %lu\n", options->record);
+        return 1;
     }
 
-    segments = (segment_t *)calloc(options->pieces, sizeof(segment_t));
-    if (NULL == segments)
+    if (0 != options->columns && (MAX_COLUMNS < options->columns || options->size > UINT32_MAX)) 
     {
-        perror("Allocation memory is failure!");
-        return;
+        printf("Invalid COLUMNS value: %lu\n", options->columns);
+        return 1;
     }
 
-    /* Partition the array into segments and store their indices in thread_args */
-    DivideArray(array, options, segments);
+    if ('R' != options->engine && 'r' != options->engine && 'Q' != options->engine && 'q' != options->engine) 
+    {
+        printf("Invalid ENGINE value: %c\n", options->engine);
+        return 1;
+    }
+
+    if (options->batch > options->size) 
+    {
+        printf("Invalid BATCH value: %lu\n", options->batch);
+        return 1;
+    }
+
+    if (options->lazy > options->size) 
+    {
+        printf("Invalid LAZY value: %lu\n", options->lazy);
+        return 1;
+    }
+
+    if (TRUE == options->compressed && options->size < RUN_BLOCK) 
+    {
+        printf("Invalid SIZE value: %lu (a run buffer takes at least %d values)\n", options->size, RUN_BLOCK);
+        return 1;
+    }
+
+    if (0 != options->processes && (2 > options->processes || MAX_PROCESSES < options->processes || options->size < (size_t)options->processes)) 
+    {
+        printf("Invalid PROCESSES value: %d\n", options->processes);
+        return 1;
+    }
+
+    if (0 != options->buckets && (2 > options->buckets || MAX_BUCKETS < options->buckets)) 
+    {
+        printf("Invalid BUCKETS value: %lu\n", options->buckets);
+        return 1;
+    }
+
+    if ((NULL != options->serve) + (NULL != options->client) + (0 != options->processes) > 1) 
+    {
+        printf("Invalid SOCKET value: -S, -C and -P are exclusive\n");
+        return 1;
+    }
+
+    if (1 > options->cap) 
+    {
+        printf("Invalid CAP value: %lu\n", options->cap);
+        return 1;
+    }
+
+    if (NULL != options->metrics && (NULL != strchr("MmAaNnCc", options->alternate) || 0 != options->topk || 
+                0 != options->nquantiles || 0 != options->record || 0 != options->columns || 0 != options->batch || 0 != options->lazy || 0 != options->buckets || 
+                NULL != options->lookup || TRUE == options->stream || TRUE == options->tune || 0 != options->processes ||
+                NULL != options->serve || NULL != options->client || NULL != options->strings)) 
+    {
+        printf("Invalid METRICS value: only the quicksort serves its metrics\n");
+        return 1;
+    }
+
+    if (TRUE == options->write && '\0' == options->distribution) 
+    {
+        printf("Invalid WRITE value: the array is written only if it is generated\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+void Multithreaded(int *array, cmd_options_t *options)
+{
+    threads = (pthread_t *)ScratchAcquire(sizeof(pthread_t) * options->maxthreads);
+    if (NULL == threads)
+    {
+        perror("Allocation memory is failure!");
+        return;
+    }
+
+    segments = (segment_t *)ScratchAcquire(sizeof(segment_t) * options->pieces);
+    if (NULL == segments)
+    {
+        perror("Allocation memory is failure!");
+        return;
+    }
+
+    /* Partition the array into segments and store their indices in thread_args */
+    SetMetricsPhase(METRICS_PARTITION);
+    DivideArray(array, options, segments);
 
     /* To fill up the queue */
     qsort(segments, options->pieces, sizeof(segment_t), compare);
@@ -748,6 +1970,7 @@ void Multithreaded(int *array, cmd_options_t *options)
     threads_info.median = options->median;
     threads_info.is_early = 0;
 
+    SetMetricsPhase(METRICS_SORT);
     start = clock(); /* Get the starting CPU time */
     gettimeofday(&sorting_start_time, NULL);
     for (size_t thread = 0; thread < options->maxthreads; ++thread) 
@@ -782,7 +2005,7 @@ void DivideArray(int *array, const cmd_options_t *options, segment_t *segments)
         size_t f_part = size_of_segment;
     }
 
-    free(temp);
+    ScratchRelease(temp);
 }
 
 size_t FindMaxIndex(int *arr, size_t len)
@@ -808,7 +2031,12 @@ int *SplitArray(size_t len, size_t pieces, float ratio)
     size_t i = 0;
     size_t curr_max_idx = 0;
     int temp = 0;
-    int *out = (int*)malloc(sizeof(int) * pieces);
+    int *out = (int *)ScratchAcquire(sizeof(int) * pieces);
+    if (NULL == out)
+    {
+        perror("Allocation memory is failure!");
+        exit(EXIT_FAILURE);
+    }
     out[0] = len;
 
     size_t index = 0;
@@ -877,6 +2105,8 @@ pq_t *CreateQueue()
     }
 
     queue->head = NULL;
+    queue->count = 0;
+    CreatePool(&queue->nodes, sizeof(pq_node_t));
     pthread_mutex_init(&queue->mutex, NULL);
     pthread_cond_init(&queue->cond, NULL);
     return queue;
@@ -892,19 +2122,22 @@ void DestroyQueue(pq_t *queue)
     pthread_mutex_unlock(&queue->mutex);
     pthread_mutex_destroy(&queue->mutex);
     pthread_cond_destroy(&queue->cond);
+    DestroyPool(&queue->nodes);
     free(queue);
 }
 
 void Push(pq_t *queue, segment_t data, int priority) 
 {
-    pthread_mutex_lock(&queue->mutex);
-
-    pq_node_t *new_node = (pq_node_t *)malloc(sizeof(pq_node_t));
+    /* The node is taken before the lock, so the other threads do not wait for the allocation */
+    pq_node_t *new_node = (pq_node_t *)PoolAlloc(&queue->nodes);
     if (NULL == new_node)
     {
         perror("Allocation memory is failure!");
         return;
     }
+
+    pthread_mutex_lock(&queue->mutex);
+
     new_node->data = data;
     new_node->priority = priority;
     new_node->next = NULL;
@@ -924,6 +2157,7 @@ void Push(pq_t *queue, segment_t data, int priority)
         new_node->next = current->next;
         current->next = new_node;
     }
+    __atomic_store_n(&queue->count, queue->count + 1, __ATOMIC_RELAXED);
 
     pthread_cond_signal(&queue->cond);
     pthread_mutex_unlock(&queue->mutex);
@@ -952,10 +2186,12 @@ segment_t Pop(pq_t *queue)
     segment_t dequeued_data = temp->data;
 
     queue->head = queue->head->next;
-    free(temp);
+    __atomic_store_n(&queue->count, queue->count - 1, __ATOMIC_RELAXED);
 
     pthread_mutex_unlock(&queue->mutex);
 
+    PoolFree(&queue->nodes, temp);
+
     return dequeued_data;
 }
 
@@ -1007,12 +2243,48 @@ int IsEmpty(pq_t *queue)
     return queue->head == NULL;
 }
 
-void MergeSortedSegments(int *array, segment_t *segments, int num_segments)
+void MergeSortedSegments(int *array, segment_t *segments, int num_segments, verify_t *verify)
+{
+    size_t total = 0;
+    int *output = NULL;
+
+    for (int segment_idx = 0; segment_idx < num_segments; ++segment_idx)
+    {
+        total += segments[segment_idx].right - segments[segment_idx].left + 1;
+    }
+
+    /* The segments live in the primary array, so merging in place would overwrite unread elements */
+    output = (int *)ScratchAcquire(sizeof(int) * total);
+    if (NULL == output)
+    {
+        perror("Allocation memory is failure!");
+        exit(EXIT_FAILURE);
+    }
+
+    total = MergeSegmentsInto(output, segments, num_segments, verify);
+    memcpy(array, output, sizeof(int) * total);
+
+    ScratchRelease(output);
+}
+
+size_t MergeSegmentsInto(int *output, segment_t *segments, int num_segments, verify_t *verify)
 {
-    size_t *indexes = (size_t *)calloc(num_segments, sizeof(size_t));
+    size_t *indexes = (size_t *)ScratchAcquire(sizeof(size_t) * num_segments);
     int segment_idx = 0;
     size_t output_idx = 0;
 
+    if (NULL == indexes)
+    {
+        perror("Allocation memory is failure!");
+        exit(EXIT_FAILURE);
+    }
+    memset(indexes, 0, sizeof(size_t) * num_segments);
+
+    if (NULL != verify)
+    {
+        VerifyInit(verify);
+    }
+
     /* Keep looping until all segments have been fully merged */
     while (1)
     {
@@ -1026,7 +2298,7 @@ void MergeSortedSegments(int *array, segment_t *segments, int num_segments)
             if (current_index <= segments[segment_idx].right)
             {
                 int current_value = segments[segment_idx].array[current_index];
-                if (current_value < min_value)
+                if (-1 == min_segment_idx || current_value < min_value)
                 {
                     min_value = current_value;
                     min_segment_idx = segment_idx;
@@ -1040,10 +2312,2267 @@ void MergeSortedSegments(int *array, segment_t *segments, int num_segments)
             break;
         }
 
-        /* Add the minimum value to the primary array and update the corresponding index */
-        segments[0].array[output_idx++] = min_value;
+        /* Add the minimum value to the output and update the corresponding index */
+        output[output_idx++] = min_value;
         indexes[min_segment_idx]++;
+
+        /* Check the order and the checksum while the value is still in a register */
+        if (NULL != verify)
+        {
+            VerifyAppend(verify, min_value);
+        }
+    }
+
+    ScratchRelease(indexes);
+    return output_idx;
+}
+
+int StableMode(int *array, const cmd_options_t *options, const verify_t *input_verify)
+{
+    int status = 0;
+    verify_t output_verify;
+    uint64_t *pairs = (uint64_t *)malloc(sizeof(uint64_t) * options->size);
+
+    if (NULL == pairs)
+    {
+        perror("Allocation memory is failure!");
+        exit(EXIT_FAILURE);
+    }
+
+    /* The index of arrival rides along with every key, the sort compares only the keys */
+    for (size_t idx = 0; idx < options->size; ++idx)
+    {
+        pairs[idx] = PackPair(array[idx], (uint32_t)idx);
+    }
+
+    start = clock(); /* Get the starting CPU time */
+    gettimeofday(&sorting_start_time, NULL);
+    if (0 != StableSortPairs(pairs, options->size, (TRUE == options->multithread) ? options->maxthreads : 1))
+    {
+        perror("Allocation memory is failure!");
+        exit(EXIT_FAILURE);
+    }
+    gettimeofday(&sorting_end_time, NULL);
+    end = clock(); /* Get the ending CPU time */
+
+    /* Equal keys must still be in the order of their arrival */
+    for (size_t idx = 0; idx < options->size; ++idx)
+    {
+        array[idx] = (int)((uint32_t)(pairs[idx] >> 32) ^ 0x80000000U);
+        if (0 == status && 0 != idx && (pairs[idx] >> 32) == (pairs[idx - 1] >> 32) && (uint32_t)pairs[idx] < (uint32_t)pairs[idx - 1])
+        {
+            printf("ERROR - Data Not Stable\n");
+            status = 1;
+        }
+    }
+    free(pairs);
+
+    VerifyArray(array, options->size, options->maxthreads, &output_verify);
+    if (0 != status)
+    {
+        /* Already reported */
+    }
+    else if (!output_verify.sorted) 
+    {
+        printf("ERROR - Data Not Sorted\n");
+        status = 1;
+    }
+    else if (!VerifyEqual(input_verify, &output_verify))
+    {
+        printf("ERROR - Data Checksum Mismatch\n");
+        status = 1;
+    }
+
+    if (0 == status)
+    {
+        printf("\n");
+    }
+
+    return status;
+}
+
+int LibraryMode(int *array, const cmd_options_t *options, const verify_t *input_verify)
+{
+    verify_t output_verify;
+    sort_profile_t profile;
+    int maxthreads = (TRUE == options->multithread) ? options->maxthreads : 1;
+    int is_adaptive = ('A' == options->alternate || 'a' == options->alternate);
+
+    start = clock(); /* Get the starting CPU time */
+    gettimeofday(&sorting_start_time, NULL);
+    if (TRUE == is_adaptive)
+    {
+        Sort(array, options->size, maxthreads, &profile);
+    }
+    else if ('N' == options->alternate || 'n' == options->alternate)
+    {
+        ParallelNaturalMergeSort(array, options->size, maxthreads);
+    }
+    else
+    {
+        ParallelCountingSort(array, options->size, maxthreads);
+    }
+    gettimeofday(&sorting_end_time, NULL);
+    end = clock(); /* Get the ending CPU time */
+
+    /* The decision is logged with the estimates it was made from */
+    if (TRUE == is_adaptive)
+    {
+        printf("Kernel: %s (sample: %lu, range: [%d, %d], duplicates: %.3f, runs: %.0f, inversions: %.3f)\n",
+                SortKernelName(profile.kernel), profile.sample, profile.min, profile.max, 
+                profile.duplicates, profile.runs, profile.inversions);
+    }
+
+    VerifyArray(array, options->size, options->maxthreads, &output_verify);
+    if (!output_verify.sorted) 
+    {
+        printf("ERROR - Data Not Sorted\n");
+        return 1;
+    }
+    else if (!VerifyEqual(input_verify, &output_verify))
+    {
+        printf("ERROR - Data Checksum Mismatch\n");
+        return 1;
+    }
+
+    if (NULL != options->output && 0 != WriteIndexed(options->output, array, options->size))
+    {
+        return 1;
+    }
+
+    printf("\n");
+    return 0;
+}
+
+int PartitionMode(int *array, const cmd_options_t *options, const verify_t *input_verify)
+{
+    verify_t output_verify;
+    int maxthreads = (TRUE == options->multithread) ? options->maxthreads : 1;
+    size_t nbuckets = options->buckets;
+    int *out = (int *)malloc(sizeof(int) * options->size);
+    int *splitters = (int *)malloc(sizeof(int) * nbuckets);
+    size_t *offsets = (size_t *)malloc(sizeof(size_t) * (nbuckets + 1));
+    size_t smallest = options->size;
+    size_t largest = 0;
+    size_t misplaced = 0;
+
+    if (NULL == out || NULL == splitters || NULL == offsets)
+    {
+        perror("Allocation memory is failure!");
+        exit(EXIT_FAILURE);
+    }
+
+    start = clock(); /* Get the starting CPU time */
+    gettimeofday(&sorting_start_time, NULL);
+    if (0 != ChooseSplitters(array, options->size, splitters, nbuckets) ||
+            0 != RangePartition(array, options->size, out, splitters, nbuckets, offsets, maxthreads))
+    {
+        perror("Allocation memory is failure!");
+        exit(EXIT_FAILURE);
+    }
+    gettimeofday(&sorting_end_time, NULL);
+    end = clock(); /* Get the ending CPU time */
+
+    /* Every value has to lie within the key range of its bucket */
+    for (size_t bucket = 0; bucket < nbuckets; ++bucket)
+    {
+        size_t size = offsets[bucket + 1] - offsets[bucket];
+
+        smallest = (size < smallest) ? size : smallest;
+        largest = (size > largest) ? size : largest;
+        for (size_t idx = offsets[bucket]; idx < offsets[bucket + 1]; ++idx)
+        {
+            misplaced += (0 < bucket && out[idx] < splitters[bucket - 1]) || 
+                    (bucket + 1 < nbuckets && out[idx] >= splitters[bucket]);
+        }
+    }
+
+    printf("Buckets: %lu (smallest: %lu, largest: %lu, even: %lu)\n", nbuckets, smallest, largest, options->size / nbuckets);
+
+    VerifyArray(out, options->size, options->maxthreads, &output_verify);
+    free(offsets);
+    free(splitters);
+    free(out);
+
+    if (0 != misplaced) 
+    {
+        printf("ERROR - %lu Values Out Of Their Buckets\n", misplaced);
+        return 1;
+    }
+    else if (!VerifyEqual(input_verify, &output_verify))
+    {
+        printf("ERROR - Data Checksum Mismatch\n");
+        return 1;
+    }
+
+    printf("\n");
+    return 0;
+}
+
+int RecordMode(int *array, const cmd_options_t *options)
+{
+    int status = 0;
+    int maxthreads = (TRUE == options->multithread) ? options->maxthreads : 1;
+    char *records = (char *)malloc(options->record * options->size);
+    char *out = (char *)malloc(options->record * options->size);
+    int *keys = (int *)malloc(sizeof(int) * options->size);
+    uint32_t *perm = (uint32_t *)malloc(sizeof(uint32_t) * options->size);
+
+    if (NULL == records || NULL == out || NULL == keys || NULL == perm)
+    {
+        perror("Memory allocation is failure!");
+        exit(EXIT_FAILURE);
+    }
+
+    /* A record is the key, its index in the input and a filler up to the record size */
+    for (size_t idx = 0; idx < options->size; ++idx)
+    {
+        char *record = records + idx * options->record;
+        uint32_t index = (uint32_t)idx;
+
+        memset(record, 0xA5, options->record);
+        memcpy(record, &array[idx], sizeof(int));
+        memcpy(record + sizeof(int), &index, sizeof(uint32_t));
+    }
+
+    start = clock(); /* Get the starting CPU time */
+    gettimeofday(&sorting_start_time, NULL);
+    for (size_t idx = 0; idx < options->size; ++idx)
+    {
+        memcpy(&keys[idx], records + idx * options->record, sizeof(int));
+    }
+    if (0 != Argsort(keys, options->size, perm, options->engine, maxthreads))
+    {
+        exit(EXIT_FAILURE);
+    }
+    GatherRecords(records, out, options->record, perm, options->size, maxthreads);
+    gettimeofday(&sorting_end_time, NULL);
+    end = clock(); /* Get the ending CPU time */
+
+    /* Keys must be in order, each record must be intact and equal keys must keep the input order */
+    for (size_t idx = 0; idx < options->size && 0 == status; ++idx)
+    {
+        int key = 0;
+        uint32_t index = 0;
+
+        memcpy(&key, out + idx * options->record, sizeof(int));
+        memcpy(&index, out + idx * options->record + sizeof(int), sizeof(uint32_t));
+
+        if (index >= options->size || array[index] != key)
+        {
+            printf("ERROR - Record Corrupted\n");
+            status = 1;
+        }
+        else if (0 != idx && (keys[perm[idx - 1]] > key || (keys[perm[idx - 1]] == key && perm[idx - 1] > index)))
+        {
+            printf("ERROR - Data Not Sorted\n");
+            status = 1;
+        }
+    }
+
+    if (0 == status)
+    {
+        printf("\n");
+    }
+
+    free(records);
+    free(out);
+    free(keys);
+    free(perm);
+    return status;
+}
+
+int LsmMode(int *array, const cmd_options_t *options, const verify_t *input_verify)
+{
+    int status = 0;
+    verify_t output_verify;
+    int nworkers = (TRUE == options->multithread) ? options->maxthreads : 1;
+    lsm_t *lsm = CreateLsm(nworkers);
+
+    if (NULL == lsm)
+    {
+        return 1;
+    }
+
+    start = clock(); /* Get the starting CPU time */
+    gettimeofday(&sorting_start_time, NULL);
+    for (size_t left = 0; left < options->size; left += options->batch)
+    {
+        size_t size = (left + options->batch > options->size) ? options->size - left : options->batch;
+
+        if (0 != LsmInsert(lsm, array + left, size))
+        {
+            DestroyLsm(lsm);
+            return 1;
+        }
+    }
+    LsmWaitCompaction(lsm);
+    gettimeofday(&sorting_end_time, NULL);
+    end = clock(); /* Get the ending CPU time */
+
+    for (int level = 0; level < LSM_LEVELS; ++level)
+    {
+        if (0 != lsm->levels[level].nruns)
+        {
+            printf("Level %2d: %lu runs\n", level, lsm->levels[level].nruns);
+        }
     }
 
-    free(indexes);
+    /* The answers of the container are compared with a scan of the input */
+    for (int query = 0; query < LSM_QUERIES && 0 == status; ++query)
+    {
+        int low = array[SplitMix64(2 * query) % options->size];
+        int high = array[SplitMix64(2 * query + 1) % options->size];
+        size_t expected = 0;
+
+        if (low > high)
+        {
+            Swap(&low, &high);
+        }
+
+        for (size_t idx = 0; idx < options->size; ++idx)
+        {
+            expected += (array[idx] >= low && array[idx] <= high);
+        }
+
+        if (LsmCount(lsm, low, high) != expected)
+        {
+            printf("ERROR - Range Query [%d, %d] Mismatch\n", low, high);
+            status = 1;
+        }
+    }
+
+    /* The whole content is the sorted array */
+    LsmRange(lsm, INT_MIN, INT_MAX, array);
+    VerifyArray(array, options->size, options->maxthreads, &output_verify);
+    if (0 != status)
+    {
+        /* Already reported */
+    }
+    else if (!output_verify.sorted) 
+    {
+        printf("ERROR - Data Not Sorted\n");
+        status = 1;
+    }
+    else if (!VerifyEqual(input_verify, &output_verify))
+    {
+        printf("ERROR - Data Checksum Mismatch\n");
+        status = 1;
+    }
+    else
+    {
+        printf("\n");
+    }
+
+    DestroyLsm(lsm);
+    return status;
+}
+
+void Report(const char *format, ...)
+{
+    va_list args;
+
+    /* The stream mode writes the data to stdout, so everything else goes to stderr */
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+}
+
+size_t ReadInts(FILE *file, int *buffer, size_t size, int *is_partial)
+{
+    size_t bytes = 0;
+    size_t total = sizeof(int) * size;
+
+    /* A pipe may return less than asked, so the buffer is filled until it is full or the input ends */
+    while (bytes < total)
+    {
+        size_t count = fread((char *)buffer + bytes, 1, total - bytes, file);
+        if (0 == count)
+        {
+            break;
+        }
+        bytes += count;
+    }
+
+    *is_partial = (0 != bytes % sizeof(int));
+    return bytes / sizeof(int);
+}
+
+void *StreamWorker(void *stream_arg)
+{
+    stream_t *stream = (stream_t *)stream_arg;
+
+    pthread_mutex_lock(&stream->mutex);
+    while (TRUE)
+    {
+        while (NULL == stream->todo && !stream->is_closed)
+        {
+            pthread_cond_wait(&stream->cond, &stream->mutex);
+        }
+
+        if (NULL == stream->todo)
+        {
+            break;
+        }
+
+        stream_run_t *run = stream->todo;
+        stream->todo = run->next;
+        ++stream->sorting;
+        pthread_mutex_unlock(&stream->mutex);
+
+        NaturalMergeSort(run->data, run->size);
+
+        pthread_mutex_lock(&stream->mutex);
+        run->is_sorted = TRUE;
+        --stream->sorting;
+        pthread_cond_broadcast(&stream->cond);
+    }
+    pthread_mutex_unlock(&stream->mutex);
+
+    return NULL;
+}
+
+int SpillRun(stream_t *stream, stream_run_t *run)
+{
+    size_t written = 0;
+    uint8_t *packed = NULL;
+
+    /* Only the reading thread spills, so the end of the file needs no lock */
+    if (NULL == stream->spill)
+    {
+        stream->spill = tmpfile();
+        if (NULL == stream->spill)
+        {
+            perror("Spilling of the run is failure!");
+            return 1;
+        }
+    }
+
+    packed = (uint8_t *)malloc(RUN_BLOCK_MAX * (STREAM_CHUNK / RUN_BLOCK));
+    if (NULL == packed)
+    {
+        perror("Allocation memory is failure!");
+        return 1;
+    }
+
+    /* The sorted run is written in the compressed block format, a chunk at a time */
+    for (size_t left = 0; left < run->size; left += STREAM_CHUNK)
+    {
+        size_t count = (run->size - left < STREAM_CHUNK) ? run->size - left : STREAM_CHUNK;
+        size_t bytes = EncodeRun(run->data + left, count, packed);
+        size_t done = 0;
+
+        while (done < bytes)
+        {
+            ssize_t result = pwrite(fileno(stream->spill), packed + done, bytes - done, stream->spill_size + written + done);
+            if (0 >= result)
+            {
+                perror("Spilling of the run is failure!");
+                free(packed);
+                return 1;
+            }
+            done += result;
+        }
+
+        written += bytes;
+    }
+
+    run->offset = stream->spill_size;
+    run->bytes = written;
+    run->is_spilled = TRUE;
+    stream->spill_size += written;
+
+    free(packed);
+    free(run->data);
+    run->data = NULL;
+    return 0;
+}
+
+int OpenCursor(run_cursor_t *cursor, stream_run_t *run, int fd, size_t capacity)
+{
+    cursor->run = run;
+    cursor->fd = fd;
+    cursor->position = 0;
+
+    if (!run->is_spilled)
+    {
+        cursor->chunk = run->data;
+        cursor->chunk_size = run->size;
+        cursor->remaining = 0;
+    }
+    else
+    {
+        /* The compressed bytes are read in large pieces and decoded one block at a time */
+        cursor->chunk = (int *)malloc(sizeof(int) * RUN_BLOCK);
+        cursor->raw = (uint8_t *)malloc(capacity + RUN_PADDING);
+        cursor->raw_capacity = capacity;
+        cursor->raw_size = 0;
+        cursor->raw_position = 0;
+        cursor->chunk_size = 0;
+        cursor->offset = run->offset;
+        cursor->remaining = run->bytes;
+        if (NULL == cursor->chunk || NULL == cursor->raw)
+        {
+            perror("Allocation memory is failure!");
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int CursorNext(run_cursor_t *cursor)
+{
+    if (cursor->position == cursor->chunk_size)
+    {
+        size_t available = cursor->raw_size - cursor->raw_position;
+
+        if (!cursor->run->is_spilled)
+        {
+            return FALSE;
+        }
+
+        /* The buffer is refilled whenever it may not hold a whole block */
+        if (available < RUN_BLOCK_MAX && 0 != cursor->remaining)
+        {
+            size_t count = cursor->raw_capacity - available;
+            size_t bytes = 0;
+
+            memmove(cursor->raw, cursor->raw + cursor->raw_position, available);
+            if (count > cursor->remaining)
+            {
+                count = cursor->remaining;
+            }
+
+            while (bytes < count)
+            {
+                ssize_t result = pread(cursor->fd, cursor->raw + available + bytes, count - bytes, cursor->offset + bytes);
+                if (0 >= result)
+                {
+                    return FALSE;
+                }
+                bytes += result;
+            }
+
+            cursor->offset += bytes;
+            cursor->remaining -= bytes;
+            cursor->raw_size = available + bytes;
+            cursor->raw_position = 0;
+            available = cursor->raw_size;
+        }
+
+        size_t used = DecodeBlock(cursor->raw + cursor->raw_position, available, cursor->chunk, &cursor->chunk_size);
+        if (0 == used)
+        {
+            return FALSE;
+        }
+
+        cursor->raw_position += used;
+        cursor->position = 0;
+    }
+
+    cursor->value = cursor->chunk[cursor->position++];
+    return TRUE;
+}
+
+void SiftDown(run_cursor_t **heap, size_t size, size_t idx)
+{
+    while (TRUE)
+    {
+        size_t smallest = idx;
+        size_t left = 2 * idx + 1;
+        size_t right = left + 1;
+
+        if (left < size && heap[left]->value < heap[smallest]->value)
+        {
+            smallest = left;
+        }
+        if (right < size && heap[right]->value < heap[smallest]->value)
+        {
+            smallest = right;
+        }
+        if (smallest == idx)
+        {
+            return;
+        }
+
+        run_cursor_t *temp = heap[idx];
+        heap[idx] = heap[smallest];
+        heap[smallest] = temp;
+        idx = smallest;
+    }
+}
+
+int MergeRunsToFile(stream_t *stream, FILE *out, int is_compressed, verify_t *verify)
+{
+    int status = 0;
+    size_t nheap = 0;
+    size_t nout = 0;
+    run_cursor_t *cursors = (run_cursor_t *)calloc(stream->nruns, sizeof(run_cursor_t));
+    run_cursor_t **heap = (run_cursor_t **)calloc(stream->nruns, sizeof(run_cursor_t *));
+    int *output = (int *)malloc(sizeof(int) * STREAM_CHUNK);
+    uint8_t *packed = (uint8_t *)malloc(RUN_BLOCK_MAX * (STREAM_CHUNK / RUN_BLOCK));
+    int fd = (NULL == stream->spill) ? -1 : fileno(stream->spill);
+    /* The buffers of the spilled runs share the cap with the runs left in memory */
+    size_t capacity = (stream->cap - stream->memory) / (stream->nspilled + 1);
+
+    if (NULL == cursors || NULL == heap || NULL == output || NULL == packed)
+    {
+        perror("Allocation memory is failure!");
+        free(cursors);
+        free(heap);
+        free(output);
+        free(packed);
+        return 1;
+    }
+
+    VerifyInit(verify);
+
+    if (stream->memory > stream->cap || capacity < sizeof(int) * STREAM_MIN_CHUNK)
+    {
+        capacity = sizeof(int) * STREAM_MIN_CHUNK;
+    }
+    else if (capacity > sizeof(int) * STREAM_CHUNK)
+    {
+        capacity = sizeof(int) * STREAM_CHUNK;
+    }
+
+    /* Runs are merged with a heap of cursors, a spilled run is read back chunk by chunk */
+    size_t run_idx = 0;
+    for (stream_run_t *run = stream->head; NULL != run; run = run->next, ++run_idx)
+    {
+        if (0 != OpenCursor(&cursors[run_idx], run, fd, capacity))
+        {
+            status = 1;
+            break;
+        }
+
+        if (CursorNext(&cursors[run_idx]))
+        {
+            heap[nheap++] = &cursors[run_idx];
+        }
+    }
+
+    for (size_t idx = nheap; idx-- > 0; )
+    {
+        SiftDown(heap, nheap, idx);
+    }
+
+    while (0 == status && 0 != nheap)
+    {
+        output[nout++] = heap[0]->value;
+        VerifyAppend(verify, heap[0]->value);
+
+        if (STREAM_CHUNK == nout)
+        {
+            if (TRUE == is_compressed)
+            {
+                size_t bytes = EncodeRun(output, nout, packed);
+                status = (bytes != fwrite(packed, 1, bytes, out));
+            }
+            else
+            {
+                status = (nout != fwrite(output, sizeof(int), nout, out));
+            }
+            nout = 0;
+        }
+
+        if (!CursorNext(heap[0]))
+        {
+            heap[0] = heap[--nheap];
+        }
+        SiftDown(heap, nheap, 0);
+    }
+
+    if (0 == status && 0 != nout)
+    {
+        if (TRUE == is_compressed)
+        {
+            size_t bytes = EncodeRun(output, nout, packed);
+            status = (bytes != fwrite(packed, 1, bytes, out));
+        }
+        else
+        {
+            status = (nout != fwrite(output, sizeof(int), nout, out));
+        }
+    }
+
+    if (0 != status || 0 != fflush(out))
+    {
+        perror("Writing of the output is failure!");
+        status = 1;
+    }
+
+    for (size_t idx = 0; idx < stream->nruns; ++idx)
+    {
+        if (NULL != cursors[idx].run && cursors[idx].run->is_spilled)
+        {
+            free(cursors[idx].chunk);
+            free(cursors[idx].raw);
+        }
+    }
+    free(cursors);
+    free(heap);
+    free(output);
+    free(packed);
+    return status;
+}
+
+int StreamMode(const cmd_options_t *options)
+{
+    int status = 0;
+    int is_partial = FALSE;
+    size_t buffer_bytes = sizeof(int) * options->size;
+    stream_t stream = {0};
+    verify_t input_verify;
+    verify_t output_verify;
+    struct timeval start_time;
+
+    stream.cap = options->cap << 20;
+    stream.nworkers = (TRUE == options->multithread) ? options->maxthreads : 1;
+    stream.workers = (pthread_t *)calloc(stream.nworkers, sizeof(pthread_t));
+    if (NULL == stream.workers)
+    {
+        perror("Allocation memory is failure!");
+        return 1;
+    }
+
+    pthread_mutex_init(&stream.mutex, NULL);
+    pthread_cond_init(&stream.cond, NULL);
+    for (int worker = 0; worker < stream.nworkers; ++worker)
+    {
+        if (0 != pthread_create(&stream.workers[worker], NULL, StreamWorker, &stream))
+        {
+            perror("Creation of the thread is failure!");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    gettimeofday(&start_time, NULL);
+    start = clock(); /* Get the starting CPU time */
+    gettimeofday(&sorting_start_time, NULL);
+    load_start_time = sorting_start_time;
+    VerifyInit(&input_verify);
+
+    while (0 == status && !is_partial && !feof(stdin))
+    {
+        pthread_mutex_lock(&stream.mutex);
+
+        /* The oldest sorted runs are spilled until there is room for one more buffer */
+        while (0 != stream.memory && stream.memory + buffer_bytes > stream.cap)
+        {
+            while (NULL != stream.unspilled && stream.unspilled->is_spilled)
+            {
+                stream.unspilled = stream.unspilled->next;
+            }
+
+            stream_run_t *victim = stream.unspilled;
+            while (NULL != victim && (victim->is_spilled || !victim->is_sorted))
+            {
+                victim = victim->next;
+            }
+
+            if (NULL == victim)
+            {
+                pthread_cond_wait(&stream.cond, &stream.mutex);
+                continue;
+            }
+
+            /* A sorted run is not touched by the workers any more, so it is written without the lock */
+            pthread_mutex_unlock(&stream.mutex);
+            status = SpillRun(&stream, victim);
+            pthread_mutex_lock(&stream.mutex);
+            if (0 != status)
+            {
+                break;
+            }
+
+            stream.memory -= sizeof(int) * victim->size;
+            ++stream.nspilled;
+        }
+        pthread_mutex_unlock(&stream.mutex);
+        if (0 != status)
+        {
+            break;
+        }
+
+        stream_run_t *run = (stream_run_t *)calloc(1, sizeof(stream_run_t));
+        int *data = (int *)malloc(buffer_bytes);
+        if (NULL == run || NULL == data)
+        {
+            perror("Allocation memory is failure!");
+            free(run);
+            free(data);
+            status = 1;
+            break;
+        }
+
+        run->data = data;
+        if (TRUE == options->compressed)
+        {
+            run->size = ReadBlocks(stdin, data, options->size, &is_partial);
+        }
+        else
+        {
+            run->size = ReadInts(stdin, data, options->size, &is_partial);
+        }
+        if (0 == run->size)
+        {
+            free(run);
+            free(data);
+            break;
+        }
+
+        verify_t block;
+        VerifyBlock(data, run->size, &block);
+        block.sorted = TRUE;
+        VerifyCombine(&input_verify, &block);
+
+        /* The full buffer is handed to the workers and the reading goes on with a new one */
+        pthread_mutex_lock(&stream.mutex);
+        if (NULL == stream.head)
+        {
+            stream.head = run;
+        }
+        else
+        {
+            stream.tail->next = run;
+        }
+        stream.tail = run;
+        if (NULL == stream.todo)
+        {
+            stream.todo = run;
+        }
+        if (NULL == stream.unspilled)
+        {
+            stream.unspilled = run;
+        }
+        ++stream.nruns;
+        stream.memory += buffer_bytes;
+        pthread_cond_broadcast(&stream.cond);
+        pthread_mutex_unlock(&stream.mutex);
+    }
+
+    if (TRUE == is_partial)
+    {
+        Report("Invalid input: the stream is truncated or corrupted\n");
+        status = 1;
+    }
+
+    pthread_mutex_lock(&stream.mutex);
+    stream.is_closed = TRUE;
+    pthread_cond_broadcast(&stream.cond);
+    pthread_mutex_unlock(&stream.mutex);
+
+    for (int worker = 0; worker < stream.nworkers; ++worker)
+    {
+        pthread_join(stream.workers[worker], NULL);
+    }
+    gettimeofday(&load_end_time, NULL);
+
+    if (0 == status)
+    {
+        status = MergeRunsToFile(&stream, stdout, options->compress, &output_verify);
+    }
+    gettimeofday(&sorting_end_time, NULL);
+    end = clock(); /* Get the ending CPU time */
+
+    if (0 != status)
+    {
+        /* Already reported */
+    }
+    else if (!output_verify.sorted) 
+    {
+        Report("ERROR - Data Not Sorted\n");
+        status = 1;
+    }
+    else if (!VerifyEqual(&input_verify, &output_verify))
+    {
+        Report("ERROR - Data Checksum Mismatch\n");
+        status = 1;
+    }
+
+    Report("Values: %lu Runs: %lu Spilled: %lu (%lu bytes)\n", input_verify.count, stream.nruns, stream.nspilled, (unsigned long)stream.spill_size);
+    Report("Read and sort runs: %.3f ", ((load_end_time.tv_sec - load_start_time.tv_sec) * 1e6 + (load_end_time.tv_usec - load_start_time.tv_usec)) / 1e6);
+    Report("Total (Wall/CPU): %.3f / %.3f\n", ((sorting_end_time.tv_sec - start_time.tv_sec) * 1e6 + (sorting_end_time.tv_usec - start_time.tv_usec)) / 1e6,
+            ((double) (end - start)) / CLOCKS_PER_SEC);
+
+    while (NULL != stream.head)
+    {
+        stream_run_t *next = stream.head->next;
+
+        free(stream.head->data);
+        free(stream.head);
+        stream.head = next;
+    }
+
+    if (NULL != stream.spill)
+    {
+        fclose(stream.spill);
+    }
+
+    pthread_mutex_destroy(&stream.mutex);
+    pthread_cond_destroy(&stream.cond);
+    free(stream.workers);
+    return status;
+}
+
+void PrefixSum(uint32_t *deltas, size_t count, uint32_t base)
+{
+    size_t idx = 0;
+
+#ifdef __SSE2__
+    /* Four running sums at once: two shifted adds make the prefix sum of a vector, the carry is its last lane */
+    __m128i carry = _mm_set1_epi32((int)base);
+
+    for ( ; idx + 4 <= count; idx += 4)
+    {
+        __m128i vector = _mm_loadu_si128((const __m128i *)(deltas + idx));
+
+        vector = _mm_add_epi32(vector, _mm_slli_si128(vector, 4));
+        vector = _mm_add_epi32(vector, _mm_slli_si128(vector, 8));
+        vector = _mm_add_epi32(vector, carry);
+        _mm_storeu_si128((__m128i *)(deltas + idx), vector);
+        carry = _mm_shuffle_epi32(vector, 0xFF);
+    }
+
+    base = (uint32_t)_mm_cvtsi128_si32(carry);
+#endif
+
+    for ( ; idx < count; ++idx)
+    {
+        base += deltas[idx];
+        deltas[idx] = base;
+    }
+}
+
+size_t EncodeBlock(const int *values, size_t count, uint8_t *out)
+{
+    uint32_t max_delta = 0;
+    uint8_t bits = 0;
+    uint64_t buffer = 0;
+    int filled = 0;
+    size_t bytes = RUN_HEADER;
+    uint32_t header[RUN_HEADER / sizeof(uint32_t)];
+
+    /* The values are sorted, so the deltas are non-negative and fit the frame of the widest one */
+    for (size_t idx = 1; idx < count; ++idx)
+    {
+        uint32_t delta = (uint32_t)values[idx] - (uint32_t)values[idx - 1];
+        max_delta |= delta;
+    }
+
+    while (bits < 32 && 0 != (max_delta >> bits))
+    {
+        ++bits;
+    }
+
+    header[0] = (uint32_t)count;
+    header[1] = bits;
+    header[2] = (uint32_t)values[0];
+    header[3] = (uint32_t)values[count - 1];
+    memcpy(out, header, RUN_HEADER);
+
+    /* The deltas are packed as a little-endian bit stream */
+    for (size_t idx = 1; idx < count; ++idx)
+    {
+        buffer |= (uint64_t)((uint32_t)values[idx] - (uint32_t)values[idx - 1]) << filled;
+        filled += bits;
+        while (filled >= 8)
+        {
+            out[bytes++] = (uint8_t)buffer;
+            buffer >>= 8;
+            filled -= 8;
+        }
+    }
+
+    if (0 != filled)
+    {
+        out[bytes++] = (uint8_t)buffer;
+    }
+
+    return bytes;
+}
+
+size_t DecodeBlock(const uint8_t *in, size_t available, int *values, size_t *count)
+{
+    uint32_t header[RUN_HEADER / sizeof(uint32_t)];
+    uint32_t deltas[RUN_BLOCK];
+    size_t bytes = 0;
+
+    if (available < RUN_HEADER)
+    {
+        return 0;
+    }
+
+    memcpy(header, in, RUN_HEADER);
+    if (0 == header[0] || RUN_BLOCK < header[0] || 32 < header[1])
+    {
+        return 0;
+    }
+
+    bytes = RUN_HEADER + ((header[0] - 1) * header[1] + 7) / 8;
+    if (available < bytes)
+    {
+        return 0;
+    }
+
+    /* Every delta is read with one unaligned load, the buffers are padded for the last ones */
+    uint64_t mask = (32 == header[1]) ? 0xFFFFFFFFULL : ((1ULL << header[1]) - 1);
+    for (size_t idx = 0; idx + 1 < header[0]; ++idx)
+    {
+        size_t bit = idx * header[1];
+        uint64_t word = 0;
+
+        memcpy(&word, in + RUN_HEADER + bit / 8, sizeof(uint64_t));
+        deltas[idx] = (uint32_t)((word >> (bit % 8)) & mask);
+    }
+
+    PrefixSum(deltas, header[0] - 1, header[2]);
+
+    values[0] = (int)header[2];
+    memcpy(values + 1, deltas, sizeof(uint32_t) * (header[0] - 1));
+    *count = header[0];
+
+    return bytes;
+}
+
+size_t EncodeRun(const int *values, size_t count, uint8_t *out)
+{
+    size_t bytes = 0;
+
+    for (size_t left = 0; left < count; left += RUN_BLOCK)
+    {
+        size_t block = (count - left < RUN_BLOCK) ? count - left : RUN_BLOCK;
+        bytes += EncodeBlock(values + left, block, out + bytes);
+    }
+
+    return bytes;
+}
+
+size_t ReadBlocks(FILE *file, int *buffer, size_t size, int *is_partial)
+{
+    size_t filled = 0;
+    uint8_t raw[RUN_BLOCK_MAX + RUN_PADDING];
+
+    *is_partial = FALSE;
+
+    /* Whole blocks are read while one more surely fits into the buffer */
+    while (filled + RUN_BLOCK <= size)
+    {
+        uint32_t header[RUN_HEADER / sizeof(uint32_t)];
+        size_t count = 0;
+        size_t read_count = fread(raw, 1, RUN_HEADER, file);
+
+        if (0 == read_count)
+        {
+            break;
+        }
+
+        memcpy(header, raw, RUN_HEADER);
+        if (RUN_HEADER != read_count || 0 == header[0] || RUN_BLOCK < header[0] || 32 < header[1])
+        {
+            *is_partial = TRUE;
+            break;
+        }
+
+        size_t payload = ((header[0] - 1) * header[1] + 7) / 8;
+        if (payload != fread(raw + RUN_HEADER, 1, payload, file) ||
+                0 == DecodeBlock(raw, RUN_HEADER + payload, buffer + filled, &count))
+        {
+            *is_partial = TRUE;
+            break;
+        }
+
+        filled += count;
+    }
+
+    return filled;
+}
+
+void CreatePool(pool_t *pool, size_t object)
+{
+    /* The objects are kept aligned like malloc does, a free one stores the link of the list */
+    pool->object = (object + POOL_ALIGN - 1) / POOL_ALIGN * POOL_ALIGN;
+    pool->depot = NULL;
+    pool->ndepot = 0;
+    pool->slabs = NULL;
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_key_create(&pool->key, PoolCacheDestroy);
+}
+
+void DestroyPool(pool_t *pool)
+{
+    pool_cache_t *cache = (pool_cache_t *)pthread_getspecific(pool->key);
+
+    /* The caches of the joined threads went back to the depot, only the calling thread still has one */
+    free(cache);
+    pthread_key_delete(pool->key);
+
+    while (NULL != pool->slabs)
+    {
+        void *next = *(void **)pool->slabs;
+        free(pool->slabs);
+        pool->slabs = next;
+    }
+
+    pthread_mutex_destroy(&pool->mutex);
+}
+
+pool_cache_t *PoolCache(pool_t *pool)
+{
+    pool_cache_t *cache = (pool_cache_t *)pthread_getspecific(pool->key);
+
+    if (NULL == cache)
+    {
+        cache = (pool_cache_t *)calloc(1, sizeof(pool_cache_t));
+        if (NULL == cache)
+        {
+            return NULL;
+        }
+        cache->pool = pool;
+        pthread_setspecific(pool->key, cache);
+    }
+
+    return cache;
+}
+
+void *PoolAlloc(pool_t *pool)
+{
+    pool_cache_t *cache = PoolCache(pool);
+    pool_object_t *object = NULL;
+
+    if (NULL == cache)
+    {
+        return NULL;
+    }
+
+    /* The shared part of the pool is visited once per batch, the rest needs no synchronization */
+    if (NULL == cache->head && 0 != PoolRefill(pool, cache))
+    {
+        return NULL;
+    }
+
+    object = cache->head;
+    cache->head = object->next;
+    --cache->count;
+    return object;
+}
+
+void PoolFree(pool_t *pool, void *pointer)
+{
+    pool_cache_t *cache = PoolCache(pool);
+    pool_object_t *object = (pool_object_t *)pointer;
+
+    if (NULL == object)
+    {
+        return;
+    }
+
+    /* Without its cache the thread hands the object to the depot directly */
+    if (NULL == cache)
+    {
+        pthread_mutex_lock(&pool->mutex);
+        object->next = pool->depot;
+        pool->depot = object;
+        ++pool->ndepot;
+        pthread_mutex_unlock(&pool->mutex);
+        return;
+    }
+
+    object->next = cache->head;
+    cache->head = object;
+    ++cache->count;
+
+    /* A thread that frees what others allocate returns the surplus, so it does not hoard the objects */
+    if (2 * POOL_BATCH <= cache->count)
+    {
+        PoolFlush(pool, cache, POOL_BATCH);
+    }
+}
+
+int PoolRefill(pool_t *pool, pool_cache_t *cache)
+{
+    pthread_mutex_lock(&pool->mutex);
+
+    /* The depot is drained first, a new slab is carved only if it is empty */
+    while (NULL != pool->depot && cache->count < POOL_BATCH)
+    {
+        pool_object_t *object = pool->depot;
+        pool->depot = object->next;
+        --pool->ndepot;
+        object->next = cache->head;
+        cache->head = object;
+        ++cache->count;
+    }
+
+    if (0 == cache->count)
+    {
+        char *slab = (char *)malloc(POOL_ALIGN + pool->object * POOL_SLAB);
+        if (NULL == slab)
+        {
+            pthread_mutex_unlock(&pool->mutex);
+            perror("Allocation memory is failure!");
+            return 1;
+        }
+
+        *(void **)slab = pool->slabs;
+        pool->slabs = slab;
+
+        for (size_t idx = POOL_SLAB; 0 < idx; --idx)
+        {
+            pool_object_t *object = (pool_object_t *)(slab + POOL_ALIGN + pool->object * (idx - 1));
+            object->next = cache->head;
+            cache->head = object;
+        }
+        cache->count = POOL_SLAB;
+    }
+
+    pthread_mutex_unlock(&pool->mutex);
+    return 0;
+}
+
+void PoolFlush(pool_t *pool, pool_cache_t *cache, size_t count)
+{
+    pool_object_t *first = cache->head;
+    pool_object_t *last = first;
+    size_t moved = 1;
+
+    if (NULL == first || 0 == count)
+    {
+        return;
+    }
+
+    /* The batch is cut off the cache first, so the lock covers only the splice */
+    while (moved < count && NULL != last->next)
+    {
+        last = last->next;
+        ++moved;
+    }
+
+    cache->head = last->next;
+    cache->count -= moved;
+
+    pthread_mutex_lock(&pool->mutex);
+    last->next = pool->depot;
+    pool->depot = first;
+    pool->ndepot += moved;
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+void PoolCacheDestroy(void *pool_cache)
+{
+    pool_cache_t *cache = (pool_cache_t *)pool_cache;
+
+    PoolFlush(cache->pool, cache, cache->count);
+    free(cache);
+}
+
+void ScratchInit(void)
+{
+    pthread_key_create(&scratch_key, ScratchCacheDestroy);
+    atexit(ScratchExit);
+}
+
+void *ScratchAcquire(size_t bytes)
+{
+    scratch_cache_t *cache = NULL;
+    scratch_header_t *header = NULL;
+    int best = -1;
+
+    pthread_once(&scratch_once, ScratchInit);
+    cache = (scratch_cache_t *)pthread_getspecific(scratch_key);
+
+    /* The smallest cached buffer that is large enough is reused, its pages are already mapped */
+    for (int slot = 0; NULL != cache && slot < SCRATCH_SLOTS; ++slot)
+    {
+        scratch_header_t *candidate = cache->buffers[slot];
+        if (NULL != candidate && candidate->capacity >= bytes && 
+                (-1 == best || candidate->capacity < cache->buffers[best]->capacity))
+        {
+            best = slot;
+        }
+    }
+
+    if (-1 != best)
+    {
+        header = cache->buffers[best];
+        cache->buffers[best] = NULL;
+        return header + 1;
+    }
+
+    header = (scratch_header_t *)malloc(sizeof(scratch_header_t) + bytes);
+    if (NULL == header)
+    {
+        return NULL;
+    }
+
+    header->capacity = bytes;
+    return header + 1;
+}
+
+void ScratchRelease(void *buffer)
+{
+    scratch_cache_t *cache = NULL;
+    scratch_header_t *header = NULL;
+    int smallest = 0;
+
+    if (NULL == buffer)
+    {
+        return;
+    }
+
+    pthread_once(&scratch_once, ScratchInit);
+    header = (scratch_header_t *)buffer - 1;
+    cache = (scratch_cache_t *)pthread_getspecific(scratch_key);
+
+    if (NULL == cache)
+    {
+        cache = (scratch_cache_t *)calloc(1, sizeof(scratch_cache_t));
+        if (NULL == cache)
+        {
+            free(header);
+            return;
+        }
+        pthread_setspecific(scratch_key, cache);
+    }
+
+    /* A full cache keeps the larger buffers */
+    for (int slot = 0; slot < SCRATCH_SLOTS; ++slot)
+    {
+        if (NULL == cache->buffers[slot])
+        {
+            cache->buffers[slot] = header;
+            return;
+        }
+
+        if (cache->buffers[slot]->capacity < cache->buffers[smallest]->capacity)
+        {
+            smallest = slot;
+        }
+    }
+
+    if (cache->buffers[smallest]->capacity < header->capacity)
+    {
+        free(cache->buffers[smallest]);
+        cache->buffers[smallest] = header;
+    }
+    else
+    {
+        free(header);
+    }
+}
+
+void ScratchCacheDestroy(void *scratch_cache)
+{
+    scratch_cache_t *cache = (scratch_cache_t *)scratch_cache;
+
+    for (int slot = 0; slot < SCRATCH_SLOTS; ++slot)
+    {
+        free(cache->buffers[slot]);
+    }
+    free(cache);
+}
+
+void ScratchExit(void)
+{
+    scratch_cache_t *cache = (scratch_cache_t *)pthread_getspecific(scratch_key);
+
+    /* The destructor of the key does not run for the main thread */
+    if (NULL != cache)
+    {
+        pthread_setspecific(scratch_key, NULL);
+        ScratchCacheDestroy(cache);
+    }
+}
+
+int LoadSlice(int *slice, size_t first, size_t size, void *summary, const void *sort_options)
+{
+    const cmd_options_t *options = (const cmd_options_t *)sort_options;
+
+    if ('\0' != options->distribution)
+    {
+        for (size_t idx = 0; idx < size; ++idx)
+        {
+            slice[idx] = GenerateValue(options->seed, first + idx, options->size, options->distribution);
+        }
+    }
+    else
+    {
+        LoadArray(slice, size, options->seed + first);
+    }
+
+    VerifyBlock(slice, size, (verify_t *)summary);
+    return 0;
+}
+
+void CombineVerify(void *total, const void *summary)
+{
+    VerifyCombine((verify_t *)total, (const verify_t *)summary);
+}
+
+void SortBucket(int *array, size_t size, const void *sort_options)
+{
+    cmd_options_t local = *(const cmd_options_t *)sort_options;
+    verify_t verify;
+
+    if (2 > size)
+    {
+        return;
+    }
+
+    local.size = size;
+
+    /* The bucket of the worker is sorted by the same engine as the whole array would be */
+    if (TRUE == local.multithread && size >= local.pieces * (size_t)local.threshold)
+    {
+        Multithreaded(array, &local);
+        for (size_t thread = 0; thread < (size_t)local.maxthreads; ++thread) 
+        {
+            pthread_join(threads[thread], NULL);
+        }
+        MergeSortedSegments(array, segments, local.pieces, &verify);
+        ScratchRelease(threads);
+        ScratchRelease(segments);
+    }
+    else
+    {
+        Quicksort(array, 0, size - 1, local.threshold, local.median);
+    }
+}
+
+int DistributedMode(cmd_options_t *options)
+{
+    cmd_options_t local = *options;
+    distributed_t distributed;
+    distributed_ops_t ops = {LoadSlice, CombineVerify, SortBucket, sizeof(verify_t), &local};
+    int status = 0;
+    verify_t input_verify;
+    verify_t output_verify;
+    struct rusage usage;
+
+    /* The seed is chosen once, so that the slices of the workers make up one array */
+    if (local.seed < 0)
+    {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        srand(tv.tv_usec);
+        local.seed = rand() % 1000000000;
+    }
+
+    VerifyInit(&input_verify);
+    gettimeofday(&load_start_time, NULL);
+    status = StartDistributed(&distributed, local.size, local.processes, &ops, &input_verify);
+
+    gettimeofday(&load_end_time, NULL);
+    start = clock(); /* Get the starting CPU time */
+    gettimeofday(&sorting_start_time, NULL);
+
+    status |= FinishDistributed(&distributed);
+
+    gettimeofday(&sorting_end_time, NULL);
+    end = clock(); /* Get the ending CPU time */
+
+    if (0 != status)
+    {
+        printf("ERROR - Worker Process Failure\n");
+        DestroyDistributed(&distributed);
+        return 1;
+    }
+
+    for (int rank = 0; rank < local.processes; ++rank)
+    {
+        size_t bucket = DistributedBucket(&distributed, rank);
+
+        printf("Worker %d: %lu elements (%.2f%%)\n", rank, bucket, (bucket / (float)local.size) * 100);
+    }
+
+    VerifyArray(distributed.array, local.size, local.maxthreads, &output_verify);
+    if (!output_verify.sorted) 
+    {
+        printf("ERROR - Data Not Sorted\n");
+        status = 1;
+    }
+    else if (!VerifyEqual(&input_verify, &output_verify))
+    {
+        printf("ERROR - Data Checksum Mismatch\n");
+        status = 1;
+    }
+
+    getrusage(RUSAGE_CHILDREN, &usage);
+    printf("Workers CPU: %.3f\n", usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6);
+
+    DestroyDistributed(&distributed);
+    return status;
+}
+
+int DaemonMode(const cmd_options_t *options)
+{
+    int maxthreads = (TRUE == options->multithread) ? options->maxthreads : 1;
+
+    return ServeSorts(options->serve, maxthreads, options->cap << 20);
+}
+
+int ClientMode(const cmd_options_t *options)
+{
+    verify_t input_verify;
+    verify_t output_verify;
+    int status = DAEMON_INVALID;
+    int fd = -1;
+
+    /* The array is loaded straight into the buffer the daemon sorts */
+    int *array = CreateSortBuffer(options->size, &fd);
+    if (NULL == array)
+    {
+        return 1;
+    }
+
+    if ('\0' != options->distribution)
+    {
+        GenerateArray(array, options->size, options->seed, options->distribution, options->maxthreads, options->write);
+    }
+    else
+    {
+        LoadArray(array, options->size, options->seed);
+    }
+    VerifyArray(array, options->size, options->maxthreads, &input_verify);
+
+    start = clock(); /* Get the starting CPU time */
+    gettimeofday(&sorting_start_time, NULL);
+    status = RequestSort(options->client, fd, options->size);
+    gettimeofday(&sorting_end_time, NULL);
+    end = clock(); /* Get the ending CPU time */
+
+    close(fd);
+
+    if (DAEMON_OK != status)
+    {
+        printf("ERROR - Request %s\n", (DAEMON_BUSY == status) ? "Rejected, Daemon Busy" : 
+                (DAEMON_TOO_LARGE == status) ? "Rejected, Larger Than The Cap" : "Failed");
+        munmap(array, options->size * sizeof(int));
+        return 1;
+    }
+
+    VerifyArray(array, options->size, options->maxthreads, &output_verify);
+    munmap(array, options->size * sizeof(int));
+
+    if (!output_verify.sorted) 
+    {
+        printf("ERROR - Data Not Sorted\n");
+        return 1;
+    }
+    else if (!VerifyEqual(&input_verify, &output_verify))
+    {
+        printf("ERROR - Data Checksum Mismatch\n");
+        return 1;
+    }
+
+    printf("\n");
+    return 0;
+}
+
+int LookupMode(const int *array, const cmd_options_t *options)
+{
+    indexed_file_t indexed;
+    size_t found = 0;
+    size_t matches = 0;
+    size_t errors = 0;
+
+    if (0 != OpenIndexed(options->lookup, &indexed))
+    {
+        return 1;
+    }
+
+    /* Every value of the array is looked up as a point range */
+    start = clock(); /* Get the starting CPU time */
+    gettimeofday(&sorting_start_time, NULL);
+    for (size_t idx = 0; idx < options->size; ++idx)
+    {
+        size_t first = 0;
+        size_t count = IndexedRange(&indexed, array[idx], array[idx], &first);
+
+        found += (0 != count);
+        matches += count;
+    }
+    gettimeofday(&sorting_end_time, NULL);
+    end = clock(); /* Get the ending CPU time */
+
+    /* A few of the lookups are checked against a plain binary search of the whole data */
+    for (size_t idx = 0; idx < options->size && idx < LOOKUP_CHECK; ++idx)
+    {
+        size_t first = 0;
+        size_t count = IndexedRange(&indexed, array[idx], array[idx], &first);
+        size_t low = LowerBound(indexed.data, indexed.count, array[idx]);
+        size_t high = (INT_MAX == array[idx]) ? indexed.count : LowerBound(indexed.data, indexed.count, array[idx] + 1);
+
+        errors += (first != low || count != high - low);
+    }
+
+    printf("Lookups: %lu in %lu values of %lu blocks (found: %lu, matches: %lu)\n", 
+            options->size, indexed.count, indexed.nblocks, found, matches);
+    CloseIndexed(&indexed);
+
+    if (0 != errors)
+    {
+        printf("ERROR - %lu Lookups Mismatch\n", errors);
+        return 1;
+    }
+
+    printf("\n");
+    return 0;
+}
+
+double TimeTrial(const int *source, int *array, const cmd_options_t *options)
+{
+    double fastest = -1.0;
+    int maxthreads = (TRUE == options->multithread) ? options->maxthreads : 1;
+
+    for (int repeat = 0; repeat < TUNE_REPEATS; ++repeat)
+    {
+        struct timeval trial_start;
+        struct timeval trial_end;
+
+        memcpy(array, source, sizeof(int) * options->size);
+        gettimeofday(&trial_start, NULL);
+        if ('A' == options->alternate)
+        {
+            Sort(array, options->size, maxthreads, NULL);
+        }
+        else
+        {
+            SortBucket(array, options->size, options);
+        }
+        gettimeofday(&trial_end, NULL);
+
+        double elapsed = (trial_end.tv_sec - trial_start.tv_sec) + (trial_end.tv_usec - trial_start.tv_usec) / 1e6;
+        fastest = (0 > fastest || elapsed < fastest) ? elapsed : fastest;
+    }
+
+    /* A candidate that does not sort is never chosen */
+    return IsSorted(array, options->size) ? fastest : -1.0;
+}
+
+int TuneMode(const cmd_options_t *options)
+{
+    static const int thresholds[] = {4, 8, 12, 16, 24, 32, 48, 64};
+    static const size_t grains[] = {1, 2, 4, 8, 16};
+    cmd_options_t best = *options;
+    cmd_options_t parallel;
+    cmd_options_t trial;
+    double best_time = -1.0;
+    double parallel_time = -1.0;
+    double library_time = -1.0;
+    double time = 0.0;
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int *source = (int *)malloc(sizeof(int) * options->size);
+    int *array = (int *)malloc(sizeof(int) * options->size);
+    int saved = -1;
+    int null = open("/dev/null", O_WRONLY);
+
+    if (NULL == source || NULL == array)
+    {
+        perror("Allocation memory is failure!");
+        exit(EXIT_FAILURE);
+    }
+
+    cores = (1 > cores) ? 1 : cores;
+    GenerateArray(source, options->size, options->seed, ('\0' != options->distribution) ? options->distribution : 'U', 
+            (int)cores, FALSE);
+
+    /* The quicksort engine prints its partitions, only the results of the trials are reported */
+    fflush(stdout);
+    if (-1 != null)
+    {
+        saved = dup(STDOUT_FILENO);
+        dup2(null, STDOUT_FILENO);
+    }
+
+    /* The leaf size of the insertion sort and the pivot do not depend on the threads, they are tuned in one */
+    best.alternate = 'S';
+    best.multithread = FALSE;
+    for (int median = FALSE; median <= TRUE; ++median)
+    {
+        for (size_t idx = 0; idx < sizeof(thresholds) / sizeof(thresholds[0]) && (size_t)thresholds[idx] < options->size; ++idx)
+        {
+            trial = best;
+            trial.threshold = thresholds[idx];
+            trial.median = median;
+            time = TimeTrial(source, array, &trial);
+            Report("Threshold %2d, median %c: %.4f s\n", trial.threshold, (TRUE == median) ? 'Y' : 'N', time);
+
+            if (0 <= time && (0 > best_time || time < best_time))
+            {
+                best = trial;
+                best_time = time;
+            }
+        }
+    }
+
+    /* Then the threads with the pieces each of them gets on average */
+    parallel = best;
+    for (int nthreads = 1; nthreads <= 2 * cores && nthreads <= TUNE_MAX_THREADS; nthreads *= 2)
+    {
+        for (size_t idx = 0; idx < sizeof(grains) / sizeof(grains[0]); ++idx)
+        {
+            trial = best;
+            trial.multithread = TRUE;
+            trial.maxthreads = nthreads;
+            trial.pieces = nthreads * grains[idx];
+            if (trial.pieces * (size_t)trial.threshold > options->size)
+            {
+                continue;
+            }
+
+            time = TimeTrial(source, array, &trial);
+            Report("Threads %2d, pieces %3lu: %.4f s\n", trial.maxthreads, trial.pieces, time);
+
+            if (0 <= time && (0 > parallel_time || time < parallel_time))
+            {
+                parallel = trial;
+                parallel_time = time;
+            }
+        }
+    }
+
+    if (0 <= parallel_time && parallel_time < best_time)
+    {
+        best = parallel;
+        best_time = parallel_time;
+    }
+
+    /* Last the quicksort engine against the kernels of the library with as many threads. The winner is only
+     * reported: a stored kernel would switch every later run away from the quicksort and the options of it */
+    trial = parallel;
+    trial.alternate = 'A';
+    library_time = TimeTrial(source, array, &trial);
+    Report("Library with %d threads: %.4f s\n", trial.maxthreads, library_time);
+
+    fflush(stdout);
+    if (-1 != saved)
+    {
+        dup2(saved, STDOUT_FILENO);
+        close(saved);
+    }
+    if (-1 != null)
+    {
+        close(null);
+    }
+
+    free(array);
+    free(source);
+
+    if (0 > best_time || 0 != SaveProfile(TUNE_FILE, &best))
+    {
+        printf("ERROR - Tuning Failed\n");
+        return 1;
+    }
+
+    printf("Tuned: -s %d -m3 %c -m %c -t %d -p %lu (%.4f s for %lu elements), stored into %s\n", 
+            best.threshold, (TRUE == best.median) ? 'Y' : 'N', (TRUE == best.multithread) ? 'Y' : 'N',
+            best.maxthreads, best.pieces, best_time, options->size, TUNE_FILE);
+    if (0 <= library_time && library_time < best_time)
+    {
+        printf("The library is faster on this host (%.4f s), pass -a A to use it\n", library_time);
+    }
+    return 0;
+}
+
+int SaveProfile(const char *path, const cmd_options_t *options)
+{
+    FILE *file = fopen(path, "w");
+    int status = 0;
+
+    if (NULL == file)
+    {
+        perror("Error opening profile file");
+        return 1;
+    }
+
+    status |= (0 > fprintf(file, "threshold=%d\n", options->threshold));
+    status |= (0 > fprintf(file, "median=%c\n", (TRUE == options->median) ? 'Y' : 'N'));
+    status |= (0 > fprintf(file, "multithread=%c\n", (TRUE == options->multithread) ? 'Y' : 'N'));
+    status |= (0 > fprintf(file, "maxthreads=%d\n", options->maxthreads));
+    status |= (0 > fprintf(file, "pieces=%lu\n", options->pieces));
+    status |= (0 != fclose(file));
+
+    if (0 != status)
+    {
+        perror("Error writing profile file");
+    }
+
+    return status;
+}
+
+int LoadProfile(const char *path, cmd_options_t *options)
+{
+    FILE *file = fopen(path, "r");
+    char key[PROFILE_FIELD];
+    char value[PROFILE_FIELD];
+
+    /* Without a profile the defaults stay */
+    if (NULL == file)
+    {
+        return 1;
+    }
+
+    while (2 == fscanf(file, " %31[^=]=%31s", key, value))
+    {
+        /* A kernel stored by an older tuner is ignored, the algorithm is chosen only by -a */
+        if (strcmp(key, "threshold") == 0) 
+        {
+            options->threshold = atoi(value);
+        }
+        else if (strcmp(key, "median") == 0) 
+        {
+            options->median = (value[0] == 'Y' || value[0] == 'y');
+        }
+        else if (strcmp(key, "multithread") == 0) 
+        {
+            options->multithread = (value[0] == 'Y' || value[0] == 'y');
+        }
+        else if (strcmp(key, "maxthreads") == 0) 
+        {
+            options->maxthreads = atoi(value);
+        }
+        else if (strcmp(key, "pieces") == 0) 
+        {
+            options->pieces = atoi(value);
+        }
+    }
+
+    fclose(file);
+    Report("Tuned parameters loaded from %s\n", path);
+    return 0;
+}
+
+uint64_t ProfileNow(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+#ifdef QSORT_PROFILE
+void ProfileSplit(int depth, int low, int high, size_t pivot)
+{
+    int level = (depth < PROFILE_LEVELS) ? depth : PROFILE_LEVELS - 1;
+    int bucket = (int)((double)((long)pivot - low) / (high - low) * PROFILE_SKEW_BUCKETS);
+
+    /* The pivot at the upper end is a split of 100%, it shares the last bucket */
+    bucket = (0 > bucket) ? 0 : bucket;
+    bucket = (PROFILE_SKEW_BUCKETS <= bucket) ? PROFILE_SKEW_BUCKETS - 1 : bucket;
+
+    __atomic_add_fetch(&qsort_profile.skew[level][bucket], 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&qsort_profile.partitions, 1, __ATOMIC_RELAXED);
+
+    uint64_t deepest = __atomic_load_n(&qsort_profile.max_depth, __ATOMIC_RELAXED);
+    while ((uint64_t)depth > deepest && 
+            !__atomic_compare_exchange_n(&qsort_profile.max_depth, &deepest, depth, FALSE, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+    }
+}
+
+void ProfileLeaf(size_t size)
+{
+    int bucket = 0;
+
+    /* The leaves are counted by powers of two: [0, 2), [2, 4), [4, 8) and so on */
+    while (size >= 2 && bucket + 1 < PROFILE_LEAF_BUCKETS)
+    {
+        size /= 2;
+        ++bucket;
+    }
+
+    __atomic_add_fetch(&qsort_profile.leaves[bucket], 1, __ATOMIC_RELAXED);
+}
+
+void PrintQuicksortProfile(void)
+{
+    int levels = (qsort_profile.max_depth < PROFILE_LEVELS) ? (int)qsort_profile.max_depth + 1 : PROFILE_LEVELS;
+
+    printf("Quicksort profile: %lu partitions, maximum depth %lu\n", qsort_profile.partitions, qsort_profile.max_depth);
+    printf("%-7s %10s", "Level", "Splits");
+    for (int bucket = 0; bucket < PROFILE_SKEW_BUCKETS; ++bucket)
+    {
+        char label[PROFILE_FIELD] = {0};
+
+        snprintf(label, sizeof(label), "%d-%d", 100 * bucket / PROFILE_SKEW_BUCKETS, 100 * (bucket + 1) / PROFILE_SKEW_BUCKETS);
+        printf(" %7s", label);
+    }
+    printf(" (%% of the splits by the share of the left part)\n");
+
+    for (int level = 0; level < levels; ++level)
+    {
+        uint64_t splits = 0;
+
+        for (int bucket = 0; bucket < PROFILE_SKEW_BUCKETS; ++bucket)
+        {
+            splits += qsort_profile.skew[level][bucket];
+        }
+
+        if (0 == splits)
+        {
+            continue;
+        }
+
+        printf("%-3d%-4s %10lu", level, (level + 1 == PROFILE_LEVELS) ? "+" : "", splits);
+        for (int bucket = 0; bucket < PROFILE_SKEW_BUCKETS; ++bucket)
+        {
+            printf(" %7.2f", 100.0 * qsort_profile.skew[level][bucket] / splits);
+        }
+        printf("\n");
+    }
+
+    printf("Leaves:");
+    for (int bucket = 0; bucket < PROFILE_LEAF_BUCKETS; ++bucket)
+    {
+        printf(" %lu%s: %lu", (0 == bucket) ? 0 : 1UL << bucket, (bucket + 1 == PROFILE_LEAF_BUCKETS) ? "+" : "", 
+                qsort_profile.leaves[bucket]);
+    }
+    printf("\n");
+
+    printf("Time over all threads: partition %.3f s, shell sort %.3f s\n", 
+            qsort_profile.partition_ns / 1e9, qsort_profile.shell_ns / 1e9);
+}
+#endif
+
+void SortPiece(int *piece, size_t size, const void *sort_options)
+{
+    const cmd_options_t *options = (const cmd_options_t *)sort_options;
+
+    Quicksort(piece, 0, size - 1, options->threshold, options->median);
+}
+
+int LazyMode(int *array, const cmd_options_t *options, const verify_t *input_verify)
+{
+    verify_t output_verify;
+    verify_t block_verify;
+    struct timeval first_time;
+    const int *block = NULL;
+    size_t count = 0;
+    size_t nblocks = 0;
+    int nworkers = (TRUE == options->multithread) ? options->maxthreads : 0;
+
+    start = clock(); /* Get the starting CPU time */
+    gettimeofday(&sorting_start_time, NULL);
+
+    lazy_sort_t *lazy = CreateLazySort(array, options->size, options->lazy, options->median, SortPiece, options, nworkers);
+    if (NULL == lazy)
+    {
+        return 1;
+    }
+
+    /* The consumer of the blocks only checks them, a real one would start working on the first block */
+    VerifyInit(&output_verify);
+    while (0 != (count = LazyNext(lazy, &block)))
+    {
+        if (0 == nblocks)
+        {
+            gettimeofday(&first_time, NULL);
+            printf("First block: %lu elements after %.3f s\n", count, 
+                    (first_time.tv_sec - sorting_start_time.tv_sec) + (first_time.tv_usec - sorting_start_time.tv_usec) / 1e6);
+        }
+
+        VerifyBlock(block, count, &block_verify);
+        VerifyCombine(&output_verify, &block_verify);
+        ++nblocks;
+    }
+
+    gettimeofday(&sorting_end_time, NULL);
+    end = clock(); /* Get the ending CPU time */
+    DestroyLazySort(lazy);
+
+    printf("Blocks: %lu (%.0f elements on average) with %d background threads\n", nblocks, (double)options->size / nblocks, nworkers);
+
+    if (!output_verify.sorted || output_verify.count != options->size) 
+    {
+        printf("ERROR - Data Not Sorted\n");
+        return 1;
+    }
+    else if (!VerifyEqual(input_verify, &output_verify))
+    {
+        printf("ERROR - Data Checksum Mismatch\n");
+        return 1;
+    }
+
+    printf("\n");
+    return 0;
+}
+
+int ColumnMode(int *array, const cmd_options_t *options)
+{
+    int status = 0;
+    int maxthreads = (TRUE == options->multithread) ? options->maxthreads : 1;
+    size_t ncolumns = options->columns;
+    int *columns[MAX_COLUMNS] = {NULL};
+    int *out[MAX_COLUMNS] = {NULL};
+    uint32_t *perm = (uint32_t *)malloc(sizeof(uint32_t) * options->size);
+    uint8_t *seen = (uint8_t *)calloc(options->size, 1);
+
+    if (NULL == perm || NULL == seen)
+    {
+        perror("Memory allocation is failure!");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t column = 0; column < ncolumns; ++column)
+    {
+        columns[column] = (int *)malloc(sizeof(int) * options->size);
+        out[column] = (int *)malloc(sizeof(int) * options->size);
+        if (NULL == columns[column] || NULL == out[column])
+        {
+            perror("Memory allocation is failure!");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /* The leading columns take few values, so every later column decides between many equal rows */
+    for (size_t column = 0; column + 1 < ncolumns; ++column)
+    {
+        for (size_t idx = 0; idx < options->size; ++idx)
+        {
+            columns[column][idx] = (int)(SplitMix64(idx * MAX_COLUMNS + column) % COLUMNS_RANGE) - COLUMNS_RANGE / 2;
+        }
+    }
+    memcpy(columns[ncolumns - 1], array, sizeof(int) * options->size);
+
+    start = clock(); /* Get the starting CPU time */
+    gettimeofday(&sorting_start_time, NULL);
+    size_t nchunks = ArgsortColumns((const int *const *)columns, ncolumns, options->size, perm, options->engine, maxthreads);
+    if (0 == nchunks)
+    {
+        perror("Memory allocation is failure!");
+        exit(EXIT_FAILURE);
+    }
+    GatherColumns((const int *const *)columns, out, ncolumns, perm, options->size, maxthreads);
+    gettimeofday(&sorting_end_time, NULL);
+    end = clock(); /* Get the ending CPU time */
+
+    printf("Columns: %lu sorted by %lu packed keys\n", ncolumns, nchunks);
+
+    /* Rows must be a permutation of the input, in order, with equal rows in the input order */
+    for (size_t idx = 0; idx < options->size && 0 == status; ++idx)
+    {
+        int order = 0;
+
+        if (perm[idx] >= options->size || seen[perm[idx]])
+        {
+            printf("ERROR - Rows Corrupted\n");
+            status = 1;
+            break;
+        }
+        seen[perm[idx]] = TRUE;
+
+        for (size_t column = 0; column < ncolumns; ++column)
+        {
+            if (out[column][idx] != columns[column][perm[idx]])
+            {
+                printf("ERROR - Rows Corrupted\n");
+                status = 1;
+            }
+            if (0 != idx && 0 == order)
+            {
+                order = (out[column][idx - 1] > out[column][idx]) - (out[column][idx - 1] < out[column][idx]);
+            }
+        }
+
+        if (0 == status && 0 != idx && (0 < order || (0 == order && perm[idx - 1] > perm[idx])))
+        {
+            printf("ERROR - Data Not Sorted\n");
+            status = 1;
+        }
+    }
+
+    if (0 == status)
+    {
+        printf("\n");
+    }
+
+    for (size_t column = 0; column < ncolumns; ++column)
+    {
+        free(columns[column]);
+        free(out[column]);
+    }
+    free(perm);
+    free(seen);
+    return status;
+}
+
+int StringMode(const cmd_options_t *options)
+{
+    int status = 0;
+    int maxthreads = (TRUE == options->multithread) ? options->maxthreads : 1;
+    int fd = open(options->strings, O_RDONLY);
+    struct stat info;
+    const char *text = NULL;
+    sort_string_t *strings = NULL;
+    size_t count = 0;
+    uint64_t sums[2] = {0, 0};
+    struct timeval start_time;
+    struct timeval write_time;
+
+    if (-1 == fd || -1 == fstat(fd, &info))
+    {
+        perror("Opening of the strings is failure!");
+        if (-1 != fd)
+        {
+            close(fd);
+        }
+        return 1;
+    }
+
+    gettimeofday(&start_time, NULL);
+    start = clock(); /* Get the starting CPU time */
+
+    /* The lines stay in the mapping, the sort moves only their descriptors */
+    if (0 < info.st_size)
+    {
+        text = (const char *)mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (MAP_FAILED == text)
+        {
+            perror("Mapping of the strings is failure!");
+            close(fd);
+            return 1;
+        }
+        madvise((void *)text, info.st_size, MADV_SEQUENTIAL);
+    }
+    close(fd);
+
+    const char *limit = text + info.st_size;
+    for (const char *pos = text; pos < limit && count < options->size; ++count)
+    {
+        const char *eol = (const char *)memchr(pos, '\n', limit - pos);
+        pos = (NULL == eol) ? limit : eol + 1;
+    }
+
+    strings = (sort_string_t *)malloc(sizeof(sort_string_t) * (0 == count ? 1 : count));
+    if (NULL == strings)
+    {
+        perror("Allocation memory is failure!");
+        exit(EXIT_FAILURE);
+    }
+
+    const char *pos = text;
+    for (size_t idx = 0; idx < count; ++idx)
+    {
+        const char *eol = (const char *)memchr(pos, '\n', limit - pos);
+
+        strings[idx].str = pos;
+        strings[idx].length = ((NULL == eol) ? limit : eol) - pos;
+        sums[0] += (uintptr_t)pos;
+        sums[1] += strings[idx].length;
+        pos += strings[idx].length + 1;
+    }
+
+    gettimeofday(&sorting_start_time, NULL);
+    StringSort(strings, count, maxthreads);
+    gettimeofday(&sorting_end_time, NULL);
+
+    /* The lines must be a permutation of the input in byte order, a prefix before the longer line */
+    for (size_t idx = 0; idx < count; ++idx)
+    {
+        sums[0] -= (uintptr_t)strings[idx].str;
+        sums[1] -= strings[idx].length;
+        if (0 != idx && 0 == status)
+        {
+            const sort_string_t *first = &strings[idx - 1];
+            const sort_string_t *second = &strings[idx];
+            size_t common = (first->length < second->length) ? first->length : second->length;
+            int order = memcmp(first->str, second->str, common);
+
+            if (0 < order || (0 == order && first->length > second->length))
+            {
+                Report("ERROR - Data Not Sorted\n");
+                status = 1;
+            }
+        }
+    }
+
+    if (0 == status && (0 != sums[0] || 0 != sums[1]))
+    {
+        Report("ERROR - Data Checksum Mismatch\n");
+        status = 1;
+    }
+
+    gettimeofday(&write_time, NULL);
+    if (0 == status)
+    {
+        status = WriteStrings(strings, count, limit);
+    }
+    end = clock(); /* Get the ending CPU time */
+    gettimeofday(&load_end_time, NULL);
+
+    Report("Strings: %lu Bytes: %lu\n", count, (unsigned long)info.st_size);
+    Report("Load: %.3f ", ((sorting_start_time.tv_sec - start_time.tv_sec) * 1e6 + (sorting_start_time.tv_usec - start_time.tv_usec)) / 1e6);
+    Report("Sort: %.3f ", ((sorting_end_time.tv_sec - sorting_start_time.tv_sec) * 1e6 + (sorting_end_time.tv_usec - sorting_start_time.tv_usec)) / 1e6);
+    Report("Write: %.3f ", ((load_end_time.tv_sec - write_time.tv_sec) * 1e6 + (load_end_time.tv_usec - write_time.tv_usec)) / 1e6);
+    Report("Total (Wall/CPU): %.3f / %.3f\n", ((load_end_time.tv_sec - start_time.tv_sec) * 1e6 + (load_end_time.tv_usec - start_time.tv_usec)) / 1e6,
+            ((double) (end - start)) / CLOCKS_PER_SEC);
+
+    if (NULL != text)
+    {
+        munmap((void *)text, info.st_size);
+    }
+    free(strings);
+    return status;
+}
+
+int WriteStrings(const sort_string_t *strings, size_t count, const char *limit)
+{
+    static char newline = '\n';
+    struct iovec iov[IOV_MAX];
+    size_t idx = 0;
+
+    /* The lines are written straight from the mapping together with their newlines */
+    while (idx < count)
+    {
+        int niov = 0;
+        int first = 0;
+
+        /* Only the last line of a file without the final newline takes a second vector */
+        for (; idx < count && niov + 2 <= IOV_MAX; ++idx)
+        {
+            iov[niov].iov_base = (void *)strings[idx].str;
+            iov[niov].iov_len = strings[idx].length;
+            if (strings[idx].str + strings[idx].length < limit)
+            {
+                ++iov[niov++].iov_len;
+            }
+            else
+            {
+                ++niov;
+                iov[niov].iov_base = &newline;
+                iov[niov++].iov_len = 1;
+            }
+        }
+
+        while (first < niov)
+        {
+            ssize_t written = writev(STDOUT_FILENO, iov + first, niov - first);
+
+            if (-1 == written)
+            {
+                if (EINTR == errno)
+                {
+                    continue;
+                }
+                perror("Writing of the strings is failure!");
+                return 1;
+            }
+
+            /* A partial write resumes inside the vector it stopped in */
+            while (first < niov && (size_t)written >= iov[first].iov_len)
+            {
+                written -= iov[first++].iov_len;
+            }
+            if (first < niov)
+            {
+                iov[first].iov_base = (char *)iov[first].iov_base + written;
+                iov[first].iov_len -= written;
+            }
+        }
+    }
+
+    return 0;
 }
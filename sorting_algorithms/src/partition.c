@@ -0,0 +1,100 @@
+#include <stddef.h>     /* size_t */
+
+#include "partition.h"
+
+#define TRUE 1
+#define FALSE 0
+
+void Swap(int *a, int *b)
+{
+    int temp = *a;
+    *a = *b;
+    *b = temp;
+}
+
+int MedianOfThree(int *array, int low, int mid, int high) 
+{
+    /* Check if the value at 'lo' is the median of the three values */
+    /* The comparisons replace (array[low] - array[mid]) * (array[high] - array[low]) >= 0, 
+            which overflows on values of the whole int range */
+    if ((array[low] >= array[mid] && array[low] <= array[high]) || (array[low] <= array[mid] && array[low] >= array[high])) 
+    {
+        return low;
+    } 
+    /* Check if the value at 'mid' is the median of the three values */
+    else if ((array[mid] >= array[low] && array[mid] <= array[high]) || (array[mid] <= array[low] && array[mid] >= array[high])) 
+    {
+        return mid;
+    } 
+    /* If neither low nor mid is the median, then the value at high must be the median */
+    else 
+    {
+        return high;
+    }
+}
+
+void Partition(int *array, int low, int high, size_t *i, size_t *j)
+{
+    /* Choose the first element in the subarray as the pivot */
+    int pivot = array[low];
+
+    /* Initialize i to the second element */ 
+    *i = low + 1;
+    /* Initialize j to the last element in the subarray */
+    *j = high;
+
+    /* Continue the loop until i and j pointers cross each other */
+    while (TRUE) 
+    {
+        /* Move i pointer to the right until an element greater than the pivot is found */
+        while (*i <= *j && array[*i] <= pivot) 
+        {
+            ++(*i);
+        }
+
+        /* Move j pointer to the left until an element less than the pivot is found */
+        while (*i <= *j && array[*j] >= pivot) 
+        {
+            --(*j);
+        }
+
+        /* Exit the loop if the i and j pointers have crossed each other */
+        if (*i > *j) 
+        {
+            break;
+        }
+
+        /* Swap the elements at positions i and j as they are on the wrong side of the pivot */
+        Swap(&array[*i], &array[*j]);
+    }
+
+    /* Swap the pivot element with the element at position j, placing the pivot in its correct position */
+    Swap(&array[low], &array[*j]);
+}
+
+void ShellSort(int *array, int low, int high)
+{
+    int n = high - low + 1;
+    int h = 1;
+
+    while (h < (n / 2)) 
+    {
+        h = 2 * h + 1;
+    }
+
+    while (h >= 1) 
+    {
+        for (size_t idx = low + h; idx <= high; ++idx) 
+        {
+            int key = array[idx];
+            int j = idx - h;
+            while (j >= low && array[j] > key) 
+            {
+                array[j + h] = array[j];
+                j -= h;
+            }
+            array[j + h] = key;
+        }
+        h /= 2;
+    }
+}
@@ -0,0 +1,625 @@
+#include <stdio.h>      /* perror */
+#include <stdlib.h>     /* malloc, qsort */
+#include <string.h>     /* memcpy */
+#include <stdint.h>     /* uint64_t */
+
+#include "sorts.h"      /* RunTasks */
+#include "partition.h"  /* Partition, ShellSort */
+#include "select.h"
+
+/* Ranges of at most this size are finished by ShellSort during selection */
+#define SELECT_SMALL 16
+/* Introselect switches to the median of medians after this many bad splits per doubling of the size */
+#define SELECT_BAD_SPLITS 2
+/* Below this size the top-k selection is not split between threads */
+#define SELECT_PARALLEL_MIN 1000000
+/* The number of equally spaced samples the pivot of the multiselect is chosen from */
+#define NUM_LOCATIONS 11
+
+#define TRUE 1
+#define FALSE 0
+
+typedef struct select_task select_task_t;
+typedef struct quantile_rank quantile_rank_t;
+typedef struct sketch_task sketch_task_t;
+
+struct select_task
+{
+    int *array;
+    size_t size;        /* The size of the chunk of the thread */
+    size_t k;           /* The number of the smallest elements to move to the front of the chunk */
+};
+
+struct quantile_rank
+{
+    size_t rank;        /* The rank of the quantile in the array */
+    size_t order;       /* The position of the quantile in the request */
+};
+
+struct sketch_task
+{
+    const int *array;
+    size_t size;
+    sketch_t *sketch;
+};
+
+int MedianOfMedians(int *array, int low, int high);
+int GroupEqual(int *array, int low, int high, int pivot, int to_right);
+void MedianSort(int *array, int low, int high);
+void *TopKThread(void *select_task);
+int SampleOfEleven(int *array, int low, int high, int order);
+int CompareRanks(const void *a, const void *b);
+int CompareInts(const void *a, const void *b);
+int SketchInsert(sketch_t *sketch, int level, int value);
+void *SketchThread(void *sketch_task);
+
+int Select(int *array, int low, int high, int k)
+{
+    size_t i = 0;
+    size_t j = 0;
+    int bad_splits = 0;
+    int budget = SELECT_BAD_SPLITS;
+
+    /* The budget of bad splits grows with the logarithm of the size */
+    for (int size = high - low + 1; size > 1; size /= 2)
+    {
+        budget += SELECT_BAD_SPLITS;
+    }
+
+    while (high - low + 1 > SELECT_SMALL)
+    {
+        int size = high - low + 1;
+        int pivot_index = 0;
+
+        /* Introselect: the cheap pivot is used until it has failed too often, then the linear-time one */
+        if (bad_splits < budget)
+        {
+            pivot_index = MedianOfThree(array, low, low + (high - low) / 2, high);
+        }
+        else
+        {
+            pivot_index = MedianOfMedians(array, low, high);
+        }
+
+        Swap(&array[low], &array[pivot_index]);
+        Partition(array, low, high, &i, &j);
+
+        if ((int)j == k)
+        {
+            return array[k];
+        }
+
+        if (k < (int)j)
+        {
+            high = j - 1;
+            /* A bad split is often caused by duplicates of the pivot, they are put aside in one pass */
+            if (4 * (high - low + 1) > 3 * size)
+            {
+                int equal = GroupEqual(array, low, high, array[j], TRUE);
+                if (k >= equal)
+                {
+                    return array[k];
+                }
+                high = equal - 1;
+            }
+        }
+        else
+        {
+            low = j + 1;
+            if (4 * (high - low + 1) > 3 * size)
+            {
+                int equal = GroupEqual(array, low, high, array[j], FALSE);
+                if (k <= equal)
+                {
+                    return array[k];
+                }
+                low = equal + 1;
+            }
+        }
+
+        if (2 * (high - low + 1) > size)
+        {
+            ++bad_splits;
+        }
+    }
+
+    if (low < high)
+    {
+        ShellSort(array, low, high);
+    }
+
+    return array[k];
+}
+
+int GroupEqual(int *array, int low, int high, int pivot, int to_right)
+{
+    /* Moves the elements equal to the pivot to the right (or left) end of the range and returns the border */
+    if (TRUE == to_right)
+    {
+        int border = high;
+        for (int idx = high; idx >= low; --idx)
+        {
+            if (array[idx] == pivot)
+            {
+                Swap(&array[idx], &array[border--]);
+            }
+        }
+        return border + 1;
+    }
+    else
+    {
+        int border = low;
+        for (int idx = low; idx <= high; ++idx)
+        {
+            if (array[idx] == pivot)
+            {
+                Swap(&array[idx], &array[border++]);
+            }
+        }
+        return border - 1;
+    }
+}
+
+int MedianOfMedians(int *array, int low, int high)
+{
+    int count = 0;
+
+    /* Every group of five is sorted and its median is gathered at the front of the range */
+    for (int group = low; group <= high; group += 5)
+    {
+        int last = (group + 4 < high) ? group + 4 : high;
+
+        ShellSort(array, group, last);
+        Swap(&array[low + count], &array[group + (last - group) / 2]);
+        ++count;
+    }
+
+    Select(array, low, low + count - 1, low + (count - 1) / 2);
+
+    return low + (count - 1) / 2;
+}
+
+void PartialSort(int *array, size_t size, size_t k)
+{
+    if (0 == k || 0 == size)
+    {
+        return;
+    }
+
+    if (k < size)
+    {
+        Select(array, 0, size - 1, k - 1);
+    }
+
+    MedianSort(array, 0, k - 1);
+}
+
+void MedianSort(int *array, int low, int high)
+{
+    /* Splitting at the exact median keeps O(n log n) even for the inputs where Quicksort degrades */
+    while (high - low + 1 > SELECT_SMALL)
+    {
+        int mid = low + (high - low) / 2;
+
+        Select(array, low, high, mid);
+        MedianSort(array, low, mid - 1);
+        low = mid + 1;
+    }
+
+    if (low < high)
+    {
+        ShellSort(array, low, high);
+    }
+}
+
+void *TopKThread(void *select_task)
+{
+    select_task_t *task = (select_task_t *)select_task;
+
+    if (task->k < task->size)
+    {
+        Select(task->array, 0, task->size - 1, task->k - 1);
+    }
+
+    return NULL;
+}
+
+void TopK(int *array, size_t size, size_t k, int *out, int maxthreads)
+{
+    size_t chunk = 0;
+    size_t candidates = 0;
+    int *buffer = NULL;
+    select_task_t *tasks = NULL;
+
+    if (k > size)
+    {
+        k = size;
+    }
+
+    /* The threads only pay off if every chunk is much larger than the requested prefix */
+    if (size < SELECT_PARALLEL_MIN || 2 > maxthreads || k * maxthreads * 2 > size)
+    {
+        PartialSort(array, size, k);
+        memcpy(out, array, sizeof(int) * k);
+        return;
+    }
+
+    tasks = (select_task_t *)calloc(maxthreads, sizeof(select_task_t));
+    buffer = (int *)malloc(sizeof(int) * k * maxthreads);
+    if (NULL == tasks || NULL == buffer)
+    {
+        free(tasks);
+        free(buffer);
+        PartialSort(array, size, k);
+        memcpy(out, array, sizeof(int) * k);
+        return;
+    }
+
+    /* Every thread moves the k smallest elements of its chunk to the front of the chunk */
+    chunk = size / maxthreads;
+    for (int thread = 0; thread < maxthreads; ++thread)
+    {
+        tasks[thread].array = array + thread * chunk;
+        tasks[thread].size = (thread + 1 == maxthreads) ? (size - thread * chunk) : chunk;
+        tasks[thread].k = k;
+    }
+
+    RunTasks(tasks, sizeof(select_task_t), maxthreads, TopKThread);
+
+    /* The k smallest elements of the array are among the k smallest elements of the chunks */
+    for (int thread = 0; thread < maxthreads; ++thread)
+    {
+        memcpy(buffer + candidates, tasks[thread].array, sizeof(int) * k);
+        candidates += k;
+    }
+
+    PartialSort(buffer, candidates, k);
+    memcpy(out, buffer, sizeof(int) * k);
+
+    free(tasks);
+    free(buffer);
+}
+
+int SampleOfEleven(int *array, int low, int high, int order)
+{
+    int locations[NUM_LOCATIONS];
+    int interval = (high - low) / (NUM_LOCATIONS - 1);
+
+    /* The same equally spaced samples as SecondOfTenPartition, ordered by their values */
+    for (int idx = 0; idx < NUM_LOCATIONS; ++idx) 
+    {
+        int location = (idx + 1 == NUM_LOCATIONS) ? high : low + idx * interval;
+        int jdx = idx - 1;
+
+        while (jdx >= 0 && array[locations[jdx]] > array[location])
+        {
+            locations[jdx + 1] = locations[jdx];
+            --jdx;
+        }
+        locations[jdx + 1] = location;
+    }
+
+    return locations[order];
+}
+
+void MultiSelect(int *array, int low, int high, const size_t *ranks, size_t nranks)
+{
+    size_t i = 0;
+    size_t j = 0;
+
+    while (0 != nranks)
+    {
+        int size = high - low + 1;
+        size_t below = 0;
+        size_t above = 0;
+
+        if (1 == nranks)
+        {
+            Select(array, low, high, ranks[0]);
+            return;
+        }
+
+        if (size <= SELECT_SMALL)
+        {
+            ShellSort(array, low, high);
+            return;
+        }
+
+        /* The sample is taken at the relative position of the middle rank, so the split lands among the ranks */
+        int order = (int)(((double)(ranks[nranks / 2] - low) / (size - 1)) * (NUM_LOCATIONS - 1) + 0.5);
+        int pivot_index = SampleOfEleven(array, low, high, order);
+
+        Swap(&array[low], &array[pivot_index]);
+        Partition(array, low, high, &i, &j);
+
+        int left_high = j - 1;
+        int right_low = j + 1;
+
+        /* Duplicates of the pivot are put aside after a bad split as in Select */
+        if (4 * (left_high - low + 1) > 3 * size)
+        {
+            left_high = GroupEqual(array, low, left_high, array[j], TRUE) - 1;
+        }
+        else if (4 * (high - right_low + 1) > 3 * size)
+        {
+            right_low = GroupEqual(array, right_low, high, array[j], FALSE) + 1;
+        }
+
+        /* Only the sides which contain requested ranks are processed further */
+        while (below < nranks && (int)ranks[below] <= left_high)
+        {
+            ++below;
+        }
+        above = below;
+        while (above < nranks && (int)ranks[above] < right_low)
+        {
+            ++above;
+        }
+
+        if (0 != below)
+        {
+            MultiSelect(array, low, left_high, ranks, below);
+        }
+
+        ranks += above;
+        nranks -= above;
+        low = right_low;
+    }
+}
+
+int CompareRanks(const void *a, const void *b)
+{
+    const quantile_rank_t *rank_a = (const quantile_rank_t *)a;
+    const quantile_rank_t *rank_b = (const quantile_rank_t *)b;
+
+    return (rank_a->rank > rank_b->rank) - (rank_a->rank < rank_b->rank);
+}
+
+int Quantiles(int *array, size_t size, const double *quantiles, size_t count, int *values)
+{
+    quantile_rank_t requests[QUANTILES_MAX];
+    size_t ranks[QUANTILES_MAX];
+    size_t nranks = 0;
+
+    if (0 == size || QUANTILES_MAX < count)
+    {
+        return 1;
+    }
+
+    for (size_t idx = 0; idx < count; ++idx)
+    {
+        if (quantiles[idx] < 0 || quantiles[idx] > 1)
+        {
+            return 1;
+        }
+
+        requests[idx].rank = (size_t)(quantiles[idx] * (size - 1));
+        requests[idx].order = idx;
+    }
+
+    /* MultiSelect expects distinct ranks in ascending order */
+    qsort(requests, count, sizeof(quantile_rank_t), CompareRanks);
+    for (size_t idx = 0; idx < count; ++idx)
+    {
+        if (0 == nranks || ranks[nranks - 1] != requests[idx].rank)
+        {
+            ranks[nranks++] = requests[idx].rank;
+        }
+    }
+
+    MultiSelect(array, 0, size - 1, ranks, nranks);
+
+    for (size_t idx = 0; idx < count; ++idx)
+    {
+        values[requests[idx].order] = array[requests[idx].rank];
+    }
+
+    return 0;
+}
+
+int CompareInts(const void *a, const void *b)
+{
+    int value_a = *(const int *)a;
+    int value_b = *(const int *)b;
+
+    return (value_a > value_b) - (value_a < value_b);
+}
+
+sketch_t *CreateSketch(void)
+{
+    sketch_t *sketch = (sketch_t *)calloc(1, sizeof(sketch_t));
+    if (NULL == sketch)
+    {
+        perror("Allocation memory is failure!");
+        return NULL;
+    }
+
+    return sketch;
+}
+
+void DestroySketch(sketch_t *sketch)
+{
+    for (int level = 0; level < sketch->nlevels; ++level)
+    {
+        free(sketch->levels[level]);
+    }
+    free(sketch);
+}
+
+int SketchInsert(sketch_t *sketch, int level, int value)
+{
+    if (level >= SKETCH_LEVELS)
+    {
+        return 1;
+    }
+
+    if (level == sketch->nlevels)
+    {
+        sketch->levels[level] = (int *)malloc(sizeof(int) * SKETCH_CAPACITY);
+        if (NULL == sketch->levels[level])
+        {
+            perror("Allocation memory is failure!");
+            return 1;
+        }
+        ++sketch->nlevels;
+    }
+
+    sketch->levels[level][sketch->sizes[level]++] = value;
+    if (SKETCH_CAPACITY != sketch->sizes[level])
+    {
+        return 0;
+    }
+
+    /* Compaction: every other value of the sorted level moves up with the doubled weight */
+    qsort(sketch->levels[level], SKETCH_CAPACITY, sizeof(int), CompareInts);
+    sketch->offset ^= 1;
+    sketch->sizes[level] = 0;
+    for (size_t idx = sketch->offset; idx < SKETCH_CAPACITY; idx += 2)
+    {
+        if (0 != SketchInsert(sketch, level + 1, sketch->levels[level][idx]))
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int SketchUpdate(sketch_t *sketch, const int *values, size_t size)
+{
+    for (size_t idx = 0; idx < size; ++idx)
+    {
+        if (0 != SketchInsert(sketch, 0, values[idx]))
+        {
+            return 1;
+        }
+    }
+
+    sketch->count += size;
+    return 0;
+}
+
+int SketchMerge(sketch_t *sketch, const sketch_t *other)
+{
+    for (int level = 0; level < other->nlevels; ++level)
+    {
+        for (size_t idx = 0; idx < other->sizes[level]; ++idx)
+        {
+            if (0 != SketchInsert(sketch, level, other->levels[level][idx]))
+            {
+                return 1;
+            }
+        }
+    }
+
+    sketch->count += other->count;
+    return 0;
+}
+
+int SketchQuery(const sketch_t *sketch, double quantile)
+{
+    int best_value = 0;
+    int best_level = -1;
+    size_t best_index = 0;
+    size_t position[SKETCH_LEVELS] = {0};
+    uint64_t weight = 0;
+    uint64_t target = (uint64_t)(quantile * (sketch->count - 1));
+
+    for (int level = 0; level < sketch->nlevels; ++level)
+    {
+        qsort(sketch->levels[level], sketch->sizes[level], sizeof(int), CompareInts);
+    }
+
+    /* Walks the weighted values of all levels in ascending order until the target rank is covered */
+    while (TRUE)
+    {
+        best_level = -1;
+        for (int level = 0; level < sketch->nlevels; ++level)
+        {
+            best_index = position[level];
+            if (best_index < sketch->sizes[level] && (-1 == best_level || sketch->levels[level][best_index] < best_value))
+            {
+                best_value = sketch->levels[level][best_index];
+                best_level = level;
+            }
+        }
+
+        if (-1 == best_level)
+        {
+            return best_value;
+        }
+
+        ++position[best_level];
+        weight += (uint64_t)1 << best_level;
+        if (weight > target)
+        {
+            return best_value;
+        }
+    }
+}
+
+double SketchErrorBound(const sketch_t *sketch)
+{
+    /* Each compaction of level l shifts ranks by at most 2^l, a level is compacted count / (capacity * 2^l) times */
+    if (0 == sketch->count)
+    {
+        return 0;
+    }
+
+    return (double)(sketch->nlevels - 1) * 2 / SKETCH_CAPACITY;
+}
+
+void *SketchThread(void *sketch_task)
+{
+    sketch_task_t *task = (sketch_task_t *)sketch_task;
+
+    task->sketch = CreateSketch();
+    if (NULL != task->sketch && 0 != SketchUpdate(task->sketch, task->array, task->size))
+    {
+        DestroySketch(task->sketch);
+        task->sketch = NULL;
+    }
+
+    return NULL;
+}
+
+sketch_t *SketchArray(const int *array, size_t size, int maxthreads)
+{
+    size_t chunk = 0;
+    sketch_t *sketch = NULL;
+    sketch_task_t *tasks = (sketch_task_t *)calloc(maxthreads, sizeof(sketch_task_t));
+
+    if (NULL == tasks)
+    {
+        perror("Allocation memory is failure!");
+        return NULL;
+    }
+
+    /* Sketches are mergeable, so every thread summarizes its own chunk */
+    chunk = size / maxthreads;
+    for (int thread = 0; thread < maxthreads; ++thread)
+    {
+        tasks[thread].array = array + thread * chunk;
+        tasks[thread].size = (thread + 1 == maxthreads) ? (size - thread * chunk) : chunk;
+    }
+
+    RunTasks(tasks, sizeof(sketch_task_t), maxthreads, SketchThread);
+
+    sketch = tasks[0].sketch;
+    for (int thread = 1; thread < maxthreads; ++thread)
+    {
+        if (NULL != sketch && (NULL == tasks[thread].sketch || 0 != SketchMerge(sketch, tasks[thread].sketch)))
+        {
+            DestroySketch(sketch);
+            sketch = NULL;
+        }
+
+        if (NULL != tasks[thread].sketch)
+        {
+            DestroySketch(tasks[thread].sketch);
+        }
+    }
+
+    free(tasks);
+    return sketch;
+}
@@ -0,0 +1,138 @@
+#include <stdio.h>      /* perror */
+#include <string.h>     /* memcpy */
+#include <unistd.h>     /* read, write */
+#include <sys/socket.h> /* sendmsg */
+#include <sys/un.h>     /* sockaddr_un */
+
+#include "sockets.h"
+
+/* The connections waiting to be accepted by a listening socket */
+#define SOCKET_BACKLOG 128
+
+int SendAll(int fd, const void *buffer, size_t bytes)
+{
+    const char *data = (const char *)buffer;
+
+    while (0 != bytes)
+    {
+        ssize_t result = write(fd, data, bytes);
+        if (0 >= result)
+        {
+            return 1;
+        }
+        data += result;
+        bytes -= result;
+    }
+
+    return 0;
+}
+
+int ReceiveAll(int fd, void *buffer, size_t bytes)
+{
+    char *data = (char *)buffer;
+
+    while (0 != bytes)
+    {
+        ssize_t result = read(fd, data, bytes);
+        if (0 >= result)
+        {
+            return 1;
+        }
+        data += result;
+        bytes -= result;
+    }
+
+    return 0;
+}
+
+int SendDescriptor(int socket_fd, int fd, const void *buffer, size_t bytes)
+{
+    struct msghdr message = {0};
+    struct iovec vector = {(void *)buffer, bytes};
+    char control[CMSG_SPACE(sizeof(int))];
+    struct cmsghdr *header = NULL;
+
+    memset(control, 0, sizeof(control));
+    message.msg_iov = &vector;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    /* The descriptor travels as ancillary data, the kernel duplicates it into the receiver */
+    header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(header), &fd, sizeof(int));
+
+    return (ssize_t)bytes != sendmsg(socket_fd, &message, 0);
+}
+
+int ReceiveDescriptor(int socket_fd, int *fd, void *buffer, size_t bytes)
+{
+    struct msghdr message = {0};
+    struct iovec vector = {buffer, bytes};
+    char control[CMSG_SPACE(sizeof(int))];
+    struct cmsghdr *header = NULL;
+
+    message.msg_iov = &vector;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    *fd = -1;
+    if ((ssize_t)bytes != recvmsg(socket_fd, &message, 0))
+    {
+        return 1;
+    }
+
+    header = CMSG_FIRSTHDR(&message);
+    if (NULL == header || SOL_SOCKET != header->cmsg_level || SCM_RIGHTS != header->cmsg_type)
+    {
+        return 1;
+    }
+
+    memcpy(fd, CMSG_DATA(header), sizeof(int));
+    return 0;
+}
+
+int OpenSocket(const char *path, struct sockaddr_un *address)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    if (-1 == fd || strlen(path) >= sizeof(address->sun_path))
+    {
+        perror("Creation of the socket is failure!");
+        if (-1 != fd)
+        {
+            close(fd);
+        }
+        return -1;
+    }
+
+    strcpy(address->sun_path, path);
+    return fd;
+}
+
+int ListenSocket(const char *path)
+{
+    struct sockaddr_un address;
+    int fd = OpenSocket(path, &address);
+
+    if (-1 == fd)
+    {
+        return -1;
+    }
+
+    unlink(path);
+    if (0 != bind(fd, (struct sockaddr *)&address, sizeof(address)) || 0 != listen(fd, SOCKET_BACKLOG))
+    {
+        perror("Creation of the socket is failure!");
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
@@ -1,8 +1,69 @@
-#include <stdlib.h> // malloc, free
-#include <string.h> // memcpy
+#include <stdlib.h>  // malloc, free
+#include <string.h>  // memcpy
+#include <stdint.h>  // uint32_t, int64_t
+#include <limits.h>  // INT_MAX
+#include <pthread.h> // pthread_create
+#ifdef __SSE2__
+#include <emmintrin.h> // _mm_cmplt_epi32
+#endif
                     
 #define True (1)
 #define False (0)
+
+// Arrays up to this size are insertion sorted
+#define SORT_SMALL (32)
+// The sample is made of this many blocks of consecutive elements
+#define SORT_SAMPLE_BLOCKS (16)
+#define SORT_SAMPLE_BLOCK (64)
+#define SORT_SAMPLE (SORT_SAMPLE_BLOCKS * SORT_SAMPLE_BLOCK)
+// Arrays up to this many samples are too small to pay for the sampling
+#define SORT_SAMPLE_RATIO (8)
+// Runs of this average length make merging the runs cheaper than sorting
+#define SORT_MIN_RUN (512)
+// The share of sampled duplicates that makes the three-way partition pay off
+#define SORT_DUPLICATES (0.5)
+// Counting sort is used while the key range is at most this many times the size
+#define SORT_COUNTING_RANGE (2)
+// Smaller arrays are not split between threads
+#define SORT_PARALLEL_MIN (1 << 20)
+// Arrays shorter than this are a single run extended by binary insertion
+#define SORT_MIN_MERGE (64)
+// The initial number of wins in a row that switches the merge to galloping
+#define SORT_MIN_GALLOP (7)
+// The run sizes on the stack grow like the Fibonacci numbers, so this many cover any size_t array
+#define SORT_MAX_PENDING (85)
+// The histograms of the parallel counting sort have to fit into this many bytes of L2 cache
+#define SORT_COUNTING_CACHE (1 << 18)
+// The smallest piece of the parallel counting sort worth its own thread
+#define SORT_COUNTING_PIECE (1 << 16)
+#define SORT_MAX_THREADS (64)
+// Segments up to this size are sorted by the sorting network, as many of them at once as there are lanes
+#define SORT_NETWORK (8)
+#define SORT_NETWORK_LANES (4)
+// Segments up to this size are insertion sorted, they are hot in the cache and need no call of a kernel
+#define SORT_SEGMENT_SMALL (64)
+#define SORT_RADIX_BITS (8)
+#define SORT_RADIX_BUCKETS (1 << SORT_RADIX_BITS)
+// Sampled values per bucket when the splitters are chosen, at least SORT_SAMPLE in total
+#define SORT_OVERSAMPLING (16)
+// The bucket of a value is kept in 16 bits, and the splitter tree stays in the L1 cache
+#define SORT_MAX_BUCKETS (4096)
+// A set this many times larger than the other is searched by galloping instead of being merged
+#define SORT_SET_SKEW (32)
+// A radix pass splits the strings by their next byte, bucket 0 holds the strings that end before it
+#define SORT_STRING_BUCKETS (257)
+// Fewer strings than this are sorted by the multikey quicksort instead of a radix pass
+#define SORT_STRING_RADIX (1 << 12)
+// The multikey quicksort leaves this many strings to the insertion sort
+#define SORT_STRING_SMALL (16)
+// The smallest number of strings worth a thread of the string sort
+#define SORT_STRING_PIECE (1 << 14)
+// The stable sort of the pairs insertion sorts runs of this size before it merges them
+#define SORT_STABLE_LEAF (16)
+// The smallest number of pairs worth a thread of the stable sort
+#define SORT_STABLE_PIECE (1 << 14)
+// The stable sort compares only the key in the upper half of a pair
+#define SORT_PAIR_KEY(pair) ((pair) >> 32)
                     
 #ifdef DEBUG
 #include <stdio.h>
@@ -11,6 +72,206 @@
 #include "sorts.h"  // sorting algorihms
 
 void _Swap(int *ptr1, int *ptr2);
+sort_kernel_t _ChooseKernel(const sort_profile_t *profile, size_t size, int maxthreads);
+size_t _CountInversions(int *arr, int *temp, size_t size);
+int _CountingSort(int *arr, size_t size, int64_t max_range);
+int _RadixSort(int *arr, size_t size);
+void _QuickSort3(int *arr, size_t size);
+int _MedianOfThree(int first, int second, int third);
+void _Reverse(int *arr, size_t size);
+
+// The state of the natural merge sort: the pending runs and the scratch buffer of the merges
+typedef struct merge_state
+{
+    int *temp;
+    size_t temp_size;
+    size_t min_gallop;                          // The number of wins in a row that starts galloping
+    size_t run_base[SORT_MAX_PENDING];
+    size_t run_size[SORT_MAX_PENDING];
+    size_t count;
+} merge_state_t;
+
+int _NaturalMergeSort(int *arr, size_t size);
+size_t _MinRun(size_t size);
+size_t _CountRun(int *arr, size_t size);
+void _BinaryInsertionSort(int *arr, size_t size, size_t sorted);
+size_t _Gallop(int key, const int *arr, size_t size, size_t hint, int is_right);
+int _MergeCollapse(merge_state_t *state, int *arr);
+int _MergeAt(merge_state_t *state, int *arr, size_t idx);
+int _MergeRanges(merge_state_t *state, int *arr, size_t left, size_t right);
+void _MergeLow(merge_state_t *state, int *arr, size_t left, size_t right);
+void _MergeHigh(merge_state_t *state, int *arr, size_t left, size_t right);
+
+// A piece to sort, or two sorted neighbouring pieces to merge if middle is not 0
+typedef struct sort_task
+{
+    int *arr;
+    size_t size;
+    size_t middle;
+    int is_natural;
+    int status;
+} sort_task_t;
+
+void _SortParallel(int *arr, size_t size, int maxthreads, int is_natural);
+void *_SortThread(void *sort_task);
+
+// The phases of the parallel counting sort
+enum
+{
+    SORT_PHASE_RANGE,
+    SORT_PHASE_COUNT,
+    SORT_PHASE_FILL,
+    SORT_PHASE_SCATTER
+};
+
+// A piece of the parallel counting sort, or a range of values [first, last) to write out in the last phase
+typedef struct counting_task
+{
+    int *arr;
+    size_t size;
+    int min;
+    int max;
+    size_t *counts;
+    size_t first;
+    size_t last;
+    int phase;
+} counting_task_t;
+
+int _ParallelCountingSort(int *arr, size_t size, int maxthreads);
+void _MinMax(const int *arr, size_t size, int *min, int *max);
+void _Fill(int *arr, int value, size_t count);
+void *_CountingThread(void *counting_task);
+
+// The segments [first, last) of a segmented sort
+typedef struct segment_task
+{
+    int *arr;
+    const size_t *offsets;
+    size_t first;
+    size_t last;
+} segment_task_t;
+
+void _SortSegments(int *arr, const size_t *offsets, size_t first, size_t last);
+void _NetworkSort(int *arr, const size_t *offsets, const size_t *batch, size_t count);
+void *_SegmentThread(void *segment_task);
+
+// A piece of the range partition, its histogram turns into the next output position of every bucket
+typedef struct partition_task
+{
+    const int *arr;
+    size_t size;
+    int *out;
+    const int *tree;
+    int levels;
+    size_t nbuckets;
+    uint16_t *oracle;
+    size_t *counts;
+    int phase;
+} partition_task_t;
+
+void _BuildTree(int *tree, const int *splitters, size_t nsplitters, size_t node, size_t nnodes, size_t *next);
+void _Classify(partition_task_t *task);
+void *_PartitionThread(void *partition_task);
+
+// The operations of the sorted-set kernels
+enum
+{
+    SORT_SET_INTERSECTION,
+    SORT_SET_UNION,
+    SORT_SET_DIFFERENCE,
+    SORT_SET_JOIN
+};
+
+// The ranges of both inputs a piece of a set operation works on, and where its output goes
+typedef struct set_task
+{
+    const int *a;
+    size_t asize;
+    const int *b;
+    size_t bsize;
+    size_t afirst;
+    size_t bfirst;
+    int *out;
+    int *dest;
+    size_t *left;
+    size_t *right;
+    size_t capacity;
+    size_t position;
+    size_t count;
+    int operation;
+    int phase;
+} set_task_t;
+
+size_t _SetOperation(const int *a, size_t asize, const int *b, size_t bsize, int *out, int operation, int maxthreads);
+int _SetThreads(size_t total, int maxthreads);
+void _SplitSets(set_task_t *tasks, const int *a, size_t asize, const int *b, size_t bsize, int operation, int maxthreads);
+size_t _CoRank(size_t diag, const int *a, size_t asize, const int *b, size_t bsize);
+void *_SetThread(void *set_task);
+size_t _SetKernel(const int *a, size_t asize, const int *b, size_t bsize, int *out, int operation);
+size_t _Intersect(const int *a, size_t asize, const int *b, size_t bsize, int *out);
+
+// The lanes set in a mask of four lanes in order, padded by the last one, and their number
+static const unsigned char set_lanes[16][5] = 
+{
+    {0, 0, 0, 0, 0}, {0, 0, 0, 0, 1}, {1, 1, 1, 1, 1}, {0, 1, 1, 1, 2}, 
+    {2, 2, 2, 2, 1}, {0, 2, 2, 2, 2}, {1, 2, 2, 2, 2}, {0, 1, 2, 2, 3}, 
+    {3, 3, 3, 3, 1}, {0, 3, 3, 3, 2}, {1, 3, 3, 3, 2}, {0, 1, 3, 3, 3}, 
+    {2, 3, 3, 3, 2}, {0, 2, 3, 3, 3}, {1, 2, 3, 3, 3}, {0, 1, 2, 3, 4}
+};
+size_t _IntersectGallop(const int *small, size_t small_size, const int *large, size_t large_size, int *out);
+size_t _Unite(const int *a, size_t asize, const int *b, size_t bsize, int *out);
+size_t _Subtract(const int *a, size_t asize, const int *b, size_t bsize, int *out);
+size_t _Join(const int *a, size_t asize, const int *b, size_t bsize, size_t afirst, size_t bfirst, 
+        size_t *left, size_t *right, size_t capacity);
+
+// The phases of the parallel string sort
+enum
+{
+    SORT_STRING_PREFIX,
+    SORT_STRING_SORT
+};
+
+// A slice [first, last) whose prefixes a thread loads, or the buckets of the first radix pass the threads take in order
+typedef struct string_task
+{
+    sort_string_t *strings;
+    sort_string_t *temp;
+    const size_t *offsets;
+    const size_t *order;
+    size_t *next;
+    size_t first;
+    size_t last;
+    size_t depth;
+    int phase;
+} string_task_t;
+
+void *_StringThread(void *string_task);
+uint64_t _LoadPrefix(const char *str, size_t length, size_t depth);
+size_t _StringCount(const sort_string_t *strings, size_t size, size_t depth, size_t *offsets);
+void _StringScatter(sort_string_t *strings, sort_string_t *temp, size_t size, size_t depth, const size_t *offsets);
+void _StringDescend(sort_string_t *strings, sort_string_t *temp, size_t size, size_t depth);
+void _StringRadixSort(sort_string_t *strings, sort_string_t *temp, size_t size, size_t depth);
+void _MultikeyQuickSort(sort_string_t *strings, size_t size, size_t depth);
+void _StringInsertionSort(sort_string_t *strings, size_t size, size_t depth);
+int _CompareStrings(const sort_string_t *first, const sort_string_t *second, size_t depth);
+void _SwapStrings(sort_string_t *first, sort_string_t *second);
+
+// The share [first, last) of the output of one pass of the stable sort, the pass of width 0 sorts the leaves
+typedef struct stable_task
+{
+    const uint64_t *src;
+    uint64_t *dst;
+    size_t size;
+    size_t width;
+    size_t first;
+    size_t last;
+} stable_task_t;
+
+void *_StableThread(void *stable_task);
+void _StableInsertionSort(uint64_t *pairs, size_t size);
+size_t _StableCoRank(size_t diag, const uint64_t *left, size_t left_size, const uint64_t *right, size_t right_size);
+void _StableMerge(const uint64_t *left, size_t left_size, const uint64_t *right, size_t right_size, 
+        size_t from, size_t to, uint64_t *out);
 
 void BubbleSort(int *arr, size_t size)
 {
@@ -43,3 +304,2653 @@ void _Swap(int *ptr1, int *ptr2)
     *ptr1 = *ptr2;
     *ptr2 = temp;
 }
+
+
+void InsertionSort(int *arr, size_t size)
+{
+    for (size_t idx = 1; idx < size; ++idx)
+    {
+        int value = arr[idx];
+        size_t jdx = idx;
+
+        while (0 < jdx && arr[jdx - 1] > value)
+        {
+            arr[jdx] = arr[jdx - 1];
+            --jdx;
+        }
+        arr[jdx] = value;
+    }
+}
+
+
+void CountingSort(int *arr, size_t size)
+{
+    // The counters of a too wide range do not fit into memory
+    if (0 != _CountingSort(arr, size, INT64_MAX))
+    {
+        _QuickSort3(arr, size);
+    }
+}
+
+
+void RadixSort(int *arr, size_t size)
+{
+    if (0 != _RadixSort(arr, size))
+    {
+        _QuickSort3(arr, size);
+    }
+}
+
+
+void ProfileArray(const int *arr, size_t size, sort_profile_t *profile)
+{
+    int sample[SORT_SAMPLE];
+    int temp[SORT_SAMPLE];
+    size_t blocks = SORT_SAMPLE_BLOCKS;
+    size_t block = SORT_SAMPLE_BLOCK;
+    size_t pairs = 0;
+    size_t changes = 0;
+    size_t count = 0;
+    size_t equal = 0;
+
+    // A small array is sampled entirely as a single block
+    if (size <= SORT_SAMPLE)
+    {
+        blocks = 1;
+        block = size;
+    }
+
+    for (size_t bdx = 0; bdx < blocks; ++bdx)
+    {
+        size_t first = (1 == blocks) ? 0 : bdx * (size - block) / (blocks - 1);
+        int direction = 0;
+
+        for (size_t idx = first; idx < first + block; ++idx)
+        {
+            sample[count++] = arr[idx];
+
+            // The run ends where the sequence turns, equal neighbours keep the direction
+            if (idx > first && arr[idx] != arr[idx - 1])
+            {
+                int current = (arr[idx] > arr[idx - 1]) ? 1 : -1;
+
+                changes += (0 != direction && current != direction);
+                direction = current;
+            }
+            pairs += (idx > first);
+        }
+    }
+
+    profile->sample = count;
+    profile->min = 0;
+    profile->max = 0;
+    profile->duplicates = 0.0;
+    profile->runs = 1.0;
+    profile->inversions = 0.0;
+    profile->kernel = SORT_INSERTION;
+
+    if (0 == count)
+    {
+        return;
+    }
+
+    if (0 != pairs)
+    {
+        profile->runs = 1.0 + (double)changes * (size - 1) / pairs;
+    }
+
+    // Counting the inversions sorts the sample, what the rest of the estimates need
+    if (1 < count)
+    {
+        profile->inversions = (double)_CountInversions(sample, temp, count) / ((double)count * (count - 1) / 2);
+    }
+
+    for (size_t idx = 1; idx < count; ++idx)
+    {
+        equal += (sample[idx] == sample[idx - 1]);
+    }
+
+    profile->min = sample[0];
+    profile->max = sample[count - 1];
+    profile->duplicates = (double)equal / count;
+}
+
+
+void Sort(int *arr, size_t size, int maxthreads, sort_profile_t *profile)
+{
+    sort_profile_t local;
+
+    if (NULL == profile)
+    {
+        profile = &local;
+    }
+
+    ProfileArray(arr, size, profile);
+    profile->kernel = _ChooseKernel(profile, size, maxthreads);
+
+#ifdef DEBUG
+    printf("Sort: %lu elements, range [%d, %d], duplicates %.3f, runs %.0f, inversions %.3f: %s\n", 
+            size, profile->min, profile->max, profile->duplicates, profile->runs, profile->inversions, 
+            SortKernelName(profile->kernel));
+#endif
+
+    switch (profile->kernel)
+    {
+        case SORT_INSERTION:
+            InsertionSort(arr, size);
+            break;
+
+        case SORT_MERGE_RUNS:
+            if (1 < maxthreads && SORT_PARALLEL_MIN <= size)
+            {
+                _SortParallel(arr, size, maxthreads, True);
+            }
+            else if (0 != _NaturalMergeSort(arr, size))
+            {
+                profile->kernel = SORT_QUICK3;
+                _QuickSort3(arr, size);
+            }
+            break;
+
+        case SORT_COUNTING:
+            // The sampled range may be narrower than the real one, the radix sort takes over then
+            if (1 < maxthreads && 0 == _ParallelCountingSort(arr, size, maxthreads))
+            {
+                break;
+            }
+            if (0 == _CountingSort(arr, size, (int64_t)size * SORT_COUNTING_RANGE))
+            {
+                break;
+            }
+            profile->kernel = SORT_RADIX;
+            /* fall through */
+
+        case SORT_RADIX:
+            if (0 != _RadixSort(arr, size))
+            {
+                profile->kernel = SORT_QUICK3;
+                _QuickSort3(arr, size);
+            }
+            break;
+
+        case SORT_PARALLEL:
+            _SortParallel(arr, size, maxthreads, False);
+            break;
+
+        default:
+            _QuickSort3(arr, size);
+            break;
+    }
+}
+
+
+const char *SortKernelName(sort_kernel_t kernel)
+{
+    static const char *names[] = {"insertion", "counting", "radix", "three-way quicksort", "run merging", "parallel"};
+
+    return (kernel <= SORT_PARALLEL) ? names[kernel] : "unknown";
+}
+
+
+sort_kernel_t _ChooseKernel(const sort_profile_t *profile, size_t size, int maxthreads)
+{
+    int64_t range = (int64_t)profile->max - profile->min + 1;
+
+    if (size <= SORT_SMALL)
+    {
+        return SORT_INSERTION;
+    }
+
+    if (profile->runs * SORT_MIN_RUN <= size)
+    {
+        return SORT_MERGE_RUNS;
+    }
+
+    if (range <= (int64_t)size * SORT_COUNTING_RANGE)
+    {
+        return SORT_COUNTING;
+    }
+
+    if (1 < maxthreads && SORT_PARALLEL_MIN <= size)
+    {
+        return SORT_PARALLEL;
+    }
+
+    return (SORT_DUPLICATES <= profile->duplicates) ? SORT_QUICK3 : SORT_RADIX;
+}
+
+
+size_t _CountInversions(int *arr, int *temp, size_t size)
+{
+    size_t middle = size / 2;
+    size_t inversions = 0;
+    size_t left = 0;
+    size_t right = middle;
+    size_t out = 0;
+
+    if (size < 2)
+    {
+        return 0;
+    }
+
+    inversions += _CountInversions(arr, temp, middle);
+    inversions += _CountInversions(arr + middle, temp, size - middle);
+
+    // Every element taken from the right half is inverted with the rest of the left half
+    while (left < middle && right < size)
+    {
+        if (arr[right] < arr[left])
+        {
+            inversions += middle - left;
+            temp[out++] = arr[right++];
+        }
+        else
+        {
+            temp[out++] = arr[left++];
+        }
+    }
+
+    while (left < middle)
+    {
+        temp[out++] = arr[left++];
+    }
+
+    memcpy(arr, temp, sizeof(int) * out);
+    return inversions;
+}
+
+
+int _CountingSort(int *arr, size_t size, int64_t max_range)
+{
+    int min = 0;
+    int max = 0;
+    size_t *counts = NULL;
+    size_t out = 0;
+
+    if (0 == size)
+    {
+        return 0;
+    }
+
+    _MinMax(arr, size, &min, &max);
+
+    int64_t range = (int64_t)max - min + 1;
+    if (range > max_range || (uint64_t)range > SIZE_MAX / sizeof(size_t))
+    {
+        return 1;
+    }
+
+    counts = (size_t *)calloc((size_t)range, sizeof(size_t));
+    if (NULL == counts)
+    {
+        return 1;
+    }
+
+    for (size_t idx = 0; idx < size; ++idx)
+    {
+        ++counts[(int64_t)arr[idx] - min];
+    }
+
+    for (int64_t value = 0; value < range; ++value)
+    {
+        _Fill(arr + out, (int)(value + min), counts[value]);
+        out += counts[value];
+    }
+
+    free(counts);
+    return 0;
+}
+
+
+int _RadixSort(int *arr, size_t size)
+{
+    size_t counts[sizeof(int)][SORT_RADIX_BUCKETS] = {{0}};
+    uint32_t *source = (uint32_t *)arr;
+    uint32_t *target = (uint32_t *)malloc(sizeof(uint32_t) * size);
+
+    if (NULL == target)
+    {
+        return 1;
+    }
+
+    // All the histograms are made in one pass, flipping the sign bit orders the values as unsigned
+    for (size_t idx = 0; idx < size; ++idx)
+    {
+        uint32_t key = source[idx] ^ 0x80000000U;
+
+        for (size_t digit = 0; digit < sizeof(int); ++digit)
+        {
+            ++counts[digit][(key >> (digit * SORT_RADIX_BITS)) & (SORT_RADIX_BUCKETS - 1)];
+        }
+    }
+
+    for (size_t digit = 0; digit < sizeof(int); ++digit)
+    {
+        size_t offsets[SORT_RADIX_BUCKETS];
+        size_t sum = 0;
+        int shift = digit * SORT_RADIX_BITS;
+
+        // A digit shared by all the values does not reorder anything
+        if (size == counts[digit][((source[0] ^ 0x80000000U) >> shift) & (SORT_RADIX_BUCKETS - 1)])
+        {
+            continue;
+        }
+
+        for (size_t bucket = 0; bucket < SORT_RADIX_BUCKETS; ++bucket)
+        {
+            offsets[bucket] = sum;
+            sum += counts[digit][bucket];
+        }
+
+        for (size_t idx = 0; idx < size; ++idx)
+        {
+            target[offsets[((source[idx] ^ 0x80000000U) >> shift) & (SORT_RADIX_BUCKETS - 1)]++] = source[idx];
+        }
+
+        uint32_t *temp = source;
+        source = target;
+        target = temp;
+    }
+
+    if (source != (uint32_t *)arr)
+    {
+        memcpy(arr, source, sizeof(int) * size);
+        target = source;
+    }
+
+    free(target);
+    return 0;
+}
+
+
+void _QuickSort3(int *arr, size_t size)
+{
+    while (SORT_SMALL < size)
+    {
+        size_t step = size / 8;
+        int pivot = 0;
+        size_t less = 0;
+        size_t idx = 0;
+        size_t greater = size;
+
+        // The ninther of the array resists the organ pipes and the sawtooth patterns
+        pivot = _MedianOfThree(_MedianOfThree(arr[0], arr[step], arr[2 * step]),
+                               _MedianOfThree(arr[size / 2 - step], arr[size / 2], arr[size / 2 + step]),
+                               _MedianOfThree(arr[size - 1 - 2 * step], arr[size - 1 - step], arr[size - 1]));
+
+        // [0, less) is smaller than the pivot, [less, greater) equals it, [greater, size) is larger
+        while (idx < greater)
+        {
+            if (arr[idx] < pivot)
+            {
+                _Swap(&arr[less++], &arr[idx++]);
+            }
+            else if (arr[idx] > pivot)
+            {
+                _Swap(&arr[idx], &arr[--greater]);
+            }
+            else
+            {
+                ++idx;
+            }
+        }
+
+        // The smaller side is recursed into so that the stack stays logarithmic
+        if (less < size - greater)
+        {
+            _QuickSort3(arr, less);
+            arr += greater;
+            size -= greater;
+        }
+        else
+        {
+            _QuickSort3(arr + greater, size - greater);
+            size = less;
+        }
+    }
+
+    InsertionSort(arr, size);
+}
+
+
+int _MedianOfThree(int first, int second, int third)
+{
+    if (first > second)
+    {
+        _Swap(&first, &second);
+    }
+
+    if (second > third)
+    {
+        second = third;
+    }
+
+    return (first > second) ? first : second;
+}
+
+
+void NaturalMergeSort(int *arr, size_t size)
+{
+    if (0 != _NaturalMergeSort(arr, size))
+    {
+        _QuickSort3(arr, size);
+    }
+}
+
+
+void ParallelNaturalMergeSort(int *arr, size_t size, int maxthreads)
+{
+    if (2 > maxthreads || size < (size_t)maxthreads * SORT_MIN_MERGE)
+    {
+        NaturalMergeSort(arr, size);
+        return;
+    }
+
+    _SortParallel(arr, size, maxthreads, True);
+}
+
+
+int _NaturalMergeSort(int *arr, size_t size)
+{
+    merge_state_t state = {NULL, 0, SORT_MIN_GALLOP, {0}, {0}, 0};
+    size_t min_run = _MinRun(size);
+    size_t first = 0;
+    int status = 0;
+
+    while (first < size && 0 == status)
+    {
+        size_t length = _CountRun(arr + first, size - first);
+
+        // Short runs are extended by binary insertion, so that the merges stay balanced
+        if (length < min_run)
+        {
+            size_t extended = (size - first < min_run) ? size - first : min_run;
+
+            _BinaryInsertionSort(arr + first, extended, length);
+            length = extended;
+        }
+
+        state.run_base[state.count] = first;
+        state.run_size[state.count] = length;
+        ++state.count;
+        first += length;
+
+        status = _MergeCollapse(&state, arr);
+    }
+
+    // Whatever is left on the stack is merged from the top
+    while (1 < state.count && 0 == status)
+    {
+        size_t top = state.count - 2;
+
+        if (0 < top && state.run_size[top - 1] < state.run_size[top + 1])
+        {
+            --top;
+        }
+        status = _MergeAt(&state, arr, top);
+    }
+
+    free(state.temp);
+    return status;
+}
+
+
+size_t _MinRun(size_t size)
+{
+    size_t remainder = 0;
+
+    // The number of runs becomes a power of two or a bit less, what the balanced merges like most
+    while (SORT_MIN_MERGE <= size)
+    {
+        remainder |= size & 1;
+        size >>= 1;
+    }
+
+    return size + remainder;
+}
+
+
+size_t _CountRun(int *arr, size_t size)
+{
+    size_t last = 1;
+
+    if (size < 2)
+    {
+        return size;
+    }
+
+    // Only strictly descending runs are reversed, otherwise equal elements would change their order
+    if (arr[1] < arr[0])
+    {
+        while (last < size && arr[last] < arr[last - 1])
+        {
+            ++last;
+        }
+        _Reverse(arr, last);
+    }
+    else
+    {
+        while (last < size && arr[last] >= arr[last - 1])
+        {
+            ++last;
+        }
+    }
+
+    return last;
+}
+
+
+void _BinaryInsertionSort(int *arr, size_t size, size_t sorted)
+{
+    for (size_t idx = (0 == sorted) ? 1 : sorted; idx < size; ++idx)
+    {
+        int value = arr[idx];
+        size_t position = _Gallop(value, arr, idx, idx / 2, True);
+
+        memmove(arr + position + 1, arr + position, sizeof(int) * (idx - position));
+        arr[position] = value;
+    }
+}
+
+
+size_t _Gallop(int key, const int *arr, size_t size, size_t hint, int is_right)
+{
+    size_t last = 0;
+    size_t offset = 1;
+    size_t low = 0;
+    size_t high = 0;
+
+    if (0 == size)
+    {
+        return 0;
+    }
+
+    // The position is the number of elements smaller than the key, or not larger than it if is_right
+    if (arr[hint] < key || (is_right && arr[hint] == key))
+    {
+        while (hint + offset < size && (arr[hint + offset] < key || (is_right && arr[hint + offset] == key)))
+        {
+            last = offset;
+            offset = (offset << 1) + 1;
+        }
+        low = hint + last + 1;
+        high = (hint + offset < size) ? hint + offset : size;
+    }
+    else
+    {
+        while (offset <= hint && !(arr[hint - offset] < key || (is_right && arr[hint - offset] == key)))
+        {
+            last = offset;
+            offset = (offset << 1) + 1;
+        }
+        low = (offset > hint) ? 0 : hint - offset + 1;
+        high = hint - last;
+    }
+
+    // The exponential probes bound the position, a binary search finds it
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+
+        if (arr[middle] < key || (is_right && arr[middle] == key))
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+
+int _MergeCollapse(merge_state_t *state, int *arr)
+{
+    // The sizes of the runs on the stack have to grow at least as fast as the Fibonacci numbers
+    while (1 < state->count)
+    {
+        size_t top = state->count - 2;
+        size_t *sizes = state->run_size;
+
+        if ((0 < top && sizes[top - 1] <= sizes[top] + sizes[top + 1]) ||
+                (1 < top && sizes[top - 2] <= sizes[top - 1] + sizes[top]))
+        {
+            if (sizes[top - 1] < sizes[top + 1])
+            {
+                --top;
+            }
+        }
+        else if (sizes[top] > sizes[top + 1])
+        {
+            break;
+        }
+
+        if (0 != _MergeAt(state, arr, top))
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
+int _MergeAt(merge_state_t *state, int *arr, size_t idx)
+{
+    size_t base = state->run_base[idx];
+    size_t left = state->run_size[idx];
+    size_t right = state->run_size[idx + 1];
+
+    state->run_size[idx] = left + right;
+    if (idx + 3 == state->count)
+    {
+        state->run_base[idx + 1] = state->run_base[idx + 2];
+        state->run_size[idx + 1] = state->run_size[idx + 2];
+    }
+    --state->count;
+
+    return _MergeRanges(state, arr + base, left, right);
+}
+
+
+int _MergeRanges(merge_state_t *state, int *arr, size_t left, size_t right)
+{
+    // The elements of the left run before the first right one and the right ones after the last left one stay in place
+    size_t skip = _Gallop(arr[left], arr, left, 0, True);
+
+    arr += skip;
+    left -= skip;
+    if (0 == left)
+    {
+        return 0;
+    }
+
+    right = _Gallop(arr[left - 1], arr + left, right, right - 1, False);
+    if (0 == right)
+    {
+        return 0;
+    }
+
+    // The smaller run is moved out of the way
+    size_t need = (left < right) ? left : right;
+    if (need > state->temp_size)
+    {
+        int *temp = (int *)realloc(state->temp, sizeof(int) * need);
+        if (NULL == temp)
+        {
+            return 1;
+        }
+        state->temp = temp;
+        state->temp_size = need;
+    }
+
+    if (left <= right)
+    {
+        _MergeLow(state, arr, left, right);
+    }
+    else
+    {
+        _MergeHigh(state, arr, left, right);
+    }
+
+    return 0;
+}
+
+
+void _MergeLow(merge_state_t *state, int *arr, size_t left, size_t right)
+{
+    int *first = state->temp;
+    int *second = arr + left;
+    size_t idx = 0;
+    size_t jdx = 0;
+    size_t out = 0;
+    size_t first_wins = 0;
+    size_t second_wins = 0;
+
+    memcpy(first, arr, sizeof(int) * left);
+
+    while (idx < left && jdx < right)
+    {
+        // After a run of wins of one side whole stretches are found by galloping instead of one by one
+        if (first_wins >= state->min_gallop || second_wins >= state->min_gallop)
+        {
+            size_t count = _Gallop(second[jdx], first + idx, left - idx, 0, True);
+
+            memcpy(arr + out, first + idx, sizeof(int) * count);
+            out += count;
+            idx += count;
+            if (idx == left)
+            {
+                break;
+            }
+
+            size_t other = _Gallop(first[idx], second + jdx, right - jdx, 0, False);
+
+            memmove(arr + out, second + jdx, sizeof(int) * other);
+            out += other;
+            jdx += other;
+
+            if (count < SORT_MIN_GALLOP && other < SORT_MIN_GALLOP)
+            {
+                ++state->min_gallop;
+                first_wins = 0;
+                second_wins = 0;
+            }
+            else if (1 < state->min_gallop)
+            {
+                --state->min_gallop;
+            }
+            continue;
+        }
+
+        if (second[jdx] < first[idx])
+        {
+            arr[out++] = second[jdx++];
+            ++second_wins;
+            first_wins = 0;
+        }
+        else
+        {
+            arr[out++] = first[idx++];
+            ++first_wins;
+            second_wins = 0;
+        }
+    }
+
+    // The rest of the right run is already in place
+    memcpy(arr + out, first + idx, sizeof(int) * (left - idx));
+}
+
+
+void _MergeHigh(merge_state_t *state, int *arr, size_t left, size_t right)
+{
+    int *second = state->temp;
+    size_t idx = left;
+    size_t jdx = right;
+    size_t out = left + right;
+    size_t first_wins = 0;
+    size_t second_wins = 0;
+
+    memcpy(second, arr + left, sizeof(int) * right);
+
+    // The runs are merged from their ends, idx and jdx are the numbers of the elements left
+    while (0 < idx && 0 < jdx)
+    {
+        if (first_wins >= state->min_gallop || second_wins >= state->min_gallop)
+        {
+            size_t count = jdx - _Gallop(arr[idx - 1], second, jdx, jdx - 1, False);
+
+            out -= count;
+            jdx -= count;
+            memcpy(arr + out, second + jdx, sizeof(int) * count);
+            if (0 == jdx)
+            {
+                break;
+            }
+
+            size_t other = idx - _Gallop(second[jdx - 1], arr, idx, idx - 1, True);
+
+            out -= other;
+            idx -= other;
+            memmove(arr + out, arr + idx, sizeof(int) * other);
+
+            if (count < SORT_MIN_GALLOP && other < SORT_MIN_GALLOP)
+            {
+                ++state->min_gallop;
+                first_wins = 0;
+                second_wins = 0;
+            }
+            else if (1 < state->min_gallop)
+            {
+                --state->min_gallop;
+            }
+            continue;
+        }
+
+        if (second[jdx - 1] < arr[idx - 1])
+        {
+            arr[--out] = arr[--idx];
+            ++first_wins;
+            second_wins = 0;
+        }
+        else
+        {
+            arr[--out] = second[--jdx];
+            ++second_wins;
+            first_wins = 0;
+        }
+    }
+
+    // The rest of the left run is already in place
+    memcpy(arr + idx, second, sizeof(int) * jdx);
+}
+
+
+void _Reverse(int *arr, size_t size)
+{
+    for (size_t idx = 0; idx < size / 2; ++idx)
+    {
+        _Swap(&arr[idx], &arr[size - 1 - idx]);
+    }
+}
+
+
+void _SortParallel(int *arr, size_t size, int maxthreads, int is_natural)
+{
+    sort_task_t *tasks = (sort_task_t *)malloc(sizeof(sort_task_t) * maxthreads);
+    sort_task_t *merges = (sort_task_t *)malloc(sizeof(sort_task_t) * maxthreads);
+    int status = 0;
+
+    if (NULL == tasks || NULL == merges || 2 > maxthreads)
+    {
+        free(tasks);
+        free(merges);
+        _QuickSort3(arr, size);
+        return;
+    }
+
+    // Every piece is sorted by its own thread
+    for (int idx = 0; idx < maxthreads; ++idx)
+    {
+        size_t first = size * idx / maxthreads;
+
+        tasks[idx].arr = arr + first;
+        tasks[idx].size = size * (idx + 1) / maxthreads - first;
+        tasks[idx].middle = 0;
+        tasks[idx].is_natural = is_natural;
+        tasks[idx].status = 0;
+    }
+
+    RunTasks(tasks, sizeof(sort_task_t), maxthreads, _SortThread);
+
+    // The neighbouring pieces are merged pairwise, the merges of one level run in parallel
+    for (int width = 1; width < maxthreads && 0 == status; width *= 2)
+    {
+        int count = 0;
+
+        for (int idx = 0; idx + width < maxthreads; idx += 2 * width)
+        {
+            merges[count].arr = tasks[idx].arr;
+            merges[count].middle = tasks[idx].size;
+            merges[count].size = tasks[idx].size + tasks[idx + width].size;
+            merges[count].status = 0;
+            tasks[idx].size = merges[count].size;
+            ++count;
+        }
+
+        RunTasks(merges, sizeof(sort_task_t), count, _SortThread);
+
+        for (int idx = 0; idx < count; ++idx)
+        {
+            status |= merges[idx].status;
+        }
+    }
+
+    free(tasks);
+    free(merges);
+
+    // A failed merge leaves the elements in the array, only unsorted
+    if (0 != status)
+    {
+        _QuickSort3(arr, size);
+    }
+}
+
+
+void RunTasks(void *tasks, size_t task_size, int count, void *(*routine)(void *))
+{
+    pthread_t *threads = (pthread_t *)malloc(sizeof(pthread_t) * count);
+    int *is_created = (int *)calloc(count, sizeof(int));
+    char *task = (char *)tasks;
+
+    // The calling thread takes the first task, a task without its thread is run inline
+    for (int idx = 1; idx < count; ++idx)
+    {
+        if (NULL != threads && NULL != is_created)
+        {
+            is_created[idx] = (0 == pthread_create(&threads[idx], NULL, routine, task + task_size * idx));
+        }
+
+        if (NULL == is_created || False == is_created[idx])
+        {
+            routine(task + task_size * idx);
+        }
+    }
+
+    if (0 < count)
+    {
+        routine(task);
+    }
+
+    for (int idx = 1; idx < count && NULL != is_created; ++idx)
+    {
+        if (True == is_created[idx])
+        {
+            pthread_join(threads[idx], NULL);
+        }
+    }
+
+    free(threads);
+    free(is_created);
+}
+
+
+void *_SortThread(void *sort_task)
+{
+    sort_task_t *task = (sort_task_t *)sort_task;
+
+    if (0 != task->middle)
+    {
+        merge_state_t state = {NULL, 0, SORT_MIN_GALLOP, {0}, {0}, 0};
+
+        task->status = _MergeRanges(&state, task->arr, task->middle, task->size - task->middle);
+        free(state.temp);
+    }
+    else if (True == task->is_natural)
+    {
+        task->status = _NaturalMergeSort(task->arr, task->size);
+    }
+    else
+    {
+        Sort(task->arr, task->size, 1, NULL);
+    }
+
+    return NULL;
+}
+
+
+void ParallelCountingSort(int *arr, size_t size, int maxthreads)
+{
+    // A histogram that does not fit into the cache loses to the comparison sorts
+    if (0 != _ParallelCountingSort(arr, size, maxthreads))
+    {
+        Sort(arr, size, maxthreads, NULL);
+    }
+}
+
+
+int _ParallelCountingSort(int *arr, size_t size, int maxthreads)
+{
+    counting_task_t *tasks = NULL;
+    size_t *counts = NULL;
+    int min = 0;
+    int max = 0;
+    size_t range = 0;
+
+    if (0 == size)
+    {
+        return 0;
+    }
+
+    if (1 > maxthreads || size < (size_t)maxthreads * SORT_COUNTING_PIECE)
+    {
+        maxthreads = 1 + size / SORT_COUNTING_PIECE;
+        maxthreads = (SORT_MAX_THREADS < maxthreads) ? SORT_MAX_THREADS : maxthreads;
+    }
+
+    tasks = (counting_task_t *)malloc(sizeof(counting_task_t) * maxthreads);
+    if (NULL == tasks)
+    {
+        return 1;
+    }
+
+    // Every thread finds the minimum and the maximum of its piece
+    for (int idx = 0; idx < maxthreads; ++idx)
+    {
+        size_t first = size * idx / maxthreads;
+
+        tasks[idx].arr = arr + first;
+        tasks[idx].size = size * (idx + 1) / maxthreads - first;
+        tasks[idx].phase = SORT_PHASE_RANGE;
+    }
+
+    RunTasks(tasks, sizeof(counting_task_t), maxthreads, _CountingThread);
+
+    min = tasks[0].min;
+    max = tasks[0].max;
+    for (int idx = 1; idx < maxthreads; ++idx)
+    {
+        min = (tasks[idx].min < min) ? tasks[idx].min : min;
+        max = (tasks[idx].max > max) ? tasks[idx].max : max;
+    }
+
+    if ((int64_t)max - min + 1 > SORT_COUNTING_CACHE / (int64_t)sizeof(size_t))
+    {
+        free(tasks);
+        return 1;
+    }
+
+    range = (size_t)((int64_t)max - min + 1);
+    counts = (size_t *)calloc(range * maxthreads, sizeof(size_t));
+    if (NULL == counts)
+    {
+        free(tasks);
+        return 1;
+    }
+
+    // Every thread counts its piece into its own histogram, so that no counter is shared
+    for (int idx = 0; idx < maxthreads; ++idx)
+    {
+        tasks[idx].min = min;
+        tasks[idx].counts = counts + range * idx;
+        tasks[idx].phase = SORT_PHASE_COUNT;
+    }
+
+    RunTasks(tasks, sizeof(counting_task_t), maxthreads, _CountingThread);
+
+    for (int idx = 1; idx < maxthreads; ++idx)
+    {
+        for (size_t value = 0; value < range; ++value)
+        {
+            counts[value] += tasks[idx].counts[value];
+        }
+    }
+
+    // The values are split between the threads so that every thread writes about the same number of elements
+    size_t out = 0;
+    size_t value = 0;
+    for (int idx = 0; idx < maxthreads; ++idx)
+    {
+        size_t goal = size * (idx + 1) / maxthreads;
+
+        tasks[idx].arr = arr + out;
+        tasks[idx].counts = counts;
+        tasks[idx].first = value;
+        while (value < range && (out < goal || idx + 1 == maxthreads))
+        {
+            out += counts[value++];
+        }
+        tasks[idx].last = value;
+        tasks[idx].phase = SORT_PHASE_FILL;
+    }
+
+    RunTasks(tasks, sizeof(counting_task_t), maxthreads, _CountingThread);
+
+    free(counts);
+    free(tasks);
+    return 0;
+}
+
+
+void _MinMax(const int *arr, size_t size, int *min, int *max)
+{
+    size_t idx = 0;
+    int low = arr[0];
+    int high = arr[0];
+
+#ifdef __SSE2__
+    // SSE2 has no signed minimum of 32 bits, so the lanes are selected by the masks of the comparisons
+    if (4 <= size)
+    {
+        __m128i lows = _mm_loadu_si128((const __m128i *)arr);
+        __m128i highs = lows;
+        int lanes[4];
+
+        for (idx = 4; idx + 4 <= size; idx += 4)
+        {
+            __m128i values = _mm_loadu_si128((const __m128i *)(arr + idx));
+            __m128i less = _mm_cmplt_epi32(values, lows);
+            __m128i greater = _mm_cmpgt_epi32(values, highs);
+
+            lows = _mm_or_si128(_mm_and_si128(less, values), _mm_andnot_si128(less, lows));
+            highs = _mm_or_si128(_mm_and_si128(greater, values), _mm_andnot_si128(greater, highs));
+        }
+
+        _mm_storeu_si128((__m128i *)lanes, lows);
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            low = (lanes[lane] < low) ? lanes[lane] : low;
+        }
+
+        _mm_storeu_si128((__m128i *)lanes, highs);
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            high = (lanes[lane] > high) ? lanes[lane] : high;
+        }
+    }
+#endif
+
+    for ( ; idx < size; ++idx)
+    {
+        low = (arr[idx] < low) ? arr[idx] : low;
+        high = (arr[idx] > high) ? arr[idx] : high;
+    }
+
+    *min = low;
+    *max = high;
+}
+
+
+void _Fill(int *arr, int value, size_t count)
+{
+    size_t idx = 0;
+
+#ifdef __SSE2__
+    __m128i values = _mm_set1_epi32(value);
+
+    for ( ; idx + 4 <= count; idx += 4)
+    {
+        _mm_storeu_si128((__m128i *)(arr + idx), values);
+    }
+#endif
+
+    for ( ; idx < count; ++idx)
+    {
+        arr[idx] = value;
+    }
+}
+
+
+void *_CountingThread(void *counting_task)
+{
+    counting_task_t *task = (counting_task_t *)counting_task;
+
+    switch (task->phase)
+    {
+        case SORT_PHASE_RANGE:
+            if (0 != task->size)
+            {
+                _MinMax(task->arr, task->size, &task->min, &task->max);
+            }
+            else
+            {
+                task->min = INT32_MAX;
+                task->max = INT32_MIN;
+            }
+            break;
+
+        case SORT_PHASE_COUNT:
+            for (size_t idx = 0; idx < task->size; ++idx)
+            {
+                ++task->counts[(int64_t)task->arr[idx] - task->min];
+            }
+            break;
+
+        default:
+            for (size_t value = task->first, out = 0; value < task->last; ++value)
+            {
+                _Fill(task->arr + out, (int)((int64_t)value + task->min), task->counts[value]);
+                out += task->counts[value];
+            }
+            break;
+    }
+
+    return NULL;
+}
+
+
+void SegmentedSort(int *arr, const size_t *offsets, size_t nsegments, int maxthreads)
+{
+    segment_task_t *tasks = NULL;
+    size_t total = 0;
+    size_t first = 0;
+
+    if (0 == nsegments)
+    {
+        return;
+    }
+
+    total = offsets[nsegments] - offsets[0];
+    if (1 > maxthreads || total < (size_t)maxthreads * SORT_COUNTING_PIECE)
+    {
+        maxthreads = 1 + total / SORT_COUNTING_PIECE;
+        maxthreads = (SORT_MAX_THREADS < maxthreads) ? SORT_MAX_THREADS : maxthreads;
+    }
+
+    tasks = (segment_task_t *)malloc(sizeof(segment_task_t) * maxthreads);
+    if (NULL == tasks)
+    {
+        _SortSegments(arr, offsets, 0, nsegments);
+        return;
+    }
+
+    // The segments are split between the threads by their elements, not by their number
+    for (int idx = 0; idx < maxthreads; ++idx)
+    {
+        size_t goal = offsets[0] + total * (idx + 1) / maxthreads;
+        size_t last = first;
+        size_t high = nsegments;
+
+        while (last < high)
+        {
+            size_t middle = last + (high - last) / 2;
+
+            if (offsets[middle + 1] <= goal)
+            {
+                last = middle + 1;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+
+        if (idx + 1 == maxthreads)
+        {
+            last = nsegments;
+        }
+
+        tasks[idx].arr = arr;
+        tasks[idx].offsets = offsets;
+        tasks[idx].first = first;
+        tasks[idx].last = last;
+        first = last;
+    }
+
+    RunTasks(tasks, sizeof(segment_task_t), maxthreads, _SegmentThread);
+    free(tasks);
+}
+
+
+void _SortSegments(int *arr, const size_t *offsets, size_t first, size_t last)
+{
+    size_t batch[SORT_NETWORK_LANES];
+    size_t count = 0;
+
+    for (size_t segment = first; segment < last; ++segment)
+    {
+        size_t size = offsets[segment + 1] - offsets[segment];
+
+        // The tiny segments wait until a whole batch of them can go through the network together
+        if (size < 2)
+        {
+            continue;
+        }
+        else if (size <= SORT_NETWORK)
+        {
+            batch[count++] = segment;
+            if (SORT_NETWORK_LANES == count)
+            {
+                _NetworkSort(arr, offsets, batch, count);
+                count = 0;
+            }
+        }
+        else if (size <= SORT_SEGMENT_SMALL)
+        {
+            InsertionSort(arr + offsets[segment], size);
+        }
+        else if (size <= SORT_SAMPLE * SORT_SAMPLE_RATIO)
+        {
+            // Sampling costs as much as sorting a segment of about the size of the sample
+            _QuickSort3(arr + offsets[segment], size);
+        }
+        else
+        {
+            Sort(arr + offsets[segment], size, 1, NULL);
+        }
+    }
+
+    if (0 != count)
+    {
+        _NetworkSort(arr, offsets, batch, count);
+    }
+}
+
+
+void _NetworkSort(int *arr, const size_t *offsets, const size_t *batch, size_t count)
+{
+    // Batcher's odd-even merge sort of 8 inputs
+    static const unsigned char network[][2] = 
+    {
+        {0, 1}, {2, 3}, {4, 5}, {6, 7}, {0, 2}, {1, 3}, {4, 6}, {5, 7}, {1, 2}, {5, 6},
+        {0, 4}, {1, 5}, {2, 6}, {3, 7}, {2, 4}, {3, 5}, {1, 2}, {3, 4}, {5, 6}
+    };
+    int lanes[SORT_NETWORK][SORT_NETWORK_LANES];
+
+    // Every segment is a lane, the rows are the positions, the shorter segments are padded by the maximum
+    for (size_t row = 0; row < SORT_NETWORK; ++row)
+    {
+        for (size_t lane = 0; lane < SORT_NETWORK_LANES; ++lane)
+        {
+            lanes[row][lane] = INT32_MAX;
+        }
+    }
+
+    for (size_t lane = 0; lane < count; ++lane)
+    {
+        size_t size = offsets[batch[lane] + 1] - offsets[batch[lane]];
+
+        for (size_t row = 0; row < size; ++row)
+        {
+            lanes[row][lane] = arr[offsets[batch[lane]] + row];
+        }
+    }
+
+#ifdef __SSE2__
+    __m128i rows[SORT_NETWORK];
+
+    for (size_t row = 0; row < SORT_NETWORK; ++row)
+    {
+        rows[row] = _mm_loadu_si128((const __m128i *)lanes[row]);
+    }
+
+    // A comparator orders the same two positions of all the segments at once
+    for (size_t idx = 0; idx < sizeof(network) / sizeof(network[0]); ++idx)
+    {
+        __m128i first = rows[network[idx][0]];
+        __m128i second = rows[network[idx][1]];
+        __m128i less = _mm_cmplt_epi32(second, first);
+
+        rows[network[idx][0]] = _mm_or_si128(_mm_and_si128(less, second), _mm_andnot_si128(less, first));
+        rows[network[idx][1]] = _mm_or_si128(_mm_and_si128(less, first), _mm_andnot_si128(less, second));
+    }
+
+    for (size_t row = 0; row < SORT_NETWORK; ++row)
+    {
+        _mm_storeu_si128((__m128i *)lanes[row], rows[row]);
+    }
+#else
+    for (size_t idx = 0; idx < sizeof(network) / sizeof(network[0]); ++idx)
+    {
+        int *first = lanes[network[idx][0]];
+        int *second = lanes[network[idx][1]];
+
+        for (size_t lane = 0; lane < SORT_NETWORK_LANES; ++lane)
+        {
+            int low = (second[lane] < first[lane]) ? second[lane] : first[lane];
+            int high = (second[lane] < first[lane]) ? first[lane] : second[lane];
+
+            first[lane] = low;
+            second[lane] = high;
+        }
+    }
+#endif
+
+    // The padding sorts to the end, so only the first values of a lane are written back
+    for (size_t lane = 0; lane < count; ++lane)
+    {
+        size_t size = offsets[batch[lane] + 1] - offsets[batch[lane]];
+
+        for (size_t row = 0; row < size; ++row)
+        {
+            arr[offsets[batch[lane]] + row] = lanes[row][lane];
+        }
+    }
+}
+
+
+void *_SegmentThread(void *segment_task)
+{
+    segment_task_t *task = (segment_task_t *)segment_task;
+
+    _SortSegments(task->arr, task->offsets, task->first, task->last);
+    return NULL;
+}
+
+
+int ChooseSplitters(const int *arr, size_t size, int *splitters, size_t nbuckets)
+{
+    size_t count = (SORT_SAMPLE < nbuckets * SORT_OVERSAMPLING) ? nbuckets * SORT_OVERSAMPLING : SORT_SAMPLE;
+    int *sample = NULL;
+
+    if (1 > nbuckets)
+    {
+        return 1;
+    }
+
+    if (0 == size)
+    {
+        memset(splitters, 0, sizeof(int) * (nbuckets - 1));
+        return 0;
+    }
+
+    count = (size < count) ? size : count;
+    sample = (int *)malloc(sizeof(int) * count);
+    if (NULL == sample)
+    {
+        return 1;
+    }
+
+    // The sample is spread regularly over the array, the middles of count equal strides
+    for (size_t idx = 0; idx < count; ++idx)
+    {
+        sample[idx] = arr[(2 * idx + 1) * size / (2 * count)];
+    }
+
+    _QuickSort3(sample, count);
+    for (size_t bucket = 1; bucket < nbuckets; ++bucket)
+    {
+        splitters[bucket - 1] = sample[bucket * count / nbuckets];
+    }
+
+    free(sample);
+    return 0;
+}
+
+
+int RangePartition(const int *arr, size_t size, int *out, const int *splitters, size_t nbuckets, size_t *offsets, int maxthreads)
+{
+    partition_task_t *tasks = NULL;
+    size_t *counts = NULL;
+    uint16_t *oracle = NULL;
+    int tree[SORT_MAX_BUCKETS];
+    int levels = 0;
+    size_t next = 0;
+    size_t position = 0;
+
+    if (1 > nbuckets || SORT_MAX_BUCKETS < nbuckets)
+    {
+        return 1;
+    }
+
+    if (1 > maxthreads || size < (size_t)maxthreads * SORT_COUNTING_PIECE)
+    {
+        maxthreads = 1 + size / SORT_COUNTING_PIECE;
+        maxthreads = (SORT_MAX_THREADS < maxthreads) ? SORT_MAX_THREADS : maxthreads;
+    }
+
+    tasks = (partition_task_t *)malloc(sizeof(partition_task_t) * maxthreads);
+    counts = (size_t *)calloc(nbuckets * maxthreads, sizeof(size_t));
+    oracle = (uint16_t *)malloc(sizeof(uint16_t) * size + 1);
+    if (NULL == tasks || NULL == counts || NULL == oracle)
+    {
+        free(tasks);
+        free(counts);
+        free(oracle);
+        return 1;
+    }
+
+    // The splitters padded by the largest value to a power of two minus one form a search tree in level order
+    while (((size_t)1 << levels) < nbuckets)
+    {
+        ++levels;
+    }
+    _BuildTree(tree, splitters, nbuckets - 1, 1, ((size_t)1 << levels) - 1, &next);
+
+    // Every thread classifies its piece into its own histogram and remembers the bucket of every value
+    for (int idx = 0; idx < maxthreads; ++idx)
+    {
+        size_t first = size * idx / maxthreads;
+
+        tasks[idx].arr = arr + first;
+        tasks[idx].size = size * (idx + 1) / maxthreads - first;
+        tasks[idx].out = out;
+        tasks[idx].tree = tree;
+        tasks[idx].levels = levels;
+        tasks[idx].nbuckets = nbuckets;
+        tasks[idx].oracle = oracle + first;
+        tasks[idx].counts = counts + nbuckets * idx;
+        tasks[idx].phase = SORT_PHASE_COUNT;
+    }
+
+    RunTasks(tasks, sizeof(partition_task_t), maxthreads, _PartitionThread);
+
+    // A bucket is laid out thread after thread, so the scatter keeps the order of equal values
+    for (size_t bucket = 0; bucket < nbuckets; ++bucket)
+    {
+        offsets[bucket] = position;
+        for (int idx = 0; idx < maxthreads; ++idx)
+        {
+            size_t count = tasks[idx].counts[bucket];
+
+            tasks[idx].counts[bucket] = position;
+            position += count;
+        }
+    }
+    offsets[nbuckets] = position;
+
+    for (int idx = 0; idx < maxthreads; ++idx)
+    {
+        tasks[idx].phase = SORT_PHASE_SCATTER;
+    }
+
+    RunTasks(tasks, sizeof(partition_task_t), maxthreads, _PartitionThread);
+
+    free(oracle);
+    free(counts);
+    free(tasks);
+    return 0;
+}
+
+
+void _BuildTree(int *tree, const int *splitters, size_t nsplitters, size_t node, size_t nnodes, size_t *next)
+{
+    // The in-order walk of the tree visits the splitters in ascending order
+    if (node > nnodes)
+    {
+        return;
+    }
+
+    _BuildTree(tree, splitters, nsplitters, 2 * node, nnodes, next);
+    tree[node] = (*next < nsplitters) ? splitters[*next] : INT_MAX;
+    ++*next;
+    _BuildTree(tree, splitters, nsplitters, 2 * node + 1, nnodes, next);
+}
+
+
+void _Classify(partition_task_t *task)
+{
+    const int *arr = task->arr;
+    const int *tree = task->tree;
+    size_t base = (size_t)1 << task->levels;
+    size_t last = task->nbuckets - 1;
+    size_t idx = 0;
+
+    // Four values descend the tree together, a step is a comparison turned into the next index
+    for ( ; idx + 4 <= task->size; idx += 4)
+    {
+        size_t node0 = 1;
+        size_t node1 = 1;
+        size_t node2 = 1;
+        size_t node3 = 1;
+
+        for (int level = 0; level < task->levels; ++level)
+        {
+            node0 = 2 * node0 + (arr[idx] >= tree[node0]);
+            node1 = 2 * node1 + (arr[idx + 1] >= tree[node1]);
+            node2 = 2 * node2 + (arr[idx + 2] >= tree[node2]);
+            node3 = 2 * node3 + (arr[idx + 3] >= tree[node3]);
+        }
+
+        // Only the largest value passes the padding, it belongs to the last bucket
+        node0 = (node0 - base < last) ? node0 - base : last;
+        node1 = (node1 - base < last) ? node1 - base : last;
+        node2 = (node2 - base < last) ? node2 - base : last;
+        node3 = (node3 - base < last) ? node3 - base : last;
+
+        task->oracle[idx] = (uint16_t)node0;
+        task->oracle[idx + 1] = (uint16_t)node1;
+        task->oracle[idx + 2] = (uint16_t)node2;
+        task->oracle[idx + 3] = (uint16_t)node3;
+        ++task->counts[node0];
+        ++task->counts[node1];
+        ++task->counts[node2];
+        ++task->counts[node3];
+    }
+
+    for ( ; idx < task->size; ++idx)
+    {
+        size_t node = 1;
+
+        for (int level = 0; level < task->levels; ++level)
+        {
+            node = 2 * node + (arr[idx] >= tree[node]);
+        }
+
+        node = (node - base < last) ? node - base : last;
+        task->oracle[idx] = (uint16_t)node;
+        ++task->counts[node];
+    }
+}
+
+
+void *_PartitionThread(void *partition_task)
+{
+    partition_task_t *task = (partition_task_t *)partition_task;
+
+    if (SORT_PHASE_COUNT == task->phase)
+    {
+        _Classify(task);
+    }
+    else
+    {
+        for (size_t idx = 0; idx < task->size; ++idx)
+        {
+            task->out[task->counts[task->oracle[idx]]++] = task->arr[idx];
+        }
+    }
+
+    return NULL;
+}
+
+
+size_t SetIntersection(const int *a, size_t asize, const int *b, size_t bsize, int *out, int maxthreads)
+{
+    return _SetOperation(a, asize, b, bsize, out, SORT_SET_INTERSECTION, maxthreads);
+}
+
+
+size_t SetUnion(const int *a, size_t asize, const int *b, size_t bsize, int *out, int maxthreads)
+{
+    return _SetOperation(a, asize, b, bsize, out, SORT_SET_UNION, maxthreads);
+}
+
+
+size_t SetDifference(const int *a, size_t asize, const int *b, size_t bsize, int *out, int maxthreads)
+{
+    return _SetOperation(a, asize, b, bsize, out, SORT_SET_DIFFERENCE, maxthreads);
+}
+
+
+size_t MergeJoin(const int *a, size_t asize, const int *b, size_t bsize, size_t *left, size_t *right, size_t capacity, int maxthreads)
+{
+    set_task_t *tasks = NULL;
+    size_t position = 0;
+
+    maxthreads = _SetThreads(asize + bsize, maxthreads);
+    tasks = (1 < maxthreads) ? (set_task_t *)malloc(sizeof(set_task_t) * maxthreads) : NULL;
+    if (NULL == tasks)
+    {
+        return _Join(a, asize, b, bsize, 0, 0, left, right, capacity);
+    }
+
+    // The pieces count their pairs first, so that every piece knows where its pairs go
+    _SplitSets(tasks, a, asize, b, bsize, SORT_SET_JOIN, maxthreads);
+    RunTasks(tasks, sizeof(set_task_t), maxthreads, _SetThread);
+
+    for (int idx = 0; idx < maxthreads; ++idx)
+    {
+        tasks[idx].left = left;
+        tasks[idx].right = right;
+        tasks[idx].capacity = capacity;
+        tasks[idx].position = position;
+        tasks[idx].phase = SORT_PHASE_SCATTER;
+        position += tasks[idx].count;
+    }
+
+    RunTasks(tasks, sizeof(set_task_t), maxthreads, _SetThread);
+
+    free(tasks);
+    return position;
+}
+
+
+size_t _SetOperation(const int *a, size_t asize, const int *b, size_t bsize, int *out, int operation, int maxthreads)
+{
+    set_task_t *tasks = NULL;
+    size_t position = 0;
+    int is_allocated = True;
+
+    maxthreads = _SetThreads(asize + bsize, maxthreads);
+    tasks = (1 < maxthreads) ? (set_task_t *)malloc(sizeof(set_task_t) * maxthreads) : NULL;
+    if (NULL == tasks)
+    {
+        return _SetKernel(a, asize, b, bsize, out, operation);
+    }
+
+    // The pieces write into their own buffers, their sizes are known only afterwards
+    _SplitSets(tasks, a, asize, b, bsize, operation, maxthreads);
+    RunTasks(tasks, sizeof(set_task_t), maxthreads, _SetThread);
+
+    for (int idx = 0; idx < maxthreads; ++idx)
+    {
+        is_allocated = is_allocated && (NULL != tasks[idx].out);
+        tasks[idx].dest = out + position;
+        tasks[idx].phase = SORT_PHASE_SCATTER;
+        position += tasks[idx].count;
+    }
+
+    if (True == is_allocated)
+    {
+        RunTasks(tasks, sizeof(set_task_t), maxthreads, _SetThread);
+    }
+    else
+    {
+        position = _SetKernel(a, asize, b, bsize, out, operation);
+    }
+
+    for (int idx = 0; idx < maxthreads; ++idx)
+    {
+        free(tasks[idx].out);
+    }
+
+    free(tasks);
+    return position;
+}
+
+
+int _SetThreads(size_t total, int maxthreads)
+{
+    if (1 > maxthreads || total < (size_t)maxthreads * SORT_COUNTING_PIECE)
+    {
+        maxthreads = 1 + total / SORT_COUNTING_PIECE;
+        maxthreads = (SORT_MAX_THREADS < maxthreads) ? SORT_MAX_THREADS : maxthreads;
+    }
+
+    return maxthreads;
+}
+
+
+void _SplitSets(set_task_t *tasks, const int *a, size_t asize, const int *b, size_t bsize, int operation, int maxthreads)
+{
+    size_t afirst = 0;
+    size_t bfirst = 0;
+
+    for (int idx = 0; idx < maxthreads; ++idx)
+    {
+        size_t diag = (asize + bsize) * (idx + 1) / maxthreads;
+        size_t alast = asize;
+        size_t blast = bsize;
+
+        // The co-rank splits the merged order evenly, moving it down to the first copy of its value keeps equal values in one piece
+        if (idx + 1 < maxthreads)
+        {
+            size_t arank = _CoRank(diag, a, asize, b, bsize);
+            size_t brank = diag - arank;
+            int value = (arank < asize && (brank == bsize || a[arank] <= b[brank])) ? a[arank] : b[brank];
+
+            alast = _Gallop(value, a, asize, arank - (arank == asize), False);
+            blast = _Gallop(value, b, bsize, brank - (brank == bsize), False);
+            alast = (alast < afirst) ? afirst : alast;
+            blast = (blast < bfirst) ? bfirst : blast;
+        }
+
+        tasks[idx].a = a + afirst;
+        tasks[idx].asize = alast - afirst;
+        tasks[idx].b = b + bfirst;
+        tasks[idx].bsize = blast - bfirst;
+        tasks[idx].afirst = afirst;
+        tasks[idx].bfirst = bfirst;
+        tasks[idx].out = NULL;
+        tasks[idx].left = NULL;
+        tasks[idx].right = NULL;
+        tasks[idx].capacity = 0;
+        tasks[idx].position = 0;
+        tasks[idx].count = 0;
+        tasks[idx].operation = operation;
+        tasks[idx].phase = SORT_PHASE_COUNT;
+        afirst = alast;
+        bfirst = blast;
+    }
+}
+
+
+size_t _CoRank(size_t diag, const int *a, size_t asize, const int *b, size_t bsize)
+{
+    size_t low = (diag > bsize) ? diag - bsize : 0;
+    size_t high = (diag < asize) ? diag : asize;
+
+    // The first diag elements of the merge take arank from a, a goes first among equal values
+    while (low < high)
+    {
+        size_t arank = low + (high - low) / 2;
+
+        if (a[arank] <= b[diag - arank - 1])
+        {
+            low = arank + 1;
+        }
+        else
+        {
+            high = arank;
+        }
+    }
+
+    return low;
+}
+
+
+void *_SetThread(void *set_task)
+{
+    set_task_t *task = (set_task_t *)set_task;
+    size_t bound = task->asize;
+
+    if (SORT_SET_JOIN == task->operation)
+    {
+        // The pairs beyond the capacity are only counted
+        size_t capacity = (task->position < task->capacity) ? task->capacity - task->position : 0;
+        size_t *left = (0 != capacity) ? task->left + task->position : NULL;
+        size_t *right = (0 != capacity) ? task->right + task->position : NULL;
+
+        task->count = _Join(task->a, task->asize, task->b, task->bsize, task->afirst, task->bfirst, left, right, capacity);
+    }
+    else if (SORT_PHASE_COUNT == task->phase)
+    {
+        bound = (SORT_SET_UNION == task->operation) ? task->asize + task->bsize : bound;
+        bound = (SORT_SET_INTERSECTION == task->operation && task->bsize < bound) ? task->bsize : bound;
+        // One int more, so an empty piece still gets a buffer
+        task->out = (int *)malloc(sizeof(int) * (bound + 1));
+        if (NULL != task->out)
+        {
+            task->count = _SetKernel(task->a, task->asize, task->b, task->bsize, task->out, task->operation);
+        }
+    }
+    else if (0 != task->count)
+    {
+        memcpy(task->dest, task->out, sizeof(int) * task->count);
+    }
+
+    return NULL;
+}
+
+
+size_t _SetKernel(const int *a, size_t asize, const int *b, size_t bsize, int *out, int operation)
+{
+    switch (operation)
+    {
+        case SORT_SET_INTERSECTION:
+            return _Intersect(a, asize, b, bsize, out);
+
+        case SORT_SET_UNION:
+            return _Unite(a, asize, b, bsize, out);
+
+        default:
+            return _Subtract(a, asize, b, bsize, out);
+    }
+}
+
+
+size_t _Intersect(const int *a, size_t asize, const int *b, size_t bsize, int *out)
+{
+    size_t idx = 0;
+    size_t jdx = 0;
+    size_t count = 0;
+
+    // A few values against many are searched for, the merge would walk the whole larger set
+    if (asize * SORT_SET_SKEW < bsize)
+    {
+        return _IntersectGallop(a, asize, b, bsize, out);
+    }
+
+    if (bsize * SORT_SET_SKEW < asize)
+    {
+        return _IntersectGallop(b, bsize, a, asize, out);
+    }
+
+#ifdef __SSE2__
+    size_t capacity = (asize < bsize) ? asize : bsize;
+
+    // Four values of a are compared with the four rotations of four values of b, the block with the smaller last value moves on
+    while (idx + 4 <= asize && jdx + 4 <= bsize)
+    {
+        __m128i values = _mm_loadu_si128((const __m128i *)(a + idx));
+        __m128i others = _mm_loadu_si128((const __m128i *)(b + jdx));
+        __m128i equal = _mm_cmpeq_epi32(values, others);
+        int amax = a[idx + 3];
+        int bmax = b[jdx + 3];
+
+        equal = _mm_or_si128(equal, _mm_cmpeq_epi32(values, _mm_shuffle_epi32(others, _MM_SHUFFLE(0, 3, 2, 1))));
+        equal = _mm_or_si128(equal, _mm_cmpeq_epi32(values, _mm_shuffle_epi32(others, _MM_SHUFFLE(1, 0, 3, 2))));
+        equal = _mm_or_si128(equal, _mm_cmpeq_epi32(values, _mm_shuffle_epi32(others, _MM_SHUFFLE(2, 1, 0, 3))));
+
+        // The matches of a block that stays may use up the room of the next four, so near the end of out only the matched lanes are stored
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(equal));
+        if (count + 4 <= capacity)
+        {
+            out[count] = a[idx + set_lanes[mask][0]];
+            out[count + 1] = a[idx + set_lanes[mask][1]];
+            out[count + 2] = a[idx + set_lanes[mask][2]];
+            out[count + 3] = a[idx + set_lanes[mask][3]];
+        }
+        else
+        {
+            for (int lane = 0; lane < set_lanes[mask][4]; ++lane)
+            {
+                out[count + lane] = a[idx + set_lanes[mask][lane]];
+            }
+        }
+        count += set_lanes[mask][4];
+
+        idx += (amax <= bmax) * 4;
+        jdx += (bmax <= amax) * 4;
+    }
+#endif
+
+    while (idx < asize && jdx < bsize)
+    {
+        int first = a[idx];
+        int second = b[jdx];
+
+        if (first == second)
+        {
+            out[count++] = first;
+        }
+
+        idx += (first <= second);
+        jdx += (second <= first);
+    }
+
+    return count;
+}
+
+
+size_t _IntersectGallop(const int *small, size_t small_size, const int *large, size_t large_size, int *out)
+{
+    size_t position = 0;
+    size_t count = 0;
+
+    for (size_t idx = 0; idx < small_size && position < large_size; ++idx)
+    {
+        position += _Gallop(small[idx], large + position, large_size - position, 0, False);
+        if (position < large_size && large[position] == small[idx])
+        {
+            out[count++] = small[idx];
+            ++position;
+        }
+    }
+
+    return count;
+}
+
+
+size_t _Unite(const int *a, size_t asize, const int *b, size_t bsize, int *out)
+{
+    size_t idx = 0;
+    size_t jdx = 0;
+    size_t count = 0;
+
+    // The runs of the larger set between two values of the smaller one are copied whole
+    if (asize * SORT_SET_SKEW < bsize || bsize * SORT_SET_SKEW < asize)
+    {
+        const int *small = (asize < bsize) ? a : b;
+        const int *large = (asize < bsize) ? b : a;
+        size_t small_size = (asize < bsize) ? asize : bsize;
+        size_t large_size = (asize < bsize) ? bsize : asize;
+
+        for ( ; idx < small_size; ++idx)
+        {
+            size_t position = jdx + _Gallop(small[idx], large + jdx, large_size - jdx, 0, False);
+
+            memcpy(out + count, large + jdx, sizeof(int) * (position - jdx));
+            count += position - jdx;
+            out[count++] = small[idx];
+            jdx = position + (position < large_size && large[position] == small[idx]);
+        }
+
+        memcpy(out + count, large + jdx, sizeof(int) * (large_size - jdx));
+        return count + large_size - jdx;
+    }
+
+    // The smaller head goes out, both move on if they are equal, without a branch on the values
+    while (idx < asize && jdx < bsize)
+    {
+        int first = a[idx];
+        int second = b[jdx];
+
+        out[count++] = (first <= second) ? first : second;
+        idx += (first <= second);
+        jdx += (second <= first);
+    }
+
+    memcpy(out + count, a + idx, sizeof(int) * (asize - idx));
+    count += asize - idx;
+    memcpy(out + count, b + jdx, sizeof(int) * (bsize - jdx));
+    return count + bsize - jdx;
+}
+
+
+size_t _Subtract(const int *a, size_t asize, const int *b, size_t bsize, int *out)
+{
+    size_t idx = 0;
+    size_t jdx = 0;
+    size_t count = 0;
+    int matched = 0;
+
+    // Few values of a are looked up in b, the others are copied whole
+    if (asize * SORT_SET_SKEW < bsize)
+    {
+        for ( ; idx < asize; ++idx)
+        {
+            jdx += _Gallop(a[idx], b + jdx, bsize - jdx, 0, False);
+            if (jdx == bsize || b[jdx] != a[idx])
+            {
+                out[count++] = a[idx];
+            }
+        }
+
+        return count;
+    }
+
+#ifdef __SSE2__
+    // As in the intersection, but the matches of a block of a are gathered until it moves on, the rest of it goes out
+    while (idx + 4 <= asize && jdx + 4 <= bsize)
+    {
+        __m128i values = _mm_loadu_si128((const __m128i *)(a + idx));
+        __m128i others = _mm_loadu_si128((const __m128i *)(b + jdx));
+        __m128i equal = _mm_cmpeq_epi32(values, others);
+        int amax = a[idx + 3];
+        int bmax = b[jdx + 3];
+
+        equal = _mm_or_si128(equal, _mm_cmpeq_epi32(values, _mm_shuffle_epi32(others, _MM_SHUFFLE(0, 3, 2, 1))));
+        equal = _mm_or_si128(equal, _mm_cmpeq_epi32(values, _mm_shuffle_epi32(others, _MM_SHUFFLE(1, 0, 3, 2))));
+        equal = _mm_or_si128(equal, _mm_cmpeq_epi32(values, _mm_shuffle_epi32(others, _MM_SHUFFLE(2, 1, 0, 3))));
+        matched |= _mm_movemask_ps(_mm_castsi128_ps(equal));
+
+        if (amax <= bmax)
+        {
+            int mask = ~matched & 15;
+
+            out[count] = a[idx + set_lanes[mask][0]];
+            out[count + 1] = a[idx + set_lanes[mask][1]];
+            out[count + 2] = a[idx + set_lanes[mask][2]];
+            out[count + 3] = a[idx + set_lanes[mask][3]];
+            count += set_lanes[mask][4];
+            matched = 0;
+            idx += 4;
+        }
+
+        jdx += (bmax <= amax) * 4;
+    }
+#endif
+
+    // The values of a block left half done that already matched are skipped
+    for ( ; idx < asize; ++idx, matched >>= 1)
+    {
+        while (jdx < bsize && b[jdx] < a[idx])
+        {
+            ++jdx;
+        }
+
+        if (0 == (matched & 1) && (jdx == bsize || b[jdx] != a[idx]))
+        {
+            out[count++] = a[idx];
+        }
+    }
+
+    return count;
+}
+
+
+size_t _Join(const int *a, size_t asize, const int *b, size_t bsize, size_t afirst, size_t bfirst, 
+        size_t *left, size_t *right, size_t capacity)
+{
+    size_t idx = 0;
+    size_t jdx = 0;
+    size_t count = 0;
+    size_t written = 0;
+
+    int is_skewed = (asize * SORT_SET_SKEW < bsize || bsize * SORT_SET_SKEW < asize);
+
+    while (idx < asize && jdx < bsize)
+    {
+        int first = a[idx];
+        int second = b[jdx];
+
+        // Only the much larger side gallops, the merge steps one by one without a branch otherwise
+        if (first != second && False == is_skewed)
+        {
+            idx += (first < second);
+            jdx += (second < first);
+        }
+        else if (first < second)
+        {
+            idx += _Gallop(second, a + idx, asize - idx, 0, False);
+        }
+        else if (second < first)
+        {
+            jdx += _Gallop(first, b + jdx, bsize - jdx, 0, False);
+        }
+        else
+        {
+            // Every value of a run of equal values in a pairs up with every one of the run in b
+            size_t alast = idx + 1;
+            size_t blast = jdx + 1;
+
+            while (alast < asize && a[alast] == first)
+            {
+                ++alast;
+            }
+
+            while (blast < bsize && b[blast] == second)
+            {
+                ++blast;
+            }
+
+            for (size_t apos = idx; apos < alast && written < capacity; ++apos)
+            {
+                for (size_t bpos = jdx; bpos < blast && written < capacity; ++bpos)
+                {
+                    left[written] = afirst + apos;
+                    right[written] = bfirst + bpos;
+                    ++written;
+                }
+            }
+
+            count += (alast - idx) * (blast - jdx);
+            idx = alast;
+            jdx = blast;
+        }
+    }
+
+    return count;
+}
+
+
+void StringSort(sort_string_t *strings, size_t size, int maxthreads)
+{
+    string_task_t tasks[SORT_MAX_THREADS];
+    size_t offsets[SORT_STRING_BUCKETS + 1];
+    size_t order[SORT_STRING_BUCKETS];
+    size_t next = 0;
+    size_t depth = 0;
+
+    if (1 > maxthreads || size < (size_t)maxthreads * SORT_STRING_PIECE)
+    {
+        maxthreads = 1 + size / SORT_STRING_PIECE;
+    }
+    maxthreads = (SORT_MAX_THREADS < maxthreads) ? SORT_MAX_THREADS : maxthreads;
+
+    for (int idx = 0; idx < maxthreads; ++idx)
+    {
+        tasks[idx].strings = strings;
+        tasks[idx].offsets = offsets;
+        tasks[idx].order = order;
+        tasks[idx].next = &next;
+        tasks[idx].first = size * idx / maxthreads;
+        tasks[idx].last = size * (idx + 1) / maxthreads;
+        tasks[idx].depth = 0;
+        tasks[idx].phase = SORT_STRING_PREFIX;
+    }
+
+    // The first word of every string is cached next to its pointer, the threads load a slice each
+    RunTasks(tasks, sizeof(string_task_t), maxthreads, _StringThread);
+    if (2 > size)
+    {
+        return;
+    }
+
+    // Without the buffer of the radix passes the multikey quicksort sorts in place
+    sort_string_t *temp = (sort_string_t *)malloc(sizeof(sort_string_t) * size);
+    if (NULL == temp)
+    {
+        _MultikeyQuickSort(strings, size, 0);
+        return;
+    }
+
+    if (1 == maxthreads)
+    {
+        _StringRadixSort(strings, temp, size, 0);
+        free(temp);
+        return;
+    }
+
+    // A prefix shared by all the strings, as the scheme of URLs, is stepped over before the buckets are split
+    size_t largest = _StringCount(strings, size, depth, offsets);
+    while (0 != largest && size == offsets[largest + 1] - offsets[largest])
+    {
+        if (0 == ++depth % 8)
+        {
+            for (int idx = 0; idx < maxthreads; ++idx)
+            {
+                tasks[idx].depth = depth;
+            }
+            RunTasks(tasks, sizeof(string_task_t), maxthreads, _StringThread);
+        }
+        largest = _StringCount(strings, size, depth, offsets);
+    }
+
+    // The largest buckets are taken first, so a thread is not left with a large one at the end
+    _StringScatter(strings, temp, size, depth, offsets);
+    for (size_t bucket = 0; bucket < SORT_STRING_BUCKETS; ++bucket)
+    {
+        size_t idx = bucket;
+
+        for ( ; 0 < idx && offsets[order[idx - 1] + 1] - offsets[order[idx - 1]] < offsets[bucket + 1] - offsets[bucket]; --idx)
+        {
+            order[idx] = order[idx - 1];
+        }
+        order[idx] = bucket;
+    }
+
+    for (int idx = 0; idx < maxthreads; ++idx)
+    {
+        tasks[idx].temp = temp;
+        tasks[idx].depth = depth;
+        tasks[idx].phase = SORT_STRING_SORT;
+    }
+    RunTasks(tasks, sizeof(string_task_t), maxthreads, _StringThread);
+
+    free(temp);
+}
+
+
+void *_StringThread(void *string_task)
+{
+    string_task_t *task = (string_task_t *)string_task;
+
+    if (SORT_STRING_PREFIX == task->phase)
+    {
+        for (size_t idx = task->first; idx < task->last; ++idx)
+        {
+            task->strings[idx].prefix = _LoadPrefix(task->strings[idx].str, task->strings[idx].length, task->depth);
+        }
+        return NULL;
+    }
+
+    // The strings of bucket 0 end at the depth, they are equal and already in place
+    for (size_t idx = __atomic_fetch_add(task->next, 1, __ATOMIC_RELAXED); idx < SORT_STRING_BUCKETS; 
+            idx = __atomic_fetch_add(task->next, 1, __ATOMIC_RELAXED))
+    {
+        size_t bucket = task->order[idx];
+        size_t first = task->offsets[bucket];
+
+        if (0 != bucket)
+        {
+            _StringDescend(task->strings + first, task->temp + first, task->offsets[bucket + 1] - first, task->depth + 1);
+        }
+    }
+
+    return NULL;
+}
+
+
+uint64_t _LoadPrefix(const char *str, size_t length, size_t depth)
+{
+    uint64_t prefix = 0;
+
+    if (depth + sizeof(uint64_t) <= length)
+    {
+        memcpy(&prefix, str + depth, sizeof(uint64_t));
+        return __builtin_bswap64(prefix);
+    }
+
+    // The bytes past the end read as zeros, the lengths tell such strings apart
+    for (size_t idx = 0; idx < sizeof(uint64_t); ++idx)
+    {
+        prefix = (prefix << 8) | ((depth + idx < length) ? (unsigned char)str[depth + idx] : 0);
+    }
+
+    return prefix;
+}
+
+
+size_t _StringCount(const sort_string_t *strings, size_t size, size_t depth, size_t *offsets)
+{
+    size_t counts[SORT_STRING_BUCKETS] = {0};
+    size_t largest = 0;
+    int shift = 56 - 8 * (depth % 8);
+
+    // Bucket 0 holds the strings that end before the depth, the byte b goes to the bucket b + 1
+    for (size_t idx = 0; idx < size; ++idx)
+    {
+        ++counts[(strings[idx].length <= depth) ? 0 : 1 + ((strings[idx].prefix >> shift) & 0xFF)];
+    }
+
+    offsets[0] = 0;
+    for (size_t bucket = 0; bucket < SORT_STRING_BUCKETS; ++bucket)
+    {
+        offsets[bucket + 1] = offsets[bucket] + counts[bucket];
+        largest = (counts[bucket] > counts[largest]) ? bucket : largest;
+    }
+
+    return largest;
+}
+
+
+void _StringScatter(sort_string_t *strings, sort_string_t *temp, size_t size, size_t depth, const size_t *offsets)
+{
+    size_t positions[SORT_STRING_BUCKETS];
+    int shift = 56 - 8 * (depth % 8);
+
+    memcpy(positions, offsets, sizeof(positions));
+    for (size_t idx = 0; idx < size; ++idx)
+    {
+        temp[positions[(strings[idx].length <= depth) ? 0 : 1 + ((strings[idx].prefix >> shift) & 0xFF)]++] = strings[idx];
+    }
+
+    memcpy(strings, temp, sizeof(sort_string_t) * size);
+}
+
+
+void _StringDescend(sort_string_t *strings, sort_string_t *temp, size_t size, size_t depth)
+{
+    // The cached word is used up, the next one is loaded for the strings that go on
+    if (0 == depth % 8)
+    {
+        for (size_t idx = 0; idx < size; ++idx)
+        {
+            strings[idx].prefix = _LoadPrefix(strings[idx].str, strings[idx].length, depth);
+        }
+    }
+
+    _StringRadixSort(strings, temp, size, depth);
+}
+
+
+void _StringRadixSort(sort_string_t *strings, sort_string_t *temp, size_t size, size_t depth)
+{
+    size_t offsets[SORT_STRING_BUCKETS + 1];
+
+    while (SORT_STRING_RADIX <= size)
+    {
+        size_t largest = _StringCount(strings, size, depth, offsets);
+
+        // The smaller buckets are sorted by recursion and the largest one by the loop, so the stack stays O(log(n)),
+        // if all the strings share the byte there is nothing to move
+        if (size != offsets[largest + 1] - offsets[largest])
+        {
+            _StringScatter(strings, temp, size, depth, offsets);
+            for (size_t bucket = 1; bucket < SORT_STRING_BUCKETS; ++bucket)
+            {
+                if (bucket != largest)
+                {
+                    _StringDescend(strings + offsets[bucket], temp + offsets[bucket], offsets[bucket + 1] - offsets[bucket], depth + 1);
+                }
+            }
+        }
+
+        // The strings of bucket 0 end at the depth and are equal
+        if (0 == largest)
+        {
+            return;
+        }
+
+        strings += offsets[largest];
+        temp += offsets[largest];
+        size = offsets[largest + 1] - offsets[largest];
+        if (0 == ++depth % 8)
+        {
+            for (size_t idx = 0; idx < size; ++idx)
+            {
+                strings[idx].prefix = _LoadPrefix(strings[idx].str, strings[idx].length, depth);
+            }
+        }
+    }
+
+    _MultikeyQuickSort(strings, size, depth);
+}
+
+
+void _MultikeyQuickSort(sort_string_t *strings, size_t size, size_t depth)
+{
+    while (SORT_STRING_SMALL < size)
+    {
+        uint64_t first = strings[0].prefix;
+        uint64_t middle = strings[size / 2].prefix;
+        uint64_t last = strings[size - 1].prefix;
+        uint64_t pivot = (first < middle) ? ((middle < last) ? middle : ((first < last) ? last : first)) 
+                                          : ((first < last) ? first : ((middle < last) ? last : middle));
+        size_t less = 0;
+        size_t greater = size;
+        size_t word = depth - depth % 8;
+
+        // The cached words are split three ways, only the equal ones need the next word
+        for (size_t idx = 0; idx < greater; )
+        {
+            if (strings[idx].prefix < pivot)
+            {
+                _SwapStrings(&strings[less++], &strings[idx++]);
+            }
+            else if (strings[idx].prefix > pivot)
+            {
+                _SwapStrings(&strings[idx], &strings[--greater]);
+            }
+            else
+            {
+                ++idx;
+            }
+        }
+
+        _MultikeyQuickSort(strings, less, depth);
+        _MultikeyQuickSort(strings + greater, size - greater, depth);
+
+        // The equal strings that end within the word come first, shorter before longer
+        size_t ended = 0;
+
+        strings += less;
+        size = greater - less;
+        for (size_t idx = 0; idx < size; ++idx)
+        {
+            if (strings[idx].length <= word + sizeof(uint64_t))
+            {
+                _SwapStrings(&strings[ended++], &strings[idx]);
+            }
+        }
+
+        for (size_t length = word; 1 < ended && length <= word + sizeof(uint64_t); ++length)
+        {
+            size_t shorter = 0;
+
+            for (size_t idx = 0; idx < ended; ++idx)
+            {
+                if (strings[idx].length == length)
+                {
+                    _SwapStrings(&strings[shorter++], &strings[idx]);
+                }
+            }
+            strings += shorter;
+            size -= shorter;
+            ended -= shorter;
+        }
+        strings += ended;
+        size -= ended;
+
+        depth = word + sizeof(uint64_t);
+        for (size_t idx = 0; idx < size; ++idx)
+        {
+            strings[idx].prefix = _LoadPrefix(strings[idx].str, strings[idx].length, depth);
+        }
+    }
+
+    _StringInsertionSort(strings, size, depth);
+}
+
+
+void _StringInsertionSort(sort_string_t *strings, size_t size, size_t depth)
+{
+    for (size_t idx = 1; idx < size; ++idx)
+    {
+        sort_string_t current = strings[idx];
+        size_t jdx = idx;
+
+        for ( ; 0 < jdx && 0 < _CompareStrings(&strings[jdx - 1], &current, depth); --jdx)
+        {
+            strings[jdx] = strings[jdx - 1];
+        }
+        strings[jdx] = current;
+    }
+}
+
+
+int _CompareStrings(const sort_string_t *first, const sort_string_t *second, size_t depth)
+{
+    size_t start = depth - depth % 8 + sizeof(uint64_t);
+    size_t common = (first->length < second->length) ? first->length : second->length;
+
+    if (first->prefix != second->prefix)
+    {
+        return (first->prefix < second->prefix) ? -1 : 1;
+    }
+
+    // The cached words are equal, so are the bytes up to the shorter string or up to the end of the words
+    if (common > start)
+    {
+        int order = memcmp(first->str + start, second->str + start, common - start);
+        if (0 != order)
+        {
+            return order;
+        }
+    }
+
+    return (first->length > second->length) - (first->length < second->length);
+}
+
+
+void _SwapStrings(sort_string_t *first, sort_string_t *second)
+{
+    sort_string_t temp = *first;
+
+    *first = *second;
+    *second = temp;
+}
+
+
+int StableSortPairs(uint64_t *pairs, size_t size, int maxthreads)
+{
+    stable_task_t tasks[SORT_MAX_THREADS];
+    size_t nleaves = (size + SORT_STABLE_LEAF - 1) / SORT_STABLE_LEAF;
+    int passes = 0;
+
+    if (size <= SORT_STABLE_LEAF)
+    {
+        _StableInsertionSort(pairs, size);
+        return 0;
+    }
+
+    for (size_t width = SORT_STABLE_LEAF; width < size; width *= 2)
+    {
+        ++passes;
+    }
+
+    if (1 > maxthreads || size < (size_t)maxthreads * SORT_STABLE_PIECE)
+    {
+        maxthreads = 1 + size / SORT_STABLE_PIECE;
+    }
+    maxthreads = (SORT_MAX_THREADS < maxthreads) ? SORT_MAX_THREADS : maxthreads;
+
+    // The runs are merged back and forth between the pairs and the buffer, so there is no copy back
+    uint64_t *buffer = (uint64_t *)malloc(sizeof(uint64_t) * size);
+    if (NULL == buffer)
+    {
+        return 1;
+    }
+
+    // The leaves go to the buffer if the number of passes is odd, so the last pass writes into the pairs
+    uint64_t *src = (passes % 2) ? buffer : pairs;
+    uint64_t *dst = (passes % 2) ? pairs : buffer;
+
+    for (int idx = 0; idx < maxthreads; ++idx)
+    {
+        size_t first = nleaves * idx / maxthreads * SORT_STABLE_LEAF;
+        size_t last = nleaves * (idx + 1) / maxthreads * SORT_STABLE_LEAF;
+
+        tasks[idx].src = pairs;
+        tasks[idx].dst = src;
+        tasks[idx].size = size;
+        tasks[idx].width = 0;
+        tasks[idx].first = first;
+        tasks[idx].last = (last < size) ? last : size;
+    }
+    RunTasks(tasks, sizeof(stable_task_t), maxthreads, _StableThread);
+
+    // Every pass the threads produce the same shares of the output, whatever the number of the runs
+    for (size_t width = SORT_STABLE_LEAF; width < size; width *= 2)
+    {
+        for (int idx = 0; idx < maxthreads; ++idx)
+        {
+            tasks[idx].src = src;
+            tasks[idx].dst = dst;
+            tasks[idx].width = width;
+            tasks[idx].first = size * idx / maxthreads;
+            tasks[idx].last = size * (idx + 1) / maxthreads;
+        }
+        RunTasks(tasks, sizeof(stable_task_t), maxthreads, _StableThread);
+
+        uint64_t *temp = src;
+        src = dst;
+        dst = temp;
+    }
+
+    free(buffer);
+    return 0;
+}
+
+
+void *_StableThread(void *stable_task)
+{
+    stable_task_t *task = (stable_task_t *)stable_task;
+
+    if (0 == task->width)
+    {
+        for (size_t left = task->first; left < task->last; left += SORT_STABLE_LEAF)
+        {
+            size_t count = (left + SORT_STABLE_LEAF > task->last) ? task->last - left : SORT_STABLE_LEAF;
+
+            if (task->src != task->dst)
+            {
+                memcpy(task->dst + left, task->src + left, sizeof(uint64_t) * count);
+            }
+            _StableInsertionSort(task->dst + left, count);
+        }
+
+        return NULL;
+    }
+
+    // The share of the thread may start or end inside of a merge, the co-rank finds where it starts in both runs
+    for (size_t pair = task->first - task->first % (2 * task->width); pair < task->last; pair += 2 * task->width)
+    {
+        size_t middle = (pair + task->width < task->size) ? pair + task->width : task->size;
+        size_t end = (pair + 2 * task->width < task->size) ? pair + 2 * task->width : task->size;
+        size_t from = (task->first > pair) ? task->first - pair : 0;
+        size_t to = ((task->last < end) ? task->last : end) - pair;
+
+        _StableMerge(task->src + pair, middle - pair, task->src + middle, end - middle, from, to, task->dst + pair);
+    }
+
+    return NULL;
+}
+
+
+void _StableInsertionSort(uint64_t *pairs, size_t size)
+{
+    for (size_t idx = 1; idx < size; ++idx)
+    {
+        uint64_t current = pairs[idx];
+        size_t jdx = idx;
+
+        // Strict comparison keeps the pairs of equal keys in their order
+        for ( ; 0 < jdx && SORT_PAIR_KEY(pairs[jdx - 1]) > SORT_PAIR_KEY(current); --jdx)
+        {
+            pairs[jdx] = pairs[jdx - 1];
+        }
+        pairs[jdx] = current;
+    }
+}
+
+
+size_t _StableCoRank(size_t diag, const uint64_t *left, size_t left_size, const uint64_t *right, size_t right_size)
+{
+    // How many of the first diag merged pairs come from the left run, the ties are taken from the left
+    size_t low = (diag > right_size) ? diag - right_size : 0;
+    size_t high = (diag < left_size) ? diag : left_size;
+
+    while (low < high)
+    {
+        size_t idx = low + (high - low) / 2;
+        size_t jdx = diag - idx;
+
+        if (0 < jdx && SORT_PAIR_KEY(left[idx]) <= SORT_PAIR_KEY(right[jdx - 1]))
+        {
+            low = idx + 1;
+        }
+        else
+        {
+            high = idx;
+        }
+    }
+
+    return low;
+}
+
+
+void _StableMerge(const uint64_t *left, size_t left_size, const uint64_t *right, size_t right_size, 
+        size_t from, size_t to, uint64_t *out)
+{
+    size_t idx = _StableCoRank(from, left, left_size, right, right_size);
+    size_t jdx = from - idx;
+
+    // Writes the pairs [from, to) of the merge of two runs
+    for (size_t pos = from; pos < to; ++pos)
+    {
+        int is_left = (jdx >= right_size) || (idx < left_size && SORT_PAIR_KEY(left[idx]) <= SORT_PAIR_KEY(right[jdx]));
+
+        out[pos] = is_left ? left[idx] : right[jdx];
+        idx += is_left;
+        jdx += !is_left;
+    }
+}
+
+
+size_t LowerBound(const int *arr, size_t size, int value)
+{
+    size_t low = 0;
+    size_t high = size;
+
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+
+        if (arr[middle] < value)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+
+uint64_t SplitMix64(uint64_t counter)
+{
+    // The output function of SplitMix64: the value depends only on the counter, so any thread can start anywhere
+    uint64_t z = counter * 0x9E3779B97F4A7C15ULL;
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
@@ -1,7 +1,13 @@
 #include <stdio.h>	// printf
-#include <stdlib.h> // srand
+#include <stdint.h> // uint64_t
+#include <stdlib.h> // malloc
+#include <limits.h> // INT_MAX
+#include <string.h> // memcmp
 
 #include "sorts.h"	// sorting algorithms
+#include "select.h"	// Select, TopK, Quantiles
+#include "argsort.h"	// Argsort, ArgsortColumns
+#include "lazy.h"	// CreateLazySort, LazyNext
 			
 #define True (1)
 #define False (0)
@@ -14,17 +20,93 @@
 #define LENGTH (10)
 #endif
 
+#ifndef SEED
+#define SEED (100)
+#endif
+
+#ifndef SORT_LENGTH
+#define SORT_LENGTH (1 << 20)
+#endif
+
+#ifndef BUCKETS
+#define BUCKETS (100)
+#endif
+
+#ifndef SORT_THREADS
+#define SORT_THREADS (4)
+#endif
+
+#ifndef TOPK
+#define TOPK (100)
+#endif
+
+#ifndef RECORD
+#define RECORD (4)
+#endif
+
+#ifndef COLUMNS
+#define COLUMNS (3)
+#endif
+
+#ifndef LAZY_BLOCK
+#define LAZY_BLOCK (1 << 14)
+#endif
+
+#ifndef STRINGS
+#define STRINGS (1 << 18)
+#endif
+
+#ifndef STRING_LENGTH
+#define STRING_LENGTH (40)
+#endif
+
 
 void PrintArray(int *arr, size_t size);
 int IsArraySorted(int *arr, size_t size);
+uint64_t ArrayChecksum(const int *arr, size_t size);
 void GenerateArray(int *arr, size_t size);
 void BubbleSortTest(int is_print);
+void InsertionSortTest(int is_print);
+void CountingSortTest(int is_print);
+void RadixSortTest(int is_print);
+void SortTest(int is_print);
+void NaturalMergeSortTest(int is_print);
+void StableSortPairsTest(int is_print);
+void ArgsortTest(int is_print);
+void ArgsortColumnsTest(int is_print);
+void ParallelCountingSortTest(int is_print);
+void SegmentedSortTest(int is_print);
+void RangePartitionTest(int is_print);
+void SetOperationsTest(int is_print);
+void StringSortTest(int is_print);
+void SelectTest(int is_print);
+void TopKTest(int is_print);
+void QuantilesTest(int is_print);
+void LazySortTest(int is_print);
+void SortPiece(int *piece, size_t size, const void *context);
 
 int main(void)
 {
     int arr[10] = {345, -123, 0, 43, -472384, 9999, 9, 5, 11, -1};
 
     BubbleSortTest(1);
+    InsertionSortTest(1);
+    CountingSortTest(1);
+    RadixSortTest(1);
+    SortTest(1);
+    NaturalMergeSortTest(1);
+    StableSortPairsTest(1);
+    ArgsortTest(1);
+    ArgsortColumnsTest(1);
+    ParallelCountingSortTest(1);
+    SegmentedSortTest(1);
+    RangePartitionTest(1);
+    SetOperationsTest(1);
+    StringSortTest(1);
+    SelectTest(1);
+    TopKTest(1);
+    QuantilesTest(1);
+    LazySortTest(1);
     return 0;
 }
 
@@ -54,6 +136,839 @@ void BubbleSortTest(int is_print)
 }
 
 
+void InsertionSortTest(int is_print)
+{
+    int arr[LENGTH] = {0};
+
+    GenerateArray(arr, LENGTH);
+
+    if (True == is_print)
+    {
+        PrintArray(arr, LENGTH);
+    }
+
+    InsertionSort(arr, LENGTH);
+
+    if (True == is_print)
+    {
+        PrintArray(arr, LENGTH);
+    }
+
+    if (False == IsArraySorted(arr, LENGTH))
+    {
+        printf("ERROR: Array was not sorted!\n");
+    }
+}
+
+
+void CountingSortTest(int is_print)
+{
+    int arr[LENGTH] = {0};
+
+    GenerateArray(arr, LENGTH);
+    arr[0] = -arr[0];
+
+    if (True == is_print)
+    {
+        PrintArray(arr, LENGTH);
+    }
+
+    CountingSort(arr, LENGTH);
+
+    if (True == is_print)
+    {
+        PrintArray(arr, LENGTH);
+    }
+
+    if (False == IsArraySorted(arr, LENGTH))
+    {
+        printf("ERROR: Array was not sorted!\n");
+    }
+}
+
+
+void RadixSortTest(int is_print)
+{
+    int arr[LENGTH] = {0};
+
+    for (size_t idx = 0; idx < LENGTH; ++idx)
+    {
+        arr[idx] = (int)SplitMix64(SEED + idx + 1);
+    }
+
+    if (True == is_print)
+    {
+        PrintArray(arr, LENGTH);
+    }
+
+    RadixSort(arr, LENGTH);
+
+    if (True == is_print)
+    {
+        PrintArray(arr, LENGTH);
+    }
+
+    if (False == IsArraySorted(arr, LENGTH))
+    {
+        printf("ERROR: Array was not sorted!\n");
+    }
+}
+
+
+void SortTest(int is_print)
+{
+    static int arr[SORT_LENGTH];
+    const char *shapes[] = {"few unique", "wide", "sorted", "reversed", "duplicates", "sawtooth"};
+
+    for (size_t shape = 0; shape < sizeof(shapes) / sizeof(shapes[0]); ++shape)
+    {
+        sort_profile_t profile;
+
+        for (size_t idx = 0; idx < SORT_LENGTH; ++idx)
+        {
+            uint64_t random = SplitMix64(SEED + idx + 1);
+
+            switch (shape)
+            {
+                case 0:  arr[idx] = random % ACCURACY; break;
+                case 1:  arr[idx] = (int)random; break;
+                case 2:  arr[idx] = (int)idx; break;
+                case 3:  arr[idx] = -(int)idx; break;
+                case 4:  arr[idx] = (int)(random % ACCURACY) * 1000003; break;
+                default: arr[idx] = (int)(idx % 4096) * 7; break;
+            }
+        }
+
+        // A kernel that loses or duplicates values can still leave the array sorted
+        uint64_t checksum = ArrayChecksum(arr, SORT_LENGTH);
+
+        Sort(arr, SORT_LENGTH, SORT_THREADS, &profile);
+
+        if (True == is_print)
+        {
+            printf("%s: %s\n", shapes[shape], SortKernelName(profile.kernel));
+        }
+
+        if (False == IsArraySorted(arr, SORT_LENGTH))
+        {
+            printf("ERROR: Array was not sorted!\n");
+        }
+
+        if (checksum != ArrayChecksum(arr, SORT_LENGTH))
+        {
+            printf("ERROR: Array changed its values!\n");
+        }
+    }
+}
+
+
+void NaturalMergeSortTest(int is_print)
+{
+    static int arr[SORT_LENGTH];
+    const char *shapes[] = {"appended", "blocks", "reversed blocks", "random", "few unique"};
+
+    for (size_t shape = 0; shape < sizeof(shapes) / sizeof(shapes[0]); ++shape)
+    {
+        for (int threads = 1; threads <= SORT_THREADS; threads += SORT_THREADS - 1)
+        {
+            for (size_t idx = 0; idx < SORT_LENGTH; ++idx)
+            {
+                uint64_t random = SplitMix64(SEED + idx + 1);
+
+                switch (shape)
+                {
+                    case 0:  arr[idx] = (idx < SORT_LENGTH - 1000) ? (int)idx : (int)(random % SORT_LENGTH); break;
+                    case 1:  arr[idx] = (int)(idx % 10007); break;
+                    case 2:  arr[idx] = -(int)(idx % 10007); break;
+                    case 3:  arr[idx] = (int)random; break;
+                    default: arr[idx] = random % ACCURACY; break;
+                }
+            }
+
+            // A galloping merge that drops or duplicates elements can still leave the array sorted
+            uint64_t checksum = ArrayChecksum(arr, SORT_LENGTH);
+
+            ParallelNaturalMergeSort(arr, SORT_LENGTH, threads);
+
+            if (True == is_print)
+            {
+                printf("%s with %d threads: %s\n", shapes[shape], threads, 
+                        (True == IsArraySorted(arr, SORT_LENGTH)) ? "sorted" : "not sorted");
+            }
+
+            if (False == IsArraySorted(arr, SORT_LENGTH))
+            {
+                printf("ERROR: Array was not sorted!\n");
+            }
+
+            if (checksum != ArrayChecksum(arr, SORT_LENGTH))
+            {
+                printf("ERROR: Array changed its values!\n");
+            }
+        }
+    }
+}
+
+
+void StableSortPairsTest(int is_print)
+{
+    static uint64_t pairs[SORT_LENGTH];
+    const size_t sizes[] = {SORT_LENGTH, 1000, 7};
+    size_t errors = 0;
+
+    for (size_t size = 0; size < sizeof(sizes) / sizeof(sizes[0]); ++size)
+    {
+        for (int threads = 1; threads <= SORT_THREADS; threads += SORT_THREADS - 1)
+        {
+            // Few keys make long groups of equal keys, the payload is the position of arrival
+            for (size_t idx = 0; idx < sizes[size]; ++idx)
+            {
+                pairs[idx] = ((SplitMix64(SEED + idx + 1) % ACCURACY) << 32) | (uint32_t)idx;
+            }
+
+            errors += (0 != StableSortPairs(pairs, sizes[size], threads));
+
+            for (size_t idx = 1; idx < sizes[size]; ++idx)
+            {
+                uint64_t key = pairs[idx] >> 32;
+                uint64_t previous = pairs[idx - 1] >> 32;
+
+                errors += (previous > key || (previous == key && (uint32_t)pairs[idx - 1] > (uint32_t)pairs[idx]));
+            }
+        }
+    }
+
+    if (True == is_print)
+    {
+        printf("stable pairs: %lu, errors: %lu\n", sizes[0], errors);
+    }
+
+    if (0 != errors)
+    {
+        printf("ERROR: Pairs were not sorted stably!\n");
+    }
+}
+
+
+void ArgsortTest(int is_print)
+{
+    static int keys[SORT_LENGTH];
+    static uint32_t perm[SORT_LENGTH];
+    static uint32_t records[SORT_LENGTH][RECORD];
+    static uint32_t out[SORT_LENGTH][RECORD];
+    static char seen[SORT_LENGTH];
+    const char engines[] = {'R', 'Q'};
+    size_t errors = 0;
+
+    // Negative keys check the order of the sign, few keys make long groups of equal keys
+    for (size_t idx = 0; idx < SORT_LENGTH; ++idx)
+    {
+        keys[idx] = (int)(SplitMix64(SEED + idx + 1) % ACCURACY) - ACCURACY / 2;
+        memset(records[idx], 0xA5, sizeof(records[idx]));
+        records[idx][0] = (uint32_t)keys[idx];
+        records[idx][1] = (uint32_t)idx;
+    }
+
+    for (size_t engine = 0; engine < sizeof(engines); ++engine)
+    {
+        for (int threads = 1; threads <= SORT_THREADS; threads += SORT_THREADS - 1)
+        {
+            memset(seen, 0, sizeof(seen));
+            errors += (0 != Argsort(keys, SORT_LENGTH, perm, engines[engine], threads));
+
+            for (size_t idx = 0; idx < SORT_LENGTH; ++idx)
+            {
+                errors += (perm[idx] >= SORT_LENGTH || 0 != seen[perm[idx]]++);
+                errors += (0 != idx && (keys[perm[idx - 1]] > keys[perm[idx]] || 
+                            (keys[perm[idx - 1]] == keys[perm[idx]] && perm[idx - 1] > perm[idx])));
+            }
+
+            // The records have to arrive whole in the order of the permutation
+            GatherRecords(records, out, sizeof(records[0]), perm, SORT_LENGTH, threads);
+            for (size_t idx = 0; idx < SORT_LENGTH; ++idx)
+            {
+                errors += (0 != memcmp(out[idx], records[perm[idx]], sizeof(records[0])));
+            }
+        }
+    }
+
+    if (True == is_print)
+    {
+        printf("argsort: %d, first: %d, errors: %lu\n", SORT_LENGTH, keys[perm[0]], errors);
+    }
+
+    if (0 != errors)
+    {
+        printf("ERROR: Records were not sorted stably!\n");
+    }
+}
+
+
+void ArgsortColumnsTest(int is_print)
+{
+    static int table[COLUMNS][SORT_LENGTH];
+    static int sorted[COLUMNS][SORT_LENGTH];
+    static uint32_t perm[SORT_LENGTH];
+    static char seen[SORT_LENGTH];
+    const int *columns[COLUMNS];
+    int *out[COLUMNS];
+    const char engines[] = {'R', 'Q'};
+    size_t nkeys = 0;
+    size_t errors = 0;
+
+    // The leading columns take few values, the last one is wide, so the keys do not fit one pass
+    for (size_t column = 0; column < COLUMNS; ++column)
+    {
+        int range = (column + 1 == COLUMNS) ? INT_MAX : ACCURACY;
+
+        for (size_t idx = 0; idx < SORT_LENGTH; ++idx)
+        {
+            table[column][idx] = (int)(SplitMix64(SEED + idx * COLUMNS + column) % range) - range / 2;
+        }
+        columns[column] = table[column];
+        out[column] = sorted[column];
+    }
+
+    for (size_t engine = 0; engine < sizeof(engines); ++engine)
+    {
+        for (int threads = 1; threads <= SORT_THREADS; threads += SORT_THREADS - 1)
+        {
+            memset(seen, 0, sizeof(seen));
+            nkeys = ArgsortColumns(columns, COLUMNS, SORT_LENGTH, perm, engines[engine], threads);
+            GatherColumns(columns, out, COLUMNS, perm, SORT_LENGTH, threads);
+            errors += (0 == nkeys);
+
+            for (size_t idx = 0; idx < SORT_LENGTH; ++idx)
+            {
+                int order = 0;
+
+                errors += (perm[idx] >= SORT_LENGTH || 0 != seen[perm[idx]]++);
+                for (size_t column = 0; column < COLUMNS; ++column)
+                {
+                    errors += (sorted[column][idx] != table[column][perm[idx]]);
+                    if (0 != idx && 0 == order)
+                    {
+                        order = (sorted[column][idx - 1] > sorted[column][idx]) - (sorted[column][idx - 1] < sorted[column][idx]);
+                    }
+                }
+                errors += (0 != idx && (0 < order || (0 == order && perm[idx - 1] > perm[idx])));
+            }
+        }
+    }
+
+    if (True == is_print)
+    {
+        printf("columns: %d sorted by %lu keys, errors: %lu\n", COLUMNS, nkeys, errors);
+    }
+
+    if (0 != errors)
+    {
+        printf("ERROR: Rows were not sorted stably!\n");
+    }
+}
+
+
+void ParallelCountingSortTest(int is_print)
+{
+    static int arr[SORT_LENGTH];
+    const int ranges[] = {ACCURACY, 1 << 12, 1 << 30};
+
+    for (size_t range = 0; range < sizeof(ranges) / sizeof(ranges[0]); ++range)
+    {
+        for (size_t idx = 0; idx < SORT_LENGTH; ++idx)
+        {
+            arr[idx] = (int)(SplitMix64(SEED + idx + 1) % ranges[range]) - ranges[range] / 2;
+        }
+
+        // A fill phase that writes wrong values or wrong counts can still leave the array sorted
+        uint64_t checksum = ArrayChecksum(arr, SORT_LENGTH);
+
+        ParallelCountingSort(arr, SORT_LENGTH, SORT_THREADS);
+
+        if (True == is_print)
+        {
+            printf("range %d: %s\n", ranges[range], 
+                    (True == IsArraySorted(arr, SORT_LENGTH)) ? "sorted" : "not sorted");
+        }
+
+        if (False == IsArraySorted(arr, SORT_LENGTH))
+        {
+            printf("ERROR: Array was not sorted!\n");
+        }
+
+        if (checksum != ArrayChecksum(arr, SORT_LENGTH))
+        {
+            printf("ERROR: Array changed its values!\n");
+        }
+    }
+}
+
+
+void SegmentedSortTest(int is_print)
+{
+    static int arr[SORT_LENGTH];
+    static size_t offsets[SORT_LENGTH + 1];
+    static uint64_t checksums[SORT_LENGTH];
+    size_t nsegments = 0;
+    size_t unsorted = 0;
+    size_t changed = 0;
+
+    // The sizes of the segments mix the tiny, the small and the large ones
+    while (offsets[nsegments] < SORT_LENGTH)
+    {
+        uint64_t random = SplitMix64(SEED + nsegments + 1);
+        size_t size = (0 == random % 4) ? random % 1000 : random % 10;
+
+        size = (SORT_LENGTH - offsets[nsegments] < size) ? SORT_LENGTH - offsets[nsegments] : size;
+        offsets[nsegments + 1] = offsets[nsegments] + size;
+        ++nsegments;
+    }
+
+    for (size_t idx = 0; idx < SORT_LENGTH; ++idx)
+    {
+        arr[idx] = (int)SplitMix64(SEED + idx + 1);
+    }
+
+    // A sum of hashes does not depend on the order, so it tells whether a segment kept its values
+    for (size_t segment = 0; segment < nsegments; ++segment)
+    {
+        checksums[segment] = 0;
+        for (size_t idx = offsets[segment]; idx < offsets[segment + 1]; ++idx)
+        {
+            checksums[segment] += SplitMix64((uint32_t)arr[idx]);
+        }
+    }
+
+    SegmentedSort(arr, offsets, nsegments, SORT_THREADS);
+
+    for (size_t segment = 0; segment < nsegments; ++segment)
+    {
+        size_t size = offsets[segment + 1] - offsets[segment];
+
+        if (1 < size && False == IsArraySorted(arr + offsets[segment], size))
+        {
+            ++unsorted;
+        }
+
+        for (size_t idx = offsets[segment]; idx < offsets[segment + 1]; ++idx)
+        {
+            checksums[segment] -= SplitMix64((uint32_t)arr[idx]);
+        }
+        changed += (0 != checksums[segment]);
+    }
+
+    if (True == is_print)
+    {
+        printf("segments: %lu, unsorted: %lu, changed: %lu\n", nsegments, unsorted, changed);
+    }
+
+    if (0 != unsorted || 0 != changed)
+    {
+        printf("ERROR: Array was not sorted!\n");
+    }
+}
+
+
+void RangePartitionTest(int is_print)
+{
+    static int arr[SORT_LENGTH];
+    static int out[SORT_LENGTH];
+    int splitters[BUCKETS - 1];
+    size_t offsets[BUCKETS + 1];
+    size_t misplaced = 0;
+    size_t largest = 0;
+
+    for (size_t idx = 0; idx < SORT_LENGTH; ++idx)
+    {
+        arr[idx] = (int)SplitMix64(SEED + idx + 1);
+    }
+    arr[0] = INT_MAX;
+
+    if (0 != ChooseSplitters(arr, SORT_LENGTH, splitters, BUCKETS) || 
+            0 != RangePartition(arr, SORT_LENGTH, out, splitters, BUCKETS, offsets, SORT_THREADS))
+    {
+        printf("ERROR: Array was not partitioned!\n");
+        return;
+    }
+
+    // Every value has to lie within the range of its bucket
+    for (size_t bucket = 0; bucket < BUCKETS; ++bucket)
+    {
+        largest = (offsets[bucket + 1] - offsets[bucket] > largest) ? offsets[bucket + 1] - offsets[bucket] : largest;
+        for (size_t idx = offsets[bucket]; idx < offsets[bucket + 1]; ++idx)
+        {
+            if ((0 < bucket && out[idx] < splitters[bucket - 1]) || (BUCKETS - 1 > bucket && out[idx] >= splitters[bucket]))
+            {
+                ++misplaced;
+            }
+        }
+    }
+
+    if (True == is_print)
+    {
+        printf("buckets: %d, largest: %lu, misplaced: %lu\n", BUCKETS, largest, misplaced);
+    }
+
+    if (SORT_LENGTH != offsets[BUCKETS] || 0 != misplaced)
+    {
+        printf("ERROR: Array was not partitioned!\n");
+    }
+}
+
+
+void SetOperationsTest(int is_print)
+{
+    static int a[SORT_LENGTH];
+    static int b[SORT_LENGTH / 2];
+    static int out[SORT_LENGTH + SORT_LENGTH / 2];
+    static size_t left[SORT_LENGTH];
+    static size_t right[SORT_LENGTH];
+    int small[8] = {0, 1, 2, 5, 6, 7, 8, 9};
+    int *exact = (int *)malloc(sizeof(int) * 4);
+    size_t common = 0;
+    size_t sizes[4] = {0};
+    size_t errors = 0;
+
+    // a holds the multiples of 2 and b the multiples of 3 with random gaps, so the common values are known
+    for (size_t idx = 0, value = 0; idx < SORT_LENGTH; ++idx, value += 2 + 2 * (SplitMix64(SEED + idx) % 2))
+    {
+        a[idx] = (int)value;
+    }
+    for (size_t idx = 0, value = 0; idx < SORT_LENGTH / 2; ++idx, value += 3 + 3 * (SplitMix64(SEED - idx) % 3))
+    {
+        b[idx] = (int)value;
+    }
+    for (size_t idx = 0, jdx = 0; idx < SORT_LENGTH && jdx < SORT_LENGTH / 2; )
+    {
+        if (a[idx] < b[jdx])
+        {
+            ++idx;
+        }
+        else if (b[jdx] < a[idx])
+        {
+            ++jdx;
+        }
+        else
+        {
+            ++common;
+            ++idx;
+            ++jdx;
+        }
+    }
+
+    sizes[0] = SetIntersection(a, SORT_LENGTH, b, SORT_LENGTH / 2, out, SORT_THREADS);
+    errors += (sizes[0] != common) || (1 < sizes[0] && False == IsArraySorted(out, sizes[0]));
+    for (size_t idx = 0; idx < sizes[0]; ++idx)
+    {
+        errors += (0 != out[idx] % 6);
+    }
+
+    sizes[1] = SetUnion(a, SORT_LENGTH, b, SORT_LENGTH / 2, out, SORT_THREADS);
+    errors += (sizes[1] != SORT_LENGTH + SORT_LENGTH / 2 - common) || False == IsArraySorted(out, sizes[1]);
+
+    sizes[2] = SetDifference(a, SORT_LENGTH, b, SORT_LENGTH / 2, out, SORT_THREADS);
+    errors += (sizes[2] != SORT_LENGTH - common) || False == IsArraySorted(out, sizes[2]);
+
+    // The tiny set is searched by galloping, the prefix of a is merged
+    sizes[3] = SetIntersection(b, 10, a, SORT_LENGTH, out, 1);
+    errors += (sizes[3] != SetIntersection(b, 10, a, 64, out, 1));
+
+    // The match of a block that stays leaves room for only three of the next block, out is exactly min(asize, bsize)
+    errors += (NULL == exact || 4 != SetIntersection(small, 8, small + 3, 4, exact, 1) || 5 != exact[0] || 8 != exact[3]);
+    free(exact);
+
+    // Every value of the first quarter of a joins twice with a doubled b
+    for (size_t idx = 0; idx < SORT_LENGTH / 2; ++idx)
+    {
+        b[idx] = a[idx / 2];
+    }
+    errors += (SORT_LENGTH / 2 != MergeJoin(a, SORT_LENGTH, b, SORT_LENGTH / 2, left, right, SORT_LENGTH, SORT_THREADS));
+    for (size_t idx = 0; idx < SORT_LENGTH / 2; ++idx)
+    {
+        errors += (a[left[idx]] != b[right[idx]]);
+    }
+
+    if (True == is_print)
+    {
+        printf("intersection: %lu, union: %lu, difference: %lu, errors: %lu\n", sizes[0], sizes[1], sizes[2], errors);
+    }
+
+    if (0 != errors)
+    {
+        printf("ERROR: Set operations are wrong!\n");
+    }
+}
+
+
+void StringSortTest(int is_print)
+{
+    static char text[STRINGS * STRING_LENGTH];
+    static sort_string_t strings[STRINGS];
+    int threads[2] = {1, SORT_THREADS};
+    size_t errors = 0;
+
+    for (int run = 0; run < 2; ++run)
+    {
+        uintptr_t checksum = 0;
+
+        // A few hosts share a long scheme, the paths have zeros, duplicates and prefixes of each other
+        for (size_t idx = 0; idx < STRINGS; ++idx)
+        {
+            uint64_t random = SplitMix64(SEED + idx);
+            char *str = text + idx * STRING_LENGTH;
+            size_t length = random % STRING_LENGTH;
+
+            for (size_t jdx = 0; jdx < length; ++jdx)
+            {
+                str[jdx] = (jdx < 11) ? "http://www."[jdx] : (char)((jdx < 14) ? 'a' + (random >> 8) % 4 : (random >> jdx) % 3);
+            }
+
+            strings[idx].str = str;
+            strings[idx].length = (0 == idx % 7) ? 20 : length;
+            checksum += (uintptr_t)str ^ strings[idx].length;
+        }
+
+        StringSort(strings, STRINGS, threads[run]);
+
+        for (size_t idx = 0; idx < STRINGS; ++idx)
+        {
+            checksum -= (uintptr_t)strings[idx].str ^ strings[idx].length;
+            if (0 < idx)
+            {
+                const sort_string_t *first = &strings[idx - 1];
+                const sort_string_t *second = &strings[idx];
+                size_t common = (first->length < second->length) ? first->length : second->length;
+                int order = memcmp(first->str, second->str, common);
+
+                errors += (0 < order || (0 == order && first->length > second->length));
+            }
+        }
+        errors += (0 != checksum);
+    }
+
+    if (True == is_print)
+    {
+        printf("strings: %d, first: %.*s, errors: %lu\n", STRINGS, (int)strings[0].length, strings[0].str, errors);
+    }
+
+    if (0 != errors)
+    {
+        printf("ERROR: Strings were not sorted!\n");
+    }
+}
+
+
+void SelectTest(int is_print)
+{
+    static int arr[SORT_LENGTH];
+    static int sorted[SORT_LENGTH];
+    const int ranges[] = {ACCURACY, INT_MAX};
+    const size_t ranks[] = {0, 1, SORT_LENGTH / 2, SORT_LENGTH - 1};
+    size_t errors = 0;
+
+    for (size_t range = 0; range < sizeof(ranges) / sizeof(ranges[0]); ++range)
+    {
+        for (size_t idx = 0; idx < SORT_LENGTH; ++idx)
+        {
+            sorted[idx] = (int)(SplitMix64(SEED + idx + 1) % ranges[range]);
+        }
+        uint64_t checksum = ArrayChecksum(sorted, SORT_LENGTH);
+        memcpy(arr, sorted, sizeof(arr));
+        Sort(sorted, SORT_LENGTH, SORT_THREADS, NULL);
+
+        // The selected element splits the array, few unique values make long runs equal to it
+        for (size_t rank = 0; rank < sizeof(ranks) / sizeof(ranks[0]); ++rank)
+        {
+            size_t k = ranks[rank];
+            int value = Select(arr, 0, SORT_LENGTH - 1, (int)k);
+
+            errors += (value != sorted[k] || arr[k] != value);
+            for (size_t idx = 0; idx < SORT_LENGTH; ++idx)
+            {
+                errors += (idx < k && arr[idx] > value) || (idx > k && arr[idx] < value);
+            }
+        }
+
+        PartialSort(arr, SORT_LENGTH, TOPK);
+        errors += (0 != memcmp(arr, sorted, sizeof(int) * TOPK));
+        errors += (checksum != ArrayChecksum(arr, SORT_LENGTH));
+    }
+
+    if (True == is_print)
+    {
+        printf("select: %lu, errors: %lu\n", sizeof(ranks) / sizeof(ranks[0]), errors);
+    }
+
+    if (0 != errors)
+    {
+        printf("ERROR: Elements were not selected!\n");
+    }
+}
+
+
+void TopKTest(int is_print)
+{
+    static int arr[SORT_LENGTH];
+    static int sorted[SORT_LENGTH];
+    static int out[TOPK];
+    size_t errors = 0;
+
+    for (size_t idx = 0; idx < SORT_LENGTH; ++idx)
+    {
+        sorted[idx] = (int)SplitMix64(SEED + idx + 1);
+    }
+    Sort(sorted, SORT_LENGTH, SORT_THREADS, NULL);
+
+    // One thread selects in the array, more threads merge the candidates of their chunks
+    for (int threads = 1; threads <= SORT_THREADS; threads += SORT_THREADS - 1)
+    {
+        for (size_t idx = 0; idx < SORT_LENGTH; ++idx)
+        {
+            arr[idx] = (int)SplitMix64(SEED + idx + 1);
+        }
+        uint64_t checksum = ArrayChecksum(arr, SORT_LENGTH);
+
+        TopK(arr, SORT_LENGTH, TOPK, out, threads);
+        errors += (0 != memcmp(out, sorted, sizeof(out)));
+        errors += (checksum != ArrayChecksum(arr, SORT_LENGTH));
+    }
+
+    if (True == is_print)
+    {
+        printf("top %d: %d .. %d, errors: %lu\n", TOPK, out[0], out[TOPK - 1], errors);
+    }
+
+    if (0 != errors)
+    {
+        printf("ERROR: Top elements are wrong!\n");
+    }
+}
+
+
+void QuantilesTest(int is_print)
+{
+    static int arr[SORT_LENGTH];
+    static int sorted[SORT_LENGTH];
+    const double quantiles[] = {0.5, 0, 0.999, 0.25, 1, 0.5};
+    const size_t count = sizeof(quantiles) / sizeof(quantiles[0]);
+    int values[sizeof(quantiles) / sizeof(quantiles[0])];
+    size_t errors = 0;
+
+    for (size_t idx = 0; idx < SORT_LENGTH; ++idx)
+    {
+        sorted[idx] = (int)SplitMix64(SEED + idx + 1);
+    }
+    memcpy(arr, sorted, sizeof(arr));
+    uint64_t checksum = ArrayChecksum(arr, SORT_LENGTH);
+    Sort(sorted, SORT_LENGTH, SORT_THREADS, NULL);
+
+    // The quantiles come unordered and repeated, the values are returned in the order of the request
+    errors += (0 != Quantiles(arr, SORT_LENGTH, quantiles, count, values));
+    for (size_t idx = 0; idx < count; ++idx)
+    {
+        errors += (values[idx] != sorted[(size_t)(quantiles[idx] * (SORT_LENGTH - 1))]);
+    }
+    errors += (checksum != ArrayChecksum(arr, SORT_LENGTH));
+
+    // The estimated value has to lie within the bound from the requested rank
+    for (int threads = 1; threads <= SORT_THREADS; threads += SORT_THREADS - 1)
+    {
+        sketch_t *sketch = SketchArray(arr, SORT_LENGTH, threads);
+
+        if (NULL == sketch)
+        {
+            ++errors;
+            continue;
+        }
+
+        double bound = SketchErrorBound(sketch) * SORT_LENGTH;
+        for (size_t idx = 0; idx < count; ++idx)
+        {
+            double rank = quantiles[idx] * (SORT_LENGTH - 1);
+            int value = SketchQuery(sketch, quantiles[idx]);
+            size_t low = LowerBound(sorted, SORT_LENGTH, value);
+            size_t high = (INT_MAX == value) ? SORT_LENGTH : LowerBound(sorted, SORT_LENGTH, value + 1);
+
+            errors += (rank + bound < low || rank >= high + bound);
+        }
+
+        if (True == is_print)
+        {
+            printf("sketch with %d threads: median %d, bound %.0f\n", threads, SketchQuery(sketch, 0.5), bound);
+        }
+        DestroySketch(sketch);
+    }
+
+    if (True == is_print)
+    {
+        printf("quantiles: %lu, errors: %lu\n", count, errors);
+    }
+
+    if (0 != errors)
+    {
+        printf("ERROR: Quantiles are wrong!\n");
+    }
+}
+
+
+void LazySortTest(int is_print)
+{
+    static int arr[SORT_LENGTH];
+    int workers[2] = {0, SORT_THREADS};
+    size_t nblocks = 0;
+    size_t errors = 0;
+
+    for (int run = 0; run < 2; ++run)
+    {
+        for (size_t idx = 0; idx < SORT_LENGTH; ++idx)
+        {
+            arr[idx] = (int)(SplitMix64(SEED + idx + 1) % (SORT_LENGTH / 2));
+        }
+        uint64_t checksum = ArrayChecksum(arr, SORT_LENGTH);
+
+        lazy_sort_t *lazy = CreateLazySort(arr, SORT_LENGTH, LAZY_BLOCK, 1, SortPiece, NULL, workers[run]);
+        const int *block = NULL;
+        size_t count = 0;
+        size_t emitted = 0;
+
+        if (NULL == lazy)
+        {
+            printf("ERROR: Lazy sort was not created!\n");
+            return;
+        }
+
+        // The blocks follow each other in the array, only the last one may be short
+        nblocks = 0;
+        while (0 != (count = LazyNext(lazy, &block)))
+        {
+            errors += (block != arr + emitted || (count < LAZY_BLOCK && emitted + count != SORT_LENGTH));
+            errors += (0 != emitted && arr[emitted - 1] > block[0]) || False == IsArraySorted((int *)block, count);
+            emitted += count;
+            ++nblocks;
+        }
+        DestroyLazySort(lazy);
+
+        errors += (SORT_LENGTH != emitted || checksum != ArrayChecksum(arr, SORT_LENGTH));
+    }
+
+    if (True == is_print)
+    {
+        printf("lazy blocks: %lu, errors: %lu\n", nblocks, errors);
+    }
+
+    if (0 != errors)
+    {
+        printf("ERROR: Blocks were not sorted!\n");
+    }
+}
+
+
+void SortPiece(int *piece, size_t size, const void *context)
+{
+    Sort(piece, size, 1, NULL);
+}
+
+
 void PrintArray(int *arr, size_t size)
 {
     printf("{");
@@ -83,13 +998,24 @@ int IsArraySorted(int *arr, size_t size)
 }
 
 
-void GenerateArray(int *arr, size_t size)
+// A sum of hashes does not depend on the order, so it is equal for every permutation of the values
+uint64_t ArrayChecksum(const int *arr, size_t size)
 {
-    srand(100);
+    uint64_t checksum = 0;
 
     for (size_t idx = 0; idx < size; ++idx)
     {
-        arr[idx] = rand() % ACCURACY;
+        checksum += SplitMix64((uint32_t)arr[idx]);
     }
+
+    return checksum;
 }
 
+
+void GenerateArray(int *arr, size_t size)
+{
+    for (size_t idx = 0; idx < size; ++idx)
+    {
+        arr[idx] = SplitMix64(SEED + idx + 1) % ACCURACY;
+    }
+}